@@ -70,12 +70,42 @@ void CAgentControlClient::Status()
     }
 }
 
-void CAgentControlClient::DumpPerfCounters()
+void CAgentControlClient::DumpPerfCounters( bool bIncremental )
 {
     if( Connect() )
     {
         QJsonObject oCommandJson;
         oCommandJson["Command"] = "dump_perf_counters";
+        if( bIncremental )
+            oCommandJson["mode"] = "incremental";
+
+        m_pServerSocket->write( QJsonDocument( oCommandJson ).toJson() );
+        m_pServerSocket->waitForBytesWritten(500);
+    }
+}
+
+void CAgentControlClient::QueryPerfCounters( QString const& sPattern, QString const& sField )
+{
+    if( Connect() )
+    {
+        QJsonObject oCommandJson;
+        oCommandJson["Command"] = "query_perf_counters";
+        oCommandJson["pattern"] = sPattern;
+        if( !sField.isEmpty() )
+            oCommandJson["field"] = sField;
+
+        m_pServerSocket->write( QJsonDocument( oCommandJson ).toJson() );
+        m_pServerSocket->waitForBytesWritten(500);
+    }
+}
+
+void CAgentControlClient::SendInstanceDetails( int nSeconds )
+{
+    if( Connect() )
+    {
+        QJsonObject oCommandJson;
+        oCommandJson["Command"] = "send_instance_details";
+        oCommandJson["seconds"] = nSeconds;
 
         m_pServerSocket->write( QJsonDocument( oCommandJson ).toJson() );
         m_pServerSocket->waitForBytesWritten(500);
@@ -22,7 +22,10 @@ public slots:
     void Stop();
     void Restart();
     void Status();
-    void DumpPerfCounters();
+    void DumpPerfCounters( bool bIncremental = false );
+    // sField: "path" if empty, "help" or "instance"
+    void QueryPerfCounters( QString const& sPattern, QString const& sField = QString() );
+    void SendInstanceDetails( int nSeconds );
 signals:
     void sigNotification( CMessage const& oMsg );
 
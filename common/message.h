@@ -17,7 +17,9 @@ enum class ENotificationEvent : qint32
     NoEvent = 0,
     AgentStarted,
     AgentStopped,
-    CountersInfoDumped
+    CountersInfoDumped,
+    CountersDumpProgress,
+    CountersQueryResult
 };
 
 using CConfigInfo = QMap<QString, QVariant>;
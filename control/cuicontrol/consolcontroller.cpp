@@ -57,7 +57,25 @@ void CConsolController::ProcessArguments()
         else if (a == QLatin1String("-d") || a == QLatin1String("-dump")
                  || a == QLatin1String("d") || a == QLatin1String("dump"))
         {
-            AgentController.DumpPerfCounters();
+            // "dump -i" rewrites only changed objects
+            bool bIncremental = args.size() > 1 && (args.at(1) == QLatin1String("-i")
+                                                    || args.at(1) == QLatin1String("incremental"));
+            AgentController.DumpPerfCounters( bIncremental );
+        }
+        else if (a == QLatin1String("-query") || a == QLatin1String("query"))
+        {
+            // "query [-help|-instance] <pattern>", pattern may contain spaces
+            QString sField;
+            if( args.size() > 1 && (args.at(1) == QLatin1String("-help") || args.at(1) == QLatin1String("-instance")) )
+                sField = args.at(1).mid(1);
+            QString sPattern = args.mid( sField.isEmpty()? 1 : 2 ).join( ' ' );
+            AgentController.QueryPerfCounters( sPattern, sField );
+        }
+        else if (a == QLatin1String("-details") || a == QLatin1String("details"))
+        {
+            // "details [seconds]" sends per instance series hidden by roll-ups
+            int nSeconds = args.size() > 1? args.at(1).toInt() : 0;
+            AgentController.SendInstanceDetails( nSeconds > 0? nSeconds : 600 );
         }
         else if (a == QLatin1String("-status") || a == QLatin1String("status") )
         {
@@ -76,7 +94,9 @@ void CConsolController::ProcessArguments()
                      "\t-start\t\t: Start OddEye Agent\n"
                      "\t-stop\t\t: Stop OddEye Agent\n"
                      "\t-r(estart)\t: Restart OddEye Agent\n"
-                     "\t-d(ump) \t: Dump advanced metrics list\n"
+                     "\t-d(ump) [-i]\t: Dump advanced metrics list, -i updates changed objects only\n"
+                     "\t-query [-help|-instance] <pattern>: Find performance counters, e.g. SQLServer:*Latch*\n"
+                     "\t-details [sec]\t: Send per core/drive/interface series summarized by roll-ups\n"
                      "\t-status \t: Query OddEye Agent status\n"
                      "\t-v(ersion)\t: Print version information.\n"
                      "\t-q(uit)   \t: Quit terminal\n"
@@ -147,6 +167,27 @@ void CConsolController::onNotification(const CMessage &oMsg)
         case ENotificationEvent::AgentStopped:
             sEventText = "OddEye Agent is stopped";
             break;
+        case ENotificationEvent::CountersDumpProgress:
+            {
+                int nDone  = oMsg.GetConfigInfo().value("dump_progress_done").toInt();
+                int nTotal = oMsg.GetConfigInfo().value("dump_progress_total").toInt();
+                sEventText = QString("Dumping performance counters: %1%")
+                        .arg( nTotal > 0? nDone * 100 / nTotal : 0 );
+            }
+            break;
+        case ENotificationEvent::CountersQueryResult:
+            {
+                CConfigInfo const oInfo = oMsg.GetConfigInfo();
+                for( QVariant const& vMatch : oInfo.value("matches").toList() )
+                    sEventText.append( vMatch.toMap().value("config_line").toString() + "\n" );
+
+                sEventText.append( QString("%1 matches, %2 ms")
+                                   .arg( oInfo.value("total_matches").toInt() )
+                                   .arg( oInfo.value("elapsed_ms").toLongLong() ) );
+                if( !oInfo.value("catalog_ready").toBool() )
+                    sEventText.append( "\nCounters catalog is being built, repeat the query later" );
+            }
+            break;
         default:
             break;
         }
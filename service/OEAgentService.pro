@@ -29,10 +29,11 @@ SOURCES += main.cpp \
     winperformancedataprovider.cpp \
     upload/oddeyeclient.cpp \
     upload/sendcontroller.cpp \
+    upload/relayserver.cpp \
+    upload/uploadstatistics.cpp \
     logger.cpp \
     upload/basicoddeyeclient.cpp \
     upload/oddeyecacheuploader.cpp \
-    pinger.cpp \
     application.cpp \
     imetricscategorychecker.cpp \
     imetricchecker.cpp \
@@ -41,11 +42,17 @@ SOURCES += main.cpp \
     checkers/performanceounterhecker.cpp \
     winperformancemetricschecker.cpp \
     checkers/scriptsmetricschecker.cpp \
+    checkers/scriptoutputparser.cpp \
+    checkers/nativepluginchecker.cpp \
+    checkers/statsdchecker.cpp \
+    checkers/latencyprober.cpp \
+    checkers/uploadstatschecker.cpp \
     checkers/system_cpu_stats.cpp \
     checkers/system_disk_stats.cpp \
     checkers/system_memory_stats.cpp \
     checkers/system_network_stats.cpp \
     checkers/system_tcp_stats.cpp \
+    checkers/system_process_stats.cpp \
     checkers/oddeyeselfcheck.cpp \
     agentinitializer.cpp \
     oeagentservice.cpp \
@@ -60,7 +67,18 @@ SOURCES += main.cpp \
     checkers/system_extended_metrics.cpp \
     checkers/advanced_network.cpp \
     performancecountersinfoprovider.cpp \
+    perfdatablockparser.cpp \
+    perfdatablocksource.cpp \
+    bulkperfdatacollector.cpp \
+    derivedmetrics.cpp \
+    thresholdevaluator.cpp \
+    metricsaggregator.cpp \
+    ddsketch.cpp \
+    instancerollup.cpp \
+    deadbandfilter.cpp \
+    tickclock.cpp \
     performancecounterinfodumper.cpp \
+    perfcountercatalog.cpp \
     checkers/utilitycheckers.cpp \
     checkers/advanced_perfcounters_enabled.cpp \
     checkers/vmware_stats.cpp
@@ -78,10 +96,11 @@ HEADERS += \
     winperformancedataprovider.h \
     upload/oddeyeclient.h \
     upload/sendcontroller.h \
+    upload/relayserver.h \
+    upload/uploadstatistics.h \
     logger.h \
     upload/basicoddeyeclient.h \
     upload/oddeyecacheuploader.h \
-    pinger.h \
     winpdhexception.h \
     application.h \
     imetricscategorychecker.h \
@@ -91,11 +110,18 @@ HEADERS += \
     checkers/performanceounterhecker.h \
     winperformancemetricschecker.h \
     checkers/scriptsmetricschecker.h \
+    checkers/scriptoutputparser.h \
+    checkers/nativepluginchecker.h \
+    checkers/oeagentplugin.h \
+    checkers/statsdchecker.h \
+    checkers/latencyprober.h \
+    checkers/uploadstatschecker.h \
     checkers/system_cpu_stats.h \
     checkers/system_disk_stats.h \
     checkers/system_memory_stats.h \
     checkers/system_network_stats.h \
     checkers/system_tcp_stats.h \
+    checkers/system_process_stats.h \
     checkers/oddeyeselfcheck.h \
     agentinitializer.h \
     oeagentservice.h \
@@ -110,7 +136,18 @@ HEADERS += \
     checkers/system_extended_metrics.h \
     checkers/advanced_network.h \
     performancecountersinfoprovider.h \
+    perfdatablockparser.h \
+    perfdatablocksource.h \
+    bulkperfdatacollector.h \
+    derivedmetrics.h \
+    thresholdevaluator.h \
+    metricsaggregator.h \
+    ddsketch.h \
+    instancerollup.h \
+    deadbandfilter.h \
+    tickclock.h \
     performancecounterinfodumper.h \
+    perfcountercatalog.h \
     checkers/utilit_checkers.h \
     checkers/advanced_perfcounters_enabled.h \
     checkers/vmware_stats.h
@@ -1,10 +1,17 @@
 #include "agentinitializer.h"
 #include "configurationmanager.h"
+#include "checkers/nativepluginchecker.h"
 #include "checkers/scriptsmetricschecker.h"
+#include "checkers/statsdchecker.h"
+#include "checkers/latencyprober.h"
+#include "checkers/uploadstatschecker.h"
 #include "logger.h"
+#include "thresholdevaluator.h"
 
 #include <QCoreApplication>
 #include <QDebug>
+#include <QDir>
+#include <QFileInfo>
 
 // static init
 QString CAgentInitialzier::s_sDefaultLogDir = "tmp/oddeye_log";
@@ -18,21 +25,40 @@ void CAgentInitialzier::InitializeLogger()
         throw CInvalidConfigValueException( "log_dir is empty" );
     }
 
-    Logger::getInstance().setLogsFolderPath( sLogsDirPath );
+    // rotation settings go first, setLogsFolderPath prunes the backups with them
+    // log_compress: rotated files are gzipped in background
+    Logger::getInstance().setCompressRotatedLogs( ConfMgr.GetMainConfiguration().Value<bool>( "SelfConfig/log_compress", true ) );
 
     // log_rotate_seconds
     qint64 nLogRotateSeconds = ConfMgr.GetMainConfiguration().Value<qint64>("SelfConfig/log_rotate_seconds", 3600);
     Logger::getInstance().setLogRotateSeconds( nLogRotateSeconds );
 
+    // log_rotate_mb: rotation by size, also when log_rotate_seconds is 0
+    qint64 nLogRotateBytes = static_cast<qint64>( ConfMgr.GetMainConfiguration().Value<double>("SelfConfig/log_rotate_mb", 0) * 1024 * 1024 );
+    Logger::getInstance().setLogRotateBytes( nLogRotateBytes );
+
     // log_rotate_backups
     int nBackupLogFilesCount = ConfMgr.GetMainConfiguration().Value<int>("SelfConfig/log_rotate_backups", 24);
     Logger::getInstance().setBackupFileCount( nBackupLogFilesCount );
 
-    if( nLogRotateSeconds <= 0 || nBackupLogFilesCount <= 0)
+    Logger::getInstance().setLogsFolderPath( sLogsDirPath );
+
+    if( ( nLogRotateSeconds <= 0 && nLogRotateBytes <= 0 ) || nBackupLogFilesCount <= 0)
         LOG_ERROR("Logging disabled");
 
     bool bDebugLoggingEnabled = ConfMgr.GetMainConfiguration().Value<bool>( "SelfConfig/debug_log", false );
     Logger::getInstance().SetDebugLoggingEnabled( bDebugLoggingEnabled );
+
+    // log_overflow: "drop" records when the log queue is full or "block" the caller
+    QString sLogOverflow = ConfMgr.GetMainConfiguration().Value<QString>( "SelfConfig/log_overflow", "drop" );
+    if( !Logger::getInstance().setOverflowPolicy( sLogOverflow ) )
+        throw CInvalidConfigValueException( "log_overflow = " + sLogOverflow );
+
+    // log_flush_level: records of this severity are written at once, others every log_flush_ms
+    QString sLogFlushLevel = ConfMgr.GetMainConfiguration().Value<QString>( "SelfConfig/log_flush_level", "warning" );
+    if( !Logger::getInstance().setFlushLevel( sLogFlushLevel ) )
+        throw CInvalidConfigValueException( "log_flush_level = " + sLogFlushLevel );
+    Logger::getInstance().setFlushIntervalMsecs( ConfMgr.GetMainConfiguration().Value<int>( "SelfConfig/log_flush_ms", 1000 ) );
 }
 
 void CAgentInitialzier::InitializeEngine(CEngine *pEngine)
@@ -47,10 +73,50 @@ void CAgentInitialzier::InitializeEngine(CEngine *pEngine)
     // Setup Main Settings
     double dUpdateSecs = ConfMgr.GetMainConfiguration().Value<double>("SelfConfig/check_period_seconds", 1);
     int nMsec = static_cast<int>( dUpdateSecs * 1000 );
-    pEngine->SetUpdateInterval( nMsec );
+
+    // Sampling faster than sending: points are aggregated over the check period
+    double dSampleSecs = ConfMgr.GetMainConfiguration().Value<double>("SelfConfig/sample_period_seconds", dUpdateSecs);
+    int nSampleMsec = static_cast<int>( dSampleSecs * 1000 );
+    if( nSampleMsec <= 0 )
+        throw CInvalidConfigValueException( "sample_period_seconds = " + QString::number( dSampleSecs ) );
+
+    if( nSampleMsec < nMsec )
+    {
+        int nWindow = qRound( double(nMsec) / nSampleMsec );
+        pEngine->MetricsAggregator().SetAggregates( ConfMgr.GetMainConfiguration().Value<QStringList>(
+                                                        "SelfConfig/aggregates", QStringList() << "avg" << "min" << "max" ) );
+        pEngine->MetricsAggregator().SetQuantiles( ConfMgr.GetMainConfiguration().Value<QStringList>(
+                                                       "SelfConfig/quantile_metrics", QStringList() ),
+                                                   ConfMgr.GetMainConfiguration().Value<QStringList>(
+                                                       "SelfConfig/quantiles", QStringList() << "50" << "90" << "99" ) );
+        pEngine->MetricsAggregator().SetWindow( nWindow );
+        pEngine->SetUpdateInterval( nSampleMsec );
+
+        LOG_INFO( QString( "Sample period is: %1 msec, %2 samples per point" ).arg( nSampleMsec ).arg( nWindow ) );
+    }
+    else
+    {
+        pEngine->MetricsAggregator().SetWindow( 1 );
+        pEngine->SetUpdateInterval( nMsec );
+    }
 
     LOG_INFO( "Check period is: " + QString::number(int(dUpdateSecs)) + " sec" );
 
+    // Alerting: value must drop by hysteresis percents below threshold to clear the alert,
+    // and a new state must last for the min duration to be reported
+    double dHysteresisPercent = ConfMgr.GetMainConfiguration().Value<double>("SelfConfig/alert_hysteresis_percent", 0);
+    double dMinDurationSecs   = ConfMgr.GetMainConfiguration().Value<double>("SelfConfig/alert_min_duration_seconds", 0);
+    CThresholdEvaluator::Instance().SetHysteresisPercent( dHysteresisPercent );
+    CThresholdEvaluator::Instance().SetMinDuration( static_cast<qint64>( dMinDurationSecs * 1000 ) );
+
+    // Derived metrics, calculated from collected values
+    pEngine->DerivedMetrics().Load( ConfMgr.GetMainConfiguration().GetSection( "DerivedMetrics" ) );
+    // Change-only reporting, sections of other configs may override these values
+    pEngine->DerivedDeadband().SetSettings( ConfMgr.GetMainConfiguration().Value<bool>("SelfConfig/change_only", false),
+                                            ConfMgr.GetMainConfiguration().Value<double>("SelfConfig/deadband", 0),
+                                            ConfMgr.GetMainConfiguration().Value<double>("SelfConfig/deadband_percent", 0),
+                                            ConfMgr.GetMainConfiguration().Value<int>("SelfConfig/heartbeat_ticks", 10) );
+
     auto lstAllConfigs = ConfMgr.GetAllConfigurations();
     for( ConfigSPtr& pCurrentConfig : lstAllConfigs  )
     {
@@ -136,6 +202,37 @@ void CAgentInitialzier::InitializeEngine(CEngine *pEngine)
         LOG_INFO("No enabled scripts");
     }
 
+    //
+    //  In-process plugins, each one gets the section named after its library file
+    //
+    QStringList lstPlugins = ConfMgr.GetMainConfiguration().Value<QStringList>( "SelfConfig/plugins", QStringList() );
+    for( QString sPluginPath : lstPlugins )
+    {
+        sPluginPath = QDir( ConfMgr.GetAgentDirPath() ).absoluteFilePath( sPluginPath.trimmed() );
+        std::shared_ptr<CNativePluginChecker> pPluginChecker = std::make_shared<CNativePluginChecker>( sPluginPath );
+        pPluginChecker->SetConfigSection( ConfMgr.GetMainConfiguration().GetSection( QFileInfo( sPluginPath ).completeBaseName() ) );
+        pEngine->AddChecker( pPluginChecker );
+    }
+
+    //
+    //  Metrics pushed by applications in StatsD format
+    //
+    int nStatsDPort = ConfMgr.GetMainConfiguration().Value<int>( "SelfConfig/statsd_port", 0 );
+    if( nStatsDPort > 0 && nStatsDPort <= 65535 )
+        pEngine->AddChecker( std::make_shared<CStatsDChecker>( static_cast<quint16>( nStatsDPort ) ) );
+
+    //
+    //  Round trip time, loss and jitter to the listed hosts
+    //
+    QStringList lstProbeTargets = ConfMgr.GetMainConfiguration().Value<QStringList>( "SelfConfig/probe_targets", QStringList() );
+    if( !lstProbeTargets.isEmpty() )
+        pEngine->AddChecker( std::make_shared<CLatencyProberChecker>( lstProbeTargets ) );
+
+    //
+    //  Upload pipeline self metrics
+    //
+    if( ConfMgr.GetMainConfiguration().Value<bool>( "SelfConfig/upload_statistics", true ) )
+        pEngine->AddChecker( std::make_shared<CUploadStatsChecker>() );
 }
 
 IMetricsCategoryCheckerSPtr CAgentInitialzier::CreateCheckerByConfigName( QString const& sConfigName,
@@ -1,5 +1,7 @@
 #include "basicmetricchecker.h"
 #include "exception.h"
+#include "thresholdevaluator.h"
+#include "tickclock.h"
 
 CBasicMetricChecker::CBasicMetricChecker(const QString &sMetricName,
                                           EMetricDataType eMetricDataType,
@@ -17,12 +19,22 @@ CBasicMetricChecker::CBasicMetricChecker(const QString &sMetricName,
       m_dSevereValue( dSevereValue ),
       m_sInstanceType( sInstanceType ),
       m_sInstanceName( sInstanceName ),
-      m_bWereLastValueHighOrSevery(false  /*Nafsyaki send OK at initial checking*/ /*false*/ )
+      m_nThresholdSeries( -1 )
 {
     Q_ASSERT( !sMetricName.isEmpty() );
     Q_ASSERT( nReaction >= -3 && nReaction <=0);
     Q_ASSERT(  dHighValue == -1 || dSevereValue == -1 || dHighValue < dSevereValue );
     // TODO: Handle the case when dHighValue >= dSevereValue
+
+    // thresholds are evaluated for all metrics at once after collection
+    if( dHighValue != -1 || dSevereValue != -1 )
+        m_nThresholdSeries = CThresholdEvaluator::Instance().AddSeries( dHighValue, dSevereValue );
+}
+
+CBasicMetricChecker::~CBasicMetricChecker()
+{
+    if( m_nThresholdSeries >= 0 )
+        CThresholdEvaluator::Instance().RemoveSeries( m_nThresholdSeries );
 }
 
 MetricDataSPtr CBasicMetricChecker::CheckMetric()
@@ -30,7 +42,7 @@ MetricDataSPtr CBasicMetricChecker::CheckMetric()
     // Create metric data
     MetricDataSPtr pMetric = std::make_shared<CMetricData>();
 
-    pMetric->SetTime( QDateTime::currentDateTime() );
+    pMetric->SetTime( CTickClock::Instance().GetTickTime() );
     pMetric->SetName(m_sMetricName);
     pMetric->SetDataType(m_eMetricDataType);
     pMetric->SetMetricType(m_sMetricType);
@@ -49,31 +61,8 @@ MetricDataSPtr CBasicMetricChecker::CheckMetric()
 
 
 
-    // Set data severity
-    EMetricDataSeverity eSeverity = EMetricDataSeverity::Normal;
-    if( m_dSevereValue != -1 && dValue >= m_dSevereValue )
-        eSeverity = EMetricDataSeverity::Severe;
-    else if( m_dHighValue != -1 && dValue > m_dHighValue )
-        eSeverity = EMetricDataSeverity::High;
-    
-    if( eSeverity == EMetricDataSeverity::High
-            || eSeverity == EMetricDataSeverity::Severe )
-    {
-        QString sErrorMsg = QString("%4: %1 value is %2: %3").arg( m_sMetricName,
-                                                                   ToString( eSeverity ).toLower(),
-                                                                   QString::number(dValue),
-                                                                   eSeverity == EMetricDataSeverity::High? "WARNING" : "ERROR"
-                                                                 );
-        pMetric->SetSeverityDescriptor( GetMetricName(), eSeverity, -2, sErrorMsg );
-        m_bWereLastValueHighOrSevery = true;
-    }
-    else if( eSeverity == EMetricDataSeverity::Normal && m_bWereLastValueHighOrSevery )
-    {
-            pMetric->SetSeverityDescriptor( GetMetricName(), eSeverity, 0 );
-            m_bWereLastValueHighOrSevery = false;
-    }
-
-
+    // severity is set by CThresholdEvaluator on state changes
+    pMetric->SetThresholdSeries( m_nThresholdSeries );
 
     return pMetric;
 }
@@ -23,6 +23,7 @@ public:
                          double  dSevereValue         = -1,
                          QString const& sInstanceType = QString(),
                          QString const& sInstanceName = QString()  );
+    ~CBasicMetricChecker();
 
 public:
     // IMetricChecker interface
@@ -53,7 +54,7 @@ private:
     QString          m_sInstanceType;
     QString          m_sInstanceName;
     ValueCheckerFunc m_pValueCheckerFunc;
-    bool             m_bWereLastValueHighOrSevery;
+    int              m_nThresholdSeries;
 };
 
 using BasicMetricCheckerSPtr = std::shared_ptr<CBasicMetricChecker>;
@@ -0,0 +1,446 @@
+#include "bulkperfdatacollector.h"
+#include "winpdhexception.h"
+
+#include <QHash>
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+//
+//  Counter types (winperf.h) supported by the calculator
+//
+const uint32_t c_nPerfCounterRawcountHex         = 0x00000000;
+const uint32_t c_nPerfCounterLargeRawcountHex    = 0x00000100;
+const uint32_t c_nPerfCounterRawcount            = 0x00010000;
+const uint32_t c_nPerfCounterLargeRawcount       = 0x00010100;
+const uint32_t c_nPerfCounterDelta               = 0x00400400;
+const uint32_t c_nPerfCounterLargeDelta          = 0x00400500;
+const uint32_t c_nPerfSampleCounter              = 0x00410400;
+const uint32_t c_nPerfCounterQueuelenType        = 0x00450400;
+const uint32_t c_nPerfCounterLargeQueuelenType   = 0x00450500;
+const uint32_t c_nPerfCounter100nsQueuelenType   = 0x00550500;
+const uint32_t c_nPerfCounterObjTimeQueuelenType = 0x00650500;
+const uint32_t c_nPerfCounterCounter             = 0x10410400;
+const uint32_t c_nPerfCounterBulkCount           = 0x10410500;
+const uint32_t c_nPerfRawFraction                = 0x20020400;
+const uint32_t c_nPerfLargeRawFraction           = 0x20020500;
+const uint32_t c_nPerfCounterTimer               = 0x20410500;
+const uint32_t c_nPerf100nsecTimer               = 0x20510500;
+const uint32_t c_nPerfObjTimeTimer               = 0x20610500;
+const uint32_t c_nPerfSampleFraction             = 0x20C20400;
+const uint32_t c_nPerfCounterTimerInv            = 0x21410500;
+const uint32_t c_nPerf100nsecTimerInv            = 0x21510500;
+const uint32_t c_nPerfAverageTimer               = 0x30020400;
+const uint32_t c_nPerfElapsedTime                = 0x30240500;
+const uint32_t c_nPerfAverageBulk                = 0x40020500;
+
+// Timer selection bits of counter type
+const uint32_t c_nPerfTimerMask                  = 0x00300000;
+const uint32_t c_nPerfTimer100ns                 = 0x00100000;
+const uint32_t c_nPerfObjectTimer                = 0x00200000;
+
+void SelectTimer( uint32_t nCounterType, SPerfCounterSample const& oSample, int64_t& nTime, int64_t& nFreq )
+{
+    switch( nCounterType & c_nPerfTimerMask )
+    {
+    case c_nPerfTimer100ns:
+        nTime = oSample.nTime100nSec;
+        nFreq = 10000000;
+        break;
+    case c_nPerfObjectTimer:
+        nTime = oSample.nObjectTime;
+        nFreq = oSample.nObjectFreq;
+        break;
+    default:
+        nTime = oSample.nTime;
+        nFreq = oSample.nFreq;
+        break;
+    }
+}
+
+// Identity of an instance used when positions of two data blocks do not match:
+// name, unique id, parent name and ordinal number among the instances with the same key
+QByteArray MakeInstanceKey( SPerfDataSnapshot const& oSnapshot, SPerfInstance const& oInstance )
+{
+    QByteArray aKey( reinterpret_cast<char const*>( oInstance.oName.pData ), int(oInstance.oName.nBytes) );
+    aKey.append( reinterpret_cast<char const*>( &oInstance.nUniqueId ), sizeof(oInstance.nUniqueId) );
+
+    SPerfInstance const* pParent = oSnapshot.FindParentInstance( oInstance );
+    if( pParent )
+        aKey.append( reinterpret_cast<char const*>( pParent->oName.pData ), int(pParent->oName.nBytes) );
+
+    return aKey;
+}
+
+void AppendOrdinal( QByteArray& aKey, QHash<QByteArray, int32_t>& mapOrdinals )
+{
+    int32_t nOrdinal = mapOrdinals[aKey]++;
+    aKey.append( reinterpret_cast<char const*>( &nOrdinal ), sizeof(nOrdinal) );
+}
+}
+
+
+CBulkPerfDataCollector::CBulkPerfDataCollector( PerfDataBlockSourceSPtr pSource )
+    : m_pSource( pSource ),
+      m_nCurrent( 0 ),
+      m_nUpdateCount( 0 )
+{
+    Q_ASSERT( m_pSource );
+}
+
+uint32_t CBulkPerfDataCollector::RegisterObject( QString const& sObjectName )
+{
+    uint32_t nIndex = GetNameIndex( sObjectName );
+    if( nIndex == 0 )
+        throw CWinCounterRetrieveException( "Performance object not found: " + sObjectName );
+
+    if( std::find( m_aObjectIndexes.begin(), m_aObjectIndexes.end(), nIndex ) == m_aObjectIndexes.end() )
+    {
+        m_aObjectIndexes.push_back( nIndex );
+        if( !m_sQuery.isEmpty() )
+            m_sQuery.append( ' ' );
+        m_sQuery.append( QString::number( nIndex ) );
+    }
+
+    return nIndex;
+}
+
+bool CBulkPerfDataCollector::HasRegisteredObjects() const
+{
+    return !m_aObjectIndexes.empty();
+}
+
+uint32_t CBulkPerfDataCollector::GetNameIndex( QString const& sName )
+{
+    LoadNameTable();
+    return m_oNameTable.FindIndex( reinterpret_cast<char16_t const*>( sName.utf16() ), uint32_t(sName.size()) );
+}
+
+void CBulkPerfDataCollector::LoadNameTable()
+{
+    if( !m_aNameTableData.isEmpty() )
+        return;
+
+    m_aNameTableData = m_pSource->ReadCounterNames();
+    m_oNameTable.Load( m_aNameTableData.constData(), size_t(m_aNameTableData.size()) );
+}
+
+void CBulkPerfDataCollector::Update()
+{
+    if( m_aObjectIndexes.empty() )
+        return;
+
+    // Parse into the older buffer, so the current one becomes previous
+    int nNext = 1 - m_nCurrent;
+    try
+    {
+        m_pSource->ReadDataBlock( m_sQuery, m_aBuffers[nNext] );
+        m_aArenas[nNext].Reset();
+        CPerfDataBlockParser oParser( m_aArenas[nNext] );
+        m_aSnapshots[nNext] = oParser.Parse( m_aBuffers[nNext].constData(), size_t(m_aBuffers[nNext].size()) );
+    }
+    catch( ... )
+    {
+        // buffer of previous data is overwritten
+        m_aSnapshots[nNext] = SPerfDataSnapshot();
+        throw;
+    }
+
+    m_nCurrent = nNext;
+    ++m_nUpdateCount;
+
+    SPerfDataSnapshot const& oPrevious = m_aSnapshots[1 - m_nCurrent];
+    for( uint32_t nObjectIndex : m_aObjectIndexes )
+    {
+        SPerfObject const* pObject = GetObject( nObjectIndex );
+        std::vector<int32_t>& aMap = m_mapInstanceMaps[nObjectIndex];
+        if( pObject )
+            MatchInstances( *pObject, oPrevious.FindObject( nObjectIndex ), aMap );
+        else
+            aMap.clear();
+    }
+}
+
+quint64 CBulkPerfDataCollector::GetUpdateCount() const
+{
+    return m_nUpdateCount;
+}
+
+SPerfDataSnapshot const& CBulkPerfDataCollector::GetSnapshot() const
+{
+    return m_aSnapshots[m_nCurrent];
+}
+
+SPerfObject const* CBulkPerfDataCollector::GetObject( uint32_t nObjectIndex ) const
+{
+    return GetSnapshot().FindObject( nObjectIndex );
+}
+
+void CBulkPerfDataCollector::MatchInstances( SPerfObject const& oObject,
+                                             SPerfObject const* pPrevObject,
+                                             std::vector<int32_t>& aMap ) const
+{
+    aMap.assign( oObject.nInstanceCount, -1 );
+    if( !pPrevObject || !oObject.bHasInstances || pPrevObject->nInstanceCount == 0 )
+        return;
+
+    // Fast path: instance list did not change
+    bool bSamePositions = pPrevObject->nInstanceCount == oObject.nInstanceCount;
+    for( uint32_t i = 0; bSamePositions && i < oObject.nInstanceCount; ++i )
+    {
+        SPerfInstance const& oCurrent  = oObject.pInstances[i];
+        SPerfInstance const& oPrevious = pPrevObject->pInstances[i];
+        bSamePositions = oCurrent.nUniqueId == oPrevious.nUniqueId
+                      && oCurrent.nParentInstance == oPrevious.nParentInstance
+                      && oCurrent.oName == oPrevious.oName;
+    }
+
+    if( bSamePositions )
+    {
+        std::iota( aMap.begin(), aMap.end(), 0 );
+        return;
+    }
+
+    // Instances were added or removed, match by identity
+    SPerfDataSnapshot const& oSnapshot = GetSnapshot();
+    SPerfDataSnapshot const& oPrevSnapshot = m_aSnapshots[1 - m_nCurrent];
+
+    QHash<QByteArray, int32_t> mapPrevPositions;
+    QHash<QByteArray, int32_t> mapOrdinals;
+    mapPrevPositions.reserve( int(pPrevObject->nInstanceCount) );
+    for( uint32_t i = 0; i < pPrevObject->nInstanceCount; ++i )
+    {
+        QByteArray aKey = MakeInstanceKey( oPrevSnapshot, pPrevObject->pInstances[i] );
+        AppendOrdinal( aKey, mapOrdinals );
+        mapPrevPositions.insert( aKey, int32_t(i) );
+    }
+
+    mapOrdinals.clear();
+    for( uint32_t i = 0; i < oObject.nInstanceCount; ++i )
+    {
+        QByteArray aKey = MakeInstanceKey( oSnapshot, oObject.pInstances[i] );
+        AppendOrdinal( aKey, mapOrdinals );
+        aMap[i] = mapPrevPositions.value( aKey, -1 );
+    }
+}
+
+CBulkPerfDataCollector::SCounter CBulkPerfDataCollector::ResolveCounter( uint32_t nObjectIndex, uint32_t nCounterIndex ) const
+{
+    SCounter oResult;
+
+    // base counter, if any, immediately follows the counter it is used for
+    auto fnFindCounter = [nCounterIndex]( SPerfObject const& oObject,
+                                          SPerfCounterDefinition const*& pCounter,
+                                          SPerfCounterDefinition const*& pBase )
+    {
+        for( uint32_t i = 0; i < oObject.nCounterCount; ++i )
+        {
+            if( oObject.pCounters[i].nNameIndex != nCounterIndex
+                    || CPerfDataBlockParser::IsBaseCounter( oObject.pCounters[i].nCounterType ) )
+                continue;
+
+            pCounter = &oObject.pCounters[i];
+            if( i + 1 < oObject.nCounterCount && CPerfDataBlockParser::IsBaseCounter( oObject.pCounters[i + 1].nCounterType ) )
+                pBase = &oObject.pCounters[i + 1];
+            return;
+        }
+    };
+
+    oResult.pObject = GetObject( nObjectIndex );
+    if( !oResult.pObject )
+        return oResult;
+    fnFindCounter( *oResult.pObject, oResult.pCounter, oResult.pBase );
+
+    oResult.pPrevObject = m_aSnapshots[1 - m_nCurrent].FindObject( nObjectIndex );
+    if( oResult.pPrevObject )
+        fnFindCounter( *oResult.pPrevObject, oResult.pPrevCounter, oResult.pPrevBase );
+
+    auto it = m_mapInstanceMaps.find( nObjectIndex );
+    if( it != m_mapInstanceMaps.end() )
+        oResult.pInstanceMap = &it->second;
+
+    return oResult;
+}
+
+bool CBulkPerfDataCollector::ReadSample( SPerfDataSnapshot const& oSnapshot,
+                                         SPerfObject const& oObject,
+                                         SPerfCounterDefinition const& oCounter,
+                                         SPerfCounterDefinition const* pBase,
+                                         uint32_t nInstance,
+                                         SPerfCounterSample& oSample ) const
+{
+    uint8_t const* pData = oObject.pCounterData;
+    uint32_t nDataLength = oObject.nCounterDataLength;
+    if( oObject.bHasInstances )
+    {
+        if( nInstance >= oObject.nInstanceCount )
+            return false;
+        pData       = oObject.pInstances[nInstance].pCounterData;
+        nDataLength = oObject.pInstances[nInstance].nCounterDataLength;
+    }
+
+    if( !CPerfDataBlockParser::ReadCounterValue( oCounter, pData, nDataLength, oSample.nValue ) )
+        return false;
+    if( pBase && !CPerfDataBlockParser::ReadCounterValue( *pBase, pData, nDataLength, oSample.nBase ) )
+        return false;
+
+    oSample.nTime        = oSnapshot.nPerfTime;
+    oSample.nFreq        = oSnapshot.nPerfFreq;
+    oSample.nTime100nSec = oSnapshot.nPerfTime100nSec;
+    oSample.nObjectTime  = oObject.nPerfTime;
+    oSample.nObjectFreq  = oObject.nPerfFreq;
+    return true;
+}
+
+bool CBulkPerfDataCollector::GetRawCounterValue( SCounter const& oCounter, uint32_t nInstance, uint64_t& nValue ) const
+{
+    SPerfCounterSample oSample;
+    if( !oCounter.IsValid() || !ReadSample( GetSnapshot(), *oCounter.pObject, *oCounter.pCounter, nullptr, nInstance, oSample ) )
+        return false;
+
+    nValue = oSample.nValue;
+    return true;
+}
+
+bool CBulkPerfDataCollector::GetCounterValue( SCounter const& oCounter, uint32_t nInstance, double& dValue ) const
+{
+    if( !oCounter.IsValid() )
+        return false;
+
+    SPerfCounterSample oCurrent;
+    if( !ReadSample( GetSnapshot(), *oCounter.pObject, *oCounter.pCounter, oCounter.pBase, nInstance, oCurrent ) )
+        return false;
+
+    SPerfCounterSample oPrevious;
+    SPerfCounterSample const* pPrevious = nullptr;
+    if( oCounter.pPrevObject && oCounter.pPrevCounter )
+    {
+        int32_t nPrevInstance = 0;
+        if( oCounter.pObject->bHasInstances )
+        {
+            nPrevInstance = -1;
+            if( oCounter.pInstanceMap && nInstance < oCounter.pInstanceMap->size() )
+                nPrevInstance = (*oCounter.pInstanceMap)[nInstance];
+        }
+
+        if( nPrevInstance >= 0
+                && ReadSample( m_aSnapshots[1 - m_nCurrent], *oCounter.pPrevObject, *oCounter.pPrevCounter,
+                               oCounter.pPrevBase, uint32_t(nPrevInstance), oPrevious ) )
+            pPrevious = &oPrevious;
+    }
+
+    return CalculateCounterValue( oCounter.pCounter->nCounterType, oCurrent, pPrevious, dValue );
+}
+
+// Formulas follow the counter type reference of winperf.h
+bool CBulkPerfDataCollector::CalculateCounterValue( uint32_t nCounterType,
+                                                    SPerfCounterSample const& oCurrent,
+                                                    SPerfCounterSample const* pPrevious,
+                                                    double& dValue )
+{
+    //
+    //  Instantaneous counters
+    //
+    switch( nCounterType )
+    {
+    case c_nPerfCounterRawcountHex:
+    case c_nPerfCounterLargeRawcountHex:
+    case c_nPerfCounterRawcount:
+    case c_nPerfCounterLargeRawcount:
+        dValue = double( oCurrent.nValue );
+        return true;
+
+    case c_nPerfRawFraction:
+    case c_nPerfLargeRawFraction:
+        if( oCurrent.nBase == 0 )
+            return false;
+        dValue = 100.0 * double( oCurrent.nValue ) / double( oCurrent.nBase );
+        return true;
+
+    case c_nPerfElapsedTime:
+        if( oCurrent.nObjectFreq <= 0 )
+            return false;
+        dValue = double( oCurrent.nObjectTime - int64_t( oCurrent.nValue ) ) / double( oCurrent.nObjectFreq );
+        return true;
+
+    default:
+        break;
+    }
+
+    //
+    //  Counters calculated from two samples
+    //
+    if( !pPrevious || oCurrent.nValue < pPrevious->nValue )
+        return false;
+
+    double dDelta = double( oCurrent.nValue - pPrevious->nValue );
+
+    int64_t nTime = 0, nFreq = 0, nPrevTime = 0, nPrevFreq = 0;
+    SelectTimer( nCounterType, oCurrent, nTime, nFreq );
+    SelectTimer( nCounterType, *pPrevious, nPrevTime, nPrevFreq );
+    double dTimeDelta = double( nTime - nPrevTime );
+    double dBaseDelta = double( int64_t( oCurrent.nBase - pPrevious->nBase ) );
+
+    switch( nCounterType )
+    {
+    case c_nPerfCounterDelta:
+    case c_nPerfCounterLargeDelta:
+        dValue = dDelta;
+        return true;
+
+    case c_nPerfCounterCounter:
+    case c_nPerfCounterBulkCount:
+    case c_nPerfSampleCounter:
+        if( dTimeDelta <= 0 || nFreq <= 0 )
+            return false;
+        dValue = dDelta / (dTimeDelta / double( nFreq ));
+        return true;
+
+    case c_nPerfCounterTimer:
+    case c_nPerf100nsecTimer:
+    case c_nPerfObjTimeTimer:
+        if( dTimeDelta <= 0 )
+            return false;
+        dValue = 100.0 * dDelta / dTimeDelta;
+        return true;
+
+    case c_nPerfCounterTimerInv:
+    case c_nPerf100nsecTimerInv:
+        if( dTimeDelta <= 0 )
+            return false;
+        dValue = std::max( 0.0, 100.0 * (1.0 - dDelta / dTimeDelta) );
+        return true;
+
+    case c_nPerfCounterQueuelenType:
+    case c_nPerfCounterLargeQueuelenType:
+    case c_nPerfCounter100nsQueuelenType:
+    case c_nPerfCounterObjTimeQueuelenType:
+        if( dTimeDelta <= 0 )
+            return false;
+        dValue = dDelta / dTimeDelta;
+        return true;
+
+    case c_nPerfAverageTimer:
+        if( dBaseDelta <= 0 || oCurrent.nFreq <= 0 )
+            return false;
+        dValue = (dDelta / double( oCurrent.nFreq )) / dBaseDelta;
+        return true;
+
+    case c_nPerfAverageBulk:
+        if( dBaseDelta <= 0 )
+            return false;
+        dValue = dDelta / dBaseDelta;
+        return true;
+
+    case c_nPerfSampleFraction:
+        if( dBaseDelta <= 0 )
+            return false;
+        dValue = 100.0 * dDelta / dBaseDelta;
+        return true;
+
+    default:
+        // Precision and multi timers, text and no-data counters are not supported
+        return false;
+    }
+}
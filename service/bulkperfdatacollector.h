@@ -0,0 +1,136 @@
+#ifndef BULKPERFDATACOLLECTOR_H
+#define BULKPERFDATACOLLECTOR_H
+
+//
+//  Includes
+//
+#include "perfdatablockparser.h"
+#include "perfdatablocksource.h"
+
+#include <QByteArray>
+#include <QString>
+#include <map>
+#include <memory>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// struct SPerfCounterSample
+///
+/// Raw counter value with the time stamps needed to turn it into a formatted value
+///
+struct SPerfCounterSample
+{
+    uint64_t nValue          = 0;
+    uint64_t nBase           = 0;   // value of the following base counter, if any
+    int64_t  nTime           = 0;   // PERF_DATA_BLOCK::PerfTime
+    int64_t  nFreq           = 0;   // PERF_DATA_BLOCK::PerfFreq
+    int64_t  nTime100nSec    = 0;   // PERF_DATA_BLOCK::PerfTime100nSec
+    int64_t  nObjectTime     = 0;   // PERF_OBJECT_TYPE::PerfTime
+    int64_t  nObjectFreq     = 0;   // PERF_OBJECT_TYPE::PerfFreq
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CBulkPerfDataCollector
+///
+/// Reads all registered performance objects with a single data block query per
+/// update and calculates counter values directly from raw data, without PDH.
+/// Intended for objects with many instances (Process, Thread) where PDH needs a
+/// counter handle per instance.
+///
+/// Two data blocks are kept: current and previous. Instances of the current
+/// block are matched to the previous one by position, falling back to a name
+/// lookup when the instance list has changed.
+///
+class CBulkPerfDataCollector
+{
+public:
+    //
+    //  Counter of an object resolved against the current data block.
+    //  Valid until the next Update()
+    //
+    struct SCounter
+    {
+        SPerfObject const*            pObject      = nullptr;
+        SPerfObject const*            pPrevObject  = nullptr;
+        SPerfCounterDefinition const* pCounter     = nullptr;
+        SPerfCounterDefinition const* pBase        = nullptr;
+        SPerfCounterDefinition const* pPrevCounter = nullptr;
+        SPerfCounterDefinition const* pPrevBase    = nullptr;
+        std::vector<int32_t> const*   pInstanceMap = nullptr;  // current to previous positions
+
+        bool IsValid() const { return pCounter != nullptr; }
+    };
+
+public:
+    explicit CBulkPerfDataCollector( PerfDataBlockSourceSPtr pSource );
+    CBulkPerfDataCollector( CBulkPerfDataCollector const& ) = delete;
+    CBulkPerfDataCollector& operator=( CBulkPerfDataCollector const& ) = delete;
+
+public:
+    //
+    //	Main Interface
+    //
+    // Object and counter names are English. Returns the name index of the object
+    uint32_t RegisterObject( QString const& sObjectName );
+    bool     HasRegisteredObjects() const;
+    // Returns 0 if name is unknown
+    uint32_t GetNameIndex( QString const& sName );
+
+    void     Update();
+    quint64  GetUpdateCount() const;
+
+    SPerfDataSnapshot const& GetSnapshot() const;
+    SPerfObject const*       GetObject( uint32_t nObjectIndex ) const;
+
+    SCounter ResolveCounter( uint32_t nObjectIndex, uint32_t nCounterIndex ) const;
+    // Calculates value of the counter for the instance at the given position of the
+    // current object. Instance position is ignored for single instance objects.
+    // Returns false if value is not available, e.g. a rate on the first update
+    bool     GetCounterValue( SCounter const& oCounter, uint32_t nInstance, double& dValue ) const;
+    bool     GetRawCounterValue( SCounter const& oCounter, uint32_t nInstance, uint64_t& nValue ) const;
+
+    static bool CalculateCounterValue( uint32_t nCounterType,
+                                       SPerfCounterSample const& oCurrent,
+                                       SPerfCounterSample const* pPrevious,
+                                       double& dValue );
+
+private:
+    void LoadNameTable();
+    void MatchInstances( SPerfObject const& oObject, SPerfObject const* pPrevObject, std::vector<int32_t>& aMap ) const;
+    bool ReadSample( SPerfDataSnapshot const& oSnapshot,
+                     SPerfObject const& oObject,
+                     SPerfCounterDefinition const& oCounter,
+                     SPerfCounterDefinition const* pBase,
+                     uint32_t nInstance,
+                     SPerfCounterSample& oSample ) const;
+
+private:
+    //
+    //	Content
+    //
+    PerfDataBlockSourceSPtr m_pSource;
+
+    QByteArray     m_aNameTableData;
+    CPerfNameTable m_oNameTable;
+
+    std::vector<uint32_t> m_aObjectIndexes;
+    QString               m_sQuery;
+
+    // double buffered data blocks
+    QByteArray        m_aBuffers[2];
+    CPerfDataArena    m_aArenas[2];
+    SPerfDataSnapshot m_aSnapshots[2];
+    int               m_nCurrent;
+    quint64           m_nUpdateCount;
+
+    std::map<uint32_t, std::vector<int32_t>> m_mapInstanceMaps;
+};
+
+using BulkPerfDataCollectorSPtr = std::shared_ptr<CBulkPerfDataCollector>;
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // BULKPERFDATACOLLECTOR_H
@@ -0,0 +1,374 @@
+#include "latencyprober.h"
+#include "../commonexceptions.h"
+#include "../configurationmanager.h"
+#include "../logger.h"
+#include "../tickclock.h"
+
+// Qt
+#include <QTcpSocket>
+#include <QTimer>
+
+#include <cmath>
+#include <functional>
+
+#ifdef Q_OS_WIN
+#include "winsock2.h"
+#include "iphlpapi.h"
+#include "icmpapi.h"
+#include <QWinEventNotifier>
+#include <vector>
+#endif
+
+namespace
+{
+// port-less targets, where ICMP is not available
+const quint16 c_nFallbackPort = 80;
+// rounds are moved by up to this part of the period
+const int     c_nJitterDivisor = 10;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CIcmpEcho
+///
+/// Asynchronous ICMP echo: the reply is waited by the event loop, not by a thread.
+/// Only Windows allows echo requests without raw sockets; on other platforms
+/// Send() fails and the caller falls back to TCP.
+///
+class CIcmpEcho
+{
+public:
+    // the RTT is negative when the echo failed or timed out
+    using DoneCallback = std::function<void(double)>;
+
+#ifdef Q_OS_WIN
+    CIcmpEcho()
+        : m_hIcmp( IcmpCreateFile() )
+    {
+    }
+
+    ~CIcmpEcho()
+    {
+        // reply buffers are written until the echo completes
+        for( SRequest* pRequest : m_lstRequests )
+        {
+            WaitForSingleObject( pRequest->hEvent, pRequest->nTimeoutMsecs );
+            Release( pRequest );
+        }
+        if( m_hIcmp != INVALID_HANDLE_VALUE )
+            IcmpCloseHandle( m_hIcmp );
+    }
+
+    bool Send( QHostAddress const& oAddress, int nTimeoutMsecs, DoneCallback fnDone )
+    {
+        if( m_hIcmp == INVALID_HANDLE_VALUE || oAddress.protocol() != QAbstractSocket::IPv4Protocol )
+            return false;
+
+        static char s_aPayload[32] = "OddEye latency probe";
+
+        SRequest* pRequest = new SRequest;
+        pRequest->hEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
+        pRequest->nTimeoutMsecs = DWORD(nTimeoutMsecs);
+        pRequest->aReply.resize( sizeof(ICMP_ECHO_REPLY) + sizeof(s_aPayload) + 8 );
+        pRequest->fnDone = fnDone;
+
+        DWORD dwRetVal = IcmpSendEcho2( m_hIcmp, pRequest->hEvent, NULL, NULL,
+                                        htonl( oAddress.toIPv4Address() ), s_aPayload, sizeof(s_aPayload),
+                                        NULL, pRequest->aReply.data(), DWORD(pRequest->aReply.size()),
+                                        DWORD(nTimeoutMsecs) );
+        if( dwRetVal == 0 && GetLastError() != ERROR_IO_PENDING )
+        {
+            Release( pRequest );
+            return false;
+        }
+
+        m_lstRequests.append( pRequest );
+        pRequest->pNotifier = new QWinEventNotifier( pRequest->hEvent );
+        QObject::connect( pRequest->pNotifier, &QWinEventNotifier::activated, pRequest->pNotifier,
+        [this, pRequest]()
+        {
+            double dRtt = -1;
+            if( IcmpParseReplies( pRequest->aReply.data(), DWORD(pRequest->aReply.size()) ) > 0 )
+            {
+                PICMP_ECHO_REPLY pEchoReply = reinterpret_cast<PICMP_ECHO_REPLY>( pRequest->aReply.data() );
+                if( pEchoReply->Status == IP_SUCCESS )
+                    dRtt = pEchoReply->RoundTripTime;
+            }
+
+            DoneCallback fnDone = pRequest->fnDone;
+            m_lstRequests.removeOne( pRequest );
+            Release( pRequest );
+            fnDone( dRtt );
+        });
+        return true;
+    }
+
+private:
+    struct SRequest
+    {
+        HANDLE             hEvent    = NULL;
+        DWORD              nTimeoutMsecs = 0;
+        QWinEventNotifier* pNotifier = nullptr;
+        std::vector<char>  aReply;
+        DoneCallback       fnDone;
+    };
+
+    static void Release( SRequest* pRequest )
+    {
+        if( pRequest->pNotifier )
+        {
+            pRequest->pNotifier->setEnabled( false );
+            pRequest->pNotifier->deleteLater();
+        }
+        CloseHandle( pRequest->hEvent );
+        delete pRequest;
+    }
+
+private:
+    HANDLE           m_hIcmp;
+    QList<SRequest*> m_lstRequests;
+#else
+    bool Send( QHostAddress const&, int, DoneCallback )
+    {
+        return false;
+    }
+#endif
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+CLatencyProberChecker::CLatencyProberChecker( QStringList const& lstTargets, QObject* pParent )
+    : Base( pParent ),
+      m_nPeriodMsecs( 10000 ),
+      m_nTimeoutMsecs( 1000 ),
+      m_nDnsTtlMsecs( 300 * 1000 )
+{
+    for( QString sTarget : lstTargets )
+    {
+        sTarget = sTarget.trimmed();
+        if( sTarget.isEmpty() )
+            continue;
+
+        // host, host:port, IPv6 address or [IPv6 address]:port
+        STarget oTarget;
+        oTarget.sName = sTarget;
+        oTarget.sHost = sTarget;
+        QString sPort;
+        if( sTarget.startsWith( '[' ) && sTarget.contains( ']' ) )
+        {
+            int nEnd = sTarget.indexOf( ']' );
+            oTarget.sHost = sTarget.mid( 1, nEnd - 1 );
+            if( sTarget.mid( nEnd + 1 ).startsWith( ':' ) )
+                sPort = sTarget.mid( nEnd + 2 );
+        }
+        else if( sTarget.count( ':' ) == 1 )
+        {
+            oTarget.sHost = sTarget.section( ':', 0, 0 );
+            sPort = sTarget.section( ':', 1 );
+        }
+
+        if( !sPort.isEmpty() )
+        {
+            bool bOk = false;
+            uint nPort = sPort.toUInt( &bOk );
+            if( !bOk || nPort == 0 || nPort > 65535 )
+            {
+                LOG_WARNING( "Invalid probe target skipped: " + sTarget.toStdString() );
+                continue;
+            }
+            oTarget.nPort = quint16(nPort);
+        }
+
+        oTarget.bLiteral = oTarget.oAddress.setAddress( oTarget.sHost );
+        m_aTargets.append( oTarget );
+    }
+}
+
+CLatencyProberChecker::~CLatencyProberChecker()
+{
+    for( int nLookupId : m_mapLookups.keys() )
+        QHostInfo::abortHostLookup( nLookupId );
+}
+
+void CLatencyProberChecker::Initialize()
+{
+    Base::Initialize();
+
+    if( m_aTargets.isEmpty() )
+        throw CCheckerInitializationException( "No valid probe targets" );
+
+    m_nPeriodMsecs  = qMax( ConfMgr.GetMainConfiguration().Value<int>( "SelfConfig/probe_period_seconds", 10 ), 1 ) * 1000;
+    // a probe ends before the next round of its target
+    m_nTimeoutMsecs = qBound( 10, ConfMgr.GetMainConfiguration().Value<int>( "SelfConfig/probe_timeout_ms", 1000 ), m_nPeriodMsecs / 2 );
+    m_nDnsTtlMsecs  = qMax( ConfMgr.GetMainConfiguration().Value<int>( "SelfConfig/probe_dns_ttl_seconds", 300 ), 0 ) * qint64(1000);
+
+    m_oRandom.seed( std::random_device()() );
+    m_pIcmp.reset( new CIcmpEcho );
+
+    // first rounds are spread over the period
+    std::uniform_int_distribution<int> oStartOffset( 0, m_nPeriodMsecs - 1 );
+    for( int i = 0; i < m_aTargets.size(); ++i )
+    {
+        STarget& oTarget = m_aTargets[i];
+        oTarget.pTimer = new QTimer( this );
+        oTarget.pTimer->setSingleShot( true );
+        connect( oTarget.pTimer, &QTimer::timeout, this, [this, i]() { StartProbe( i ); } );
+        oTarget.pTimer->start( oStartOffset( m_oRandom ) );
+    }
+
+    LOG_INFO( QString( "Latency prober started for %1 target(s)" ).arg( m_aTargets.size() ) );
+}
+
+MetricDataList CLatencyProberChecker::CheckMetrics()
+{
+    MetricDataList lstResults;
+    QDateTime oTime = CTickClock::Instance().GetTickTime();
+
+    for( STarget& oTarget : m_aTargets )
+    {
+        if( oTarget.nSent == 0 )
+            continue;
+
+        if( oTarget.nReceived > 0 )
+            lstResults.append( std::make_shared<CMetricData>( "probe_rtt", oTarget.dRttSum / oTarget.nReceived, EMetricDataType::None,
+                                                              oTime, "network", 0, "target", oTarget.sName ) );
+        lstResults.append( std::make_shared<CMetricData>( "probe_loss", 100. * ( oTarget.nSent - oTarget.nReceived ) / oTarget.nSent,
+                                                          EMetricDataType::Percent, oTime, "network", 0, "target", oTarget.sName ) );
+        if( oTarget.nJitterCount > 0 )
+            lstResults.append( std::make_shared<CMetricData>( "probe_jitter", oTarget.dJitterSum / oTarget.nJitterCount, EMetricDataType::None,
+                                                              oTime, "network", 0, "target", oTarget.sName ) );
+
+        oTarget.nSent        = 0;
+        oTarget.nReceived    = 0;
+        oTarget.dRttSum      = 0;
+        oTarget.dJitterSum   = 0;
+        oTarget.nJitterCount = 0;
+    }
+
+    return lstResults;
+}
+
+void CLatencyProberChecker::StartProbe( int nTarget )
+{
+    ScheduleNext( nTarget );
+
+    STarget& oTarget = m_aTargets[nTarget];
+    // resolving or the previous probe is not done yet
+    if( oTarget.bProbing )
+        return;
+
+    bool bResolve = !oTarget.bLiteral &&
+                    ( oTarget.oAddress.isNull() || oTarget.oResolvedTimer.elapsed() >= m_nDnsTtlMsecs );
+    if( !bResolve )
+    {
+        SendProbe( nTarget );
+        return;
+    }
+
+    oTarget.bProbing = true;
+    oTarget.nLookupId = QHostInfo::lookupHost( oTarget.sHost, this, SLOT(onLookupFinished(QHostInfo)) );
+    m_mapLookups.insert( oTarget.nLookupId, nTarget );
+}
+
+void CLatencyProberChecker::SendProbe( int nTarget )
+{
+    STarget& oTarget = m_aTargets[nTarget];
+    oTarget.bProbing = true;
+    oTarget.oProbeTimer.start();
+
+    if( oTarget.nPort == 0 &&
+        m_pIcmp->Send( oTarget.oAddress, m_nTimeoutMsecs, [this, nTarget]( double dRtt ) { FinishProbe( nTarget, dRtt ); } ) )
+        return;
+
+    QTcpSocket* pSocket = new QTcpSocket( this );
+    oTarget.pSocket = pSocket;
+
+    connect( pSocket, &QTcpSocket::connected, this, [this, nTarget]()
+    {
+        FinishProbe( nTarget, m_aTargets[nTarget].oProbeTimer.nsecsElapsed() / 1e6 );
+    });
+    connect( pSocket, static_cast<void (QAbstractSocket::*)(QAbstractSocket::SocketError)>( &QAbstractSocket::error ), this,
+    [this, nTarget]( QAbstractSocket::SocketError eError )
+    {
+        // a refusing host is reachable, the reset arrives in one round trip
+        double dRtt = eError == QAbstractSocket::ConnectionRefusedError
+                        ? m_aTargets[nTarget].oProbeTimer.nsecsElapsed() / 1e6 : -1;
+        FinishProbe( nTarget, dRtt );
+    });
+    // the timer is gone with the socket
+    QTimer::singleShot( m_nTimeoutMsecs, pSocket, [this, nTarget, pSocket]()
+    {
+        if( m_aTargets[nTarget].pSocket == pSocket )
+            FinishProbe( nTarget, -1 );
+    });
+
+    pSocket->connectToHost( oTarget.oAddress, oTarget.nPort != 0? oTarget.nPort : c_nFallbackPort );
+}
+
+void CLatencyProberChecker::onLookupFinished( QHostInfo const& oHostInfo )
+{
+    if( !m_mapLookups.contains( oHostInfo.lookupId() ) )
+        return;
+    int nTarget = m_mapLookups.take( oHostInfo.lookupId() );
+    STarget& oTarget = m_aTargets[nTarget];
+    oTarget.nLookupId = -1;
+
+    // ICMP echo is sent to IPv4 addresses only
+    QHostAddress oAddress;
+    for( QHostAddress const& oCandidate : oHostInfo.addresses() )
+    {
+        if( oAddress.isNull() || ( oTarget.nPort == 0 && oCandidate.protocol() == QAbstractSocket::IPv4Protocol &&
+                                   oAddress.protocol() != QAbstractSocket::IPv4Protocol ) )
+            oAddress = oCandidate;
+    }
+
+    if( !oAddress.isNull() )
+    {
+        oTarget.oAddress = oAddress;
+        oTarget.oResolvedTimer.start();
+    }
+    else if( oTarget.oAddress.isNull() )
+    {
+        LOG_WARNING( "Probe target lookup failed: " + oTarget.sHost.toStdString() + ": " + oHostInfo.errorString().toStdString() );
+        FinishProbe( nTarget, -1 );
+        return;
+    }
+    // otherwise the expired address is used until the lookup succeeds
+
+    SendProbe( nTarget );
+}
+
+void CLatencyProberChecker::FinishProbe( int nTarget, double dRttMsecs )
+{
+    STarget& oTarget = m_aTargets[nTarget];
+    if( !oTarget.bProbing )
+        return;
+    oTarget.bProbing = false;
+
+    if( oTarget.pSocket )
+    {
+        oTarget.pSocket->disconnect( this );
+        oTarget.pSocket->abort();
+        oTarget.pSocket->deleteLater();
+        oTarget.pSocket = nullptr;
+    }
+
+    ++oTarget.nSent;
+    if( dRttMsecs < 0 )
+        return;
+
+    ++oTarget.nReceived;
+    oTarget.dRttSum += dRttMsecs;
+    if( oTarget.dLastRtt >= 0 )
+    {
+        oTarget.dJitterSum += std::fabs( dRttMsecs - oTarget.dLastRtt );
+        ++oTarget.nJitterCount;
+    }
+    oTarget.dLastRtt = dRttMsecs;
+}
+
+void CLatencyProberChecker::ScheduleNext( int nTarget )
+{
+    int nMaxJitter = m_nPeriodMsecs / c_nJitterDivisor;
+    std::uniform_int_distribution<int> oJitter( -nMaxJitter, nMaxJitter );
+    m_aTargets[nTarget].pTimer->start( m_nPeriodMsecs + oJitter( m_oRandom ) );
+}
@@ -0,0 +1,96 @@
+#ifndef LATENCYPROBER_H
+#define LATENCYPROBER_H
+
+#include "imetricscategorychecker.h"
+// Qt
+#include <QElapsedTimer>
+#include <QHash>
+#include <QHostAddress>
+#include <QHostInfo>
+#include <QVector>
+#include <memory>
+#include <random>
+
+class QTcpSocket;
+class QTimer;
+class CIcmpEcho;
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CLatencyProberChecker
+///
+/// Measures round trip time to many targets concurrently, without blocking the
+/// engine thread. Targets are given as "host" or "host:port":
+///
+///     host        ICMP echo where the platform allows it (Windows, IPv4), otherwise
+///                 TCP connect to port 80
+///     host:port   TCP connect time to the port
+///
+/// Each target runs on its own timer, first starts are spread over the probe period
+/// and every round is jittered, so probes of many targets do not go out in bursts.
+/// Resolved addresses are cached for the DNS TTL. Each check reports for every
+/// target the probes completed since the previous one: probe_rtt (mean, ms),
+/// probe_loss (percent) and probe_jitter (mean RTT difference of successive probes).
+///
+class CLatencyProberChecker : public IMetricsCategoryChecker
+{
+    Q_OBJECT
+    using Base = IMetricsCategoryChecker;
+
+public:
+    CLatencyProberChecker( QStringList const& lstTargets, QObject* pParent = nullptr );
+    ~CLatencyProberChecker();
+
+    // IMetricsCategoryChecker interface
+public:
+    void Initialize() override;
+    MetricDataList CheckMetrics() override;
+
+private:
+    struct STarget
+    {
+        QString       sName;            // as configured
+        QString       sHost;
+        quint16       nPort     = 0;    // 0 for ICMP
+        QHostAddress  oAddress;
+        QElapsedTimer oResolvedTimer;
+        int           nLookupId = -1;
+        bool          bLiteral  = false;
+        QTimer*       pTimer    = nullptr;
+        QTcpSocket*   pSocket   = nullptr;
+        QElapsedTimer oProbeTimer;
+        bool          bProbing  = false;
+
+        // since the previous check
+        int           nSent     = 0;
+        int           nReceived = 0;
+        double        dRttSum   = 0;
+        double        dJitterSum = 0;
+        int           nJitterCount = 0;
+        double        dLastRtt  = -1;
+    };
+
+    // helpers
+    void StartProbe( int nTarget );
+    void SendProbe( int nTarget );
+    void FinishProbe( int nTarget, double dRttMsecs );
+    void ScheduleNext( int nTarget );
+
+private slots:
+    void onLookupFinished( QHostInfo const& oHostInfo );
+
+private:
+    //
+    //	Content
+    //
+    QVector<STarget>    m_aTargets;
+    QHash<int, int>     m_mapLookups;   // lookup id -> target
+    int                 m_nPeriodMsecs;
+    int                 m_nTimeoutMsecs;
+    qint64              m_nDnsTtlMsecs;
+    std::mt19937        m_oRandom;
+    std::unique_ptr<CIcmpEcho> m_pIcmp;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // LATENCYPROBER_H
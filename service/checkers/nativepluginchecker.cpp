@@ -0,0 +1,162 @@
+#include "nativepluginchecker.h"
+#include "../commonexceptions.h"
+#include "../logger.h"
+#include "../tickclock.h"
+
+// Qt
+#include <QFileInfo>
+
+#include <algorithm>
+#include <cmath>
+
+CNativePluginChecker::CNativePluginChecker( QString const& sLibraryPath, QObject* pParent )
+    : Base( pParent ),
+      m_oLibrary( sLibraryPath ),
+      m_pPlugin( nullptr ),
+      m_pContext( nullptr ),
+      m_bInitializing( false ),
+      m_bTickFailed( false )
+{
+    m_oHostApi.api_version     = OE_PLUGIN_API_VERSION;
+    m_oHostApi.host            = this;
+    m_oHostApi.register_series = &CNativePluginChecker::RegisterSeries;
+    m_oHostApi.config_value    = &CNativePluginChecker::ConfigValue;
+    m_oHostApi.log             = &CNativePluginChecker::Log;
+}
+
+CNativePluginChecker::~CNativePluginChecker()
+{
+    if( m_pPlugin && m_pPlugin->shutdown )
+        m_pPlugin->shutdown( m_pContext );
+    m_pPlugin = nullptr;
+    m_oLibrary.unload();
+}
+
+void CNativePluginChecker::Initialize()
+{
+    Base::Initialize();
+
+    if( !m_oLibrary.load() )
+        throw CCheckerInitializationException( m_oLibrary.fileName() + ": " + m_oLibrary.errorString() );
+
+    oe_plugin_entry pEntry = reinterpret_cast<oe_plugin_entry>( m_oLibrary.resolve( OE_PLUGIN_ENTRY_NAME ) );
+    if( !pEntry )
+        throw CCheckerInitializationException( m_oLibrary.fileName() + ": " + OE_PLUGIN_ENTRY_NAME + " is not exported" );
+
+    oe_plugin const* pPlugin = pEntry();
+    if( !pPlugin || !pPlugin->init || !pPlugin->tick )
+        throw CCheckerInitializationException( m_oLibrary.fileName() + ": invalid plugin descriptor" );
+    if( pPlugin->api_version != OE_PLUGIN_API_VERSION )
+        throw CCheckerInitializationException( QString( "%1: plugin API version %2, agent API version %3" )
+                                               .arg( m_oLibrary.fileName() ).arg( pPlugin->api_version ).arg( OE_PLUGIN_API_VERSION ) );
+
+    // series are registered during init only
+    m_bInitializing = true;
+    int nResult = pPlugin->init( &m_oHostApi, &m_pContext );
+    m_bInitializing = false;
+    if( nResult != 0 )
+        throw CCheckerInitializationException( QString( "%1: init returned %2" ).arg( m_oLibrary.fileName() ).arg( nResult ) );
+
+    m_pPlugin = pPlugin;
+    m_aValues.resize( m_aSeries.size() );
+    LOG_INFO( QString( "Plugin loaded: %1, %2 series" ).arg( GetPluginName() ).arg( m_aSeries.size() ) );
+}
+
+MetricDataList CNativePluginChecker::CheckMetrics()
+{
+    MetricDataList lstResults;
+    if( !m_pPlugin || m_aSeries.empty() )
+        return lstResults;
+
+    std::fill( m_aValues.begin(), m_aValues.end(), std::nan("") );
+    int nResult = m_pPlugin->tick( m_pContext, m_aValues.data(), int(m_aValues.size()) );
+    if( nResult != 0 )
+    {
+        // logged once per failure streak
+        if( !m_bTickFailed )
+            LOG_ERROR( QString( "Plugin tick failed: %1, result %2" ).arg( GetPluginName() ).arg( nResult ).toStdString() );
+        m_bTickFailed = true;
+        return lstResults;
+    }
+    m_bTickFailed = false;
+
+    QDateTime oTime = CTickClock::Instance().GetTickTime();
+    lstResults.reserve( int(m_aSeries.size()) );
+    for( size_t i = 0; i < m_aSeries.size(); ++i )
+    {
+        if( std::isnan( m_aValues[i] ) )
+            continue;
+
+        MetricDataSPtr pMetricData = std::make_shared<CMetricData>( m_aSeries[i] );
+        pMetricData->SetValue( m_aValues[i] );
+        pMetricData->SetTime( oTime );
+        lstResults.append( pMetricData );
+    }
+
+    return lstResults;
+}
+
+QString CNativePluginChecker::GetPluginName() const
+{
+    if( m_pPlugin && m_pPlugin->name )
+        return QString::fromUtf8( m_pPlugin->name );
+    return QFileInfo( m_oLibrary.fileName() ).completeBaseName();
+}
+
+int CNativePluginChecker::RegisterSeries( void* pHost, oe_series const* pSeries )
+{
+    CNativePluginChecker* pThis = static_cast<CNativePluginChecker*>( pHost );
+    if( !pThis || !pThis->m_bInitializing || !pSeries || !pSeries->name || !*pSeries->name )
+        return -1;
+    if( pSeries->data_type < OE_DATA_TYPE_NONE || pSeries->data_type > OE_DATA_TYPE_COUNTER )
+        return -1;
+
+    CMetricData oMetric;
+    oMetric.SetName( QString::fromUtf8( pSeries->name ) );
+    oMetric.SetMetricType( pSeries->metric_type && *pSeries->metric_type? QString::fromUtf8( pSeries->metric_type ) : QString( "plugin" ) );
+    oMetric.SetDataType( static_cast<EMetricDataType>( pSeries->data_type ) );
+    if( pSeries->instance_type && pSeries->instance_name )
+    {
+        oMetric.SetInstanceType( QString::fromUtf8( pSeries->instance_type ) );
+        oMetric.SetInstanceName( QString::fromUtf8( pSeries->instance_name ) );
+    }
+
+    pThis->m_aSeries.push_back( oMetric );
+    return int(pThis->m_aSeries.size()) - 1;
+}
+
+char const* CNativePluginChecker::ConfigValue( void* pHost, char const* szKey )
+{
+    CNativePluginChecker* pThis = static_cast<CNativePluginChecker*>( pHost );
+    if( !pThis || !szKey )
+        return nullptr;
+
+    QString sKey = QString::fromUtf8( szKey );
+    auto it = pThis->m_mapConfigValues.find( sKey );
+    if( it == pThis->m_mapConfigValues.end() )
+    {
+        if( !pThis->ConfigSection().contains( sKey ) )
+            return nullptr;
+
+        // comma separated values are read as lists
+        QVariant vtValue = pThis->ConfigSection().value( sKey );
+        QString sValue = vtValue.type() == QVariant::StringList? vtValue.toStringList().join( ", " ) : vtValue.toString();
+        it = pThis->m_mapConfigValues.insert( sKey, sValue.toUtf8() );
+    }
+    return it.value().constData();
+}
+
+void CNativePluginChecker::Log( void* pHost, int nLevel, char const* szMessage )
+{
+    CNativePluginChecker* pThis = static_cast<CNativePluginChecker*>( pHost );
+    if( !pThis || !szMessage )
+        return;
+
+    QString sMessage = QString( "Plugin %1: %2" ).arg( pThis->GetPluginName(), QString::fromUtf8( szMessage ) );
+    if( nLevel >= OE_LOG_ERROR )
+        LOG_ERROR( sMessage.toStdString() );
+    else if( nLevel == OE_LOG_WARNING )
+        LOG_WARNING( sMessage.toStdString() );
+    else
+        LOG_INFO( sMessage );
+}
@@ -0,0 +1,60 @@
+#ifndef NATIVEPLUGINCHECKER_H
+#define NATIVEPLUGINCHECKER_H
+
+#include "imetricscategorychecker.h"
+#include "oeagentplugin.h"
+// Qt
+#include <QByteArray>
+#include <QHash>
+#include <QLibrary>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CNativePluginChecker
+///
+/// Checker loaded from a shared library through the C interface of oeagentplugin.h.
+/// Series are registered once, every check the plugin only fills an array of values,
+/// which are copied into prepared metrics: no process start and no text parsing.
+/// The plugin gets the config section named after the library file base name.
+///
+class CNativePluginChecker : public IMetricsCategoryChecker
+{
+    Q_OBJECT
+    using Base = IMetricsCategoryChecker;
+
+public:
+    CNativePluginChecker( QString const& sLibraryPath, QObject* pParent = nullptr );
+    ~CNativePluginChecker();
+
+    // IMetricsCategoryChecker interface
+public:
+    void Initialize() override;
+    MetricDataList CheckMetrics() override;
+
+    QString GetPluginName() const;
+
+private:
+    // host callbacks
+    static int         RegisterSeries( void* pHost, oe_series const* pSeries );
+    static char const* ConfigValue( void* pHost, char const* szKey );
+    static void        Log( void* pHost, int nLevel, char const* szMessage );
+
+private:
+    //
+    //	Content
+    //
+    QLibrary                  m_oLibrary;
+    oe_plugin const*          m_pPlugin;
+    void*                     m_pContext;
+    oe_host_api               m_oHostApi;
+    bool                      m_bInitializing;
+    bool                      m_bTickFailed;
+
+    std::vector<CMetricData>  m_aSeries;        // metric of each registered series
+    std::vector<double>       m_aValues;
+    QHash<QString, QByteArray> m_mapConfigValues; // keeps strings given to the plugin
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // NATIVEPLUGINCHECKER_H
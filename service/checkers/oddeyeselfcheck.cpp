@@ -1,104 +1,179 @@
 #include "oddeyeselfcheck.h"
 #include "basicmetricchecker.h"
-#include "pinger.h"
 #include "../upload/sendcontroller.h"
 #include "../configurationmanager.h"
 #include "../commonexceptions.h"
+#include "../tickclock.h"
+#include "../ddsketch.h"
 
 #include <QElapsedTimer>
-#include <QEventLoop>
+#include <QNetworkReply>
 #include <QTimer>
 
-class COEHostAliveMetricChecker : public QObject, public IMetricChecker
+namespace
+{
+// latency quantiles cover the last one or two windows
+const qint64 c_nLatencyWindowMsecs = 15 * 60 * 1000;
+const double c_aLatencyQuantiles[] = { 0.5, 0.9, 0.99 };
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CSelfCheckProbe
+///
+/// Requests the OddEye check URL on its own timer, never from the collection tick.
+/// Checks report the last completed probe: host_alive (response time) only while
+/// the probe succeeds, its age and latency quantiles of recent probes.
+///
+class CSelfCheckProbe : public QObject
 {
     Q_OBJECT
 
 public:
-    COEHostAliveMetricChecker(QString const& sURL, int nTimeout = 2000)
-        : m_sURL(sURL),
-          m_nTimeout( nTimeout )
-    {}
+    CSelfCheckProbe( QString const& sURL, int nTimeoutMsecs, int nPeriodMsecs )
+        : m_sURL( sURL ),
+          m_nTimeoutMsecs( nTimeoutMsecs ),
+          m_nPeriodMsecs( nPeriodMsecs ),
+          m_pReply( nullptr ),
+          m_bTimedOut( false ),
+          m_bLastSucceeded( false ),
+          m_nLastDurationMsecs( 0 )
+    {
+        m_pProbeTimer = new QTimer( this );
+        m_pProbeTimer->setInterval( m_nPeriodMsecs );
+        connect( m_pProbeTimer, &QTimer::timeout, this, &CSelfCheckProbe::StartProbe );
+    }
 
-    // IMetricChecker interface
 public:
-    MetricDataSPtr CheckMetric()
-    {   
-        Q_ASSERT( m_nTimeout > 0 );
-        qint64 nDuration = MeasureResponseTime( m_nTimeout );
-        MetricDataSPtr pMetric = std::make_shared<CMetricData>("host_alive",
-                                             nDuration,
-                                             EMetricDataType::None,
-                                             QDateTime::currentDateTime(),
-                                             "health");
-
-        QString sMsg = "{DURATION} without HearBeats from host";
-        pMetric->SetSeverityDescriptor( "HeartBeat", EMetricDataSeverity::Normal, 2, sMsg );
-
-        return pMetric;
+    void Start()
+    {
+        m_oWindowTimer.start();
+        m_pProbeTimer->start();
+        StartProbe();
+    }
+
+    MetricDataList MakeMetrics()
+    {
+        MetricDataList lstMetrics;
+        QDateTime oTime = CTickClock::Instance().GetTickTime();
+
+        if( m_oLastProbeTimer.isValid() )
+        {
+            qint64 nAgeMsecs = m_oLastProbeTimer.elapsed();
+            // no heartbeat if the last probe failed or probes stopped completing
+            if( m_bLastSucceeded && nAgeMsecs <= 2 * m_nPeriodMsecs + m_nTimeoutMsecs )
+            {
+                MetricDataSPtr pMetric = std::make_shared<CMetricData>( "host_alive", m_nLastDurationMsecs,
+                                                                        EMetricDataType::None, oTime, "health" );
+                QString sMsg = "{DURATION} without HearBeats from host";
+                pMetric->SetSeverityDescriptor( "HeartBeat", EMetricDataSeverity::Normal, 2, sMsg );
+                lstMetrics.append( pMetric );
+            }
+
+            lstMetrics.append( std::make_shared<CMetricData>( "host_alive_probe_age", nAgeMsecs / 1000.,
+                                                              EMetricDataType::None, oTime, "health" ) );
+        }
+
+        if( m_oWindowTimer.elapsed() >= c_nLatencyWindowMsecs )
+        {
+            m_oPreviousLatency = m_oCurrentLatency;
+            m_oCurrentLatency.Clear();
+            m_oWindowTimer.restart();
+        }
+
+        CDDSketch oLatency = m_oPreviousLatency;
+        oLatency.Merge( m_oCurrentLatency );
+        if( !oLatency.IsEmpty() )
+        {
+            for( double dQuantile : c_aLatencyQuantiles )
+                lstMetrics.append( std::make_shared<CMetricData>( "host_alive_p" + QString::number( dQuantile * 100 ),
+                                                                  oLatency.GetQuantile( dQuantile ),
+                                                                  EMetricDataType::None, oTime, "health" ) );
+            lstMetrics.append( std::make_shared<CMetricData>( "host_alive_max", oLatency.GetMax(),
+                                                              EMetricDataType::None, oTime, "health" ) );
+        }
+
+        return lstMetrics;
     }
 
-    qint64 MeasureResponseTime( int nTimeoutMsecs )
+private:
+    void StartProbe()
     {
+        // the previous probe is still running, at most for the timeout
+        if( m_pReply )
+            return;
+
         NetworkAccessManagerSPtr pNetworkManager = CSendController::Instance().GetNetworkAccessManager().lock();
         Q_ASSERT(pNetworkManager);
         if( !pNetworkManager )
         {
             LOG_ERROR("Internal error: Network Access Manager is NULL");
-            throw COddEyeSelfCheckException( "Network Access Manager is NULL" );
+            return;
         }
 
-        // Start timer
-        QElapsedTimer oTimer;
-        oTimer.start();
-
         Q_ASSERT( !m_sURL.isEmpty() );
-
         QUrl oUrl = QUrl(m_sURL);
         Q_ASSERT( oUrl.isValid() );
-        auto pReply = pNetworkManager->Get(QNetworkRequest( oUrl) );
-
-        QTimer oTimeoutTimer;
-        oTimeoutTimer.setSingleShot(true);
 
-        QEventLoop loop;
-        connect(&oTimeoutTimer, SIGNAL(timeout()), &loop, SLOT(quit()));
-        connect(pReply, SIGNAL(finished()), &loop, SLOT(quit()));
-        // start timeout timer
-        oTimeoutTimer.start(nTimeoutMsecs);
-        // start event loop
-        loop.exec();
+        m_bTimedOut = false;
+        m_oDurationTimer.start();
+        QNetworkReply* pReply = pNetworkManager->Get( QNetworkRequest( oUrl ) );
+        m_pReply = pReply;
+        connect( pReply, &QNetworkReply::finished, this, &CSelfCheckProbe::onProbeFinished );
 
-        if(oTimeoutTimer.isActive())
+        // the timer is gone with the reply
+        QTimer::singleShot( m_nTimeoutMsecs, pReply,
+        [this, pReply]()
         {
-            oTimeoutTimer.stop();
+            m_bTimedOut = true;
+            pReply->abort();
+        });
+    }
 
-            // Handle reply
-            if( pReply->error() == QNetworkReply::NoError )
-            {
-                QByteArray aReply = pReply->readAll();
-                qDebug() << aReply;
-            }
-            else
-            {
-                throw COddEyeSelfCheckException(pReply->errorString());
-            }
+    void onProbeFinished()
+    {
+        QNetworkReply* pReply = m_pReply;
+        if( !pReply )
+            return;
+        m_pReply = nullptr;
+
+        m_oLastProbeTimer.start();
+        if( m_bTimedOut )
+        {
+            m_bLastSucceeded = false;
+            LOG_ERROR( "Self check failed: Time out!" );
+        }
+        else if( pReply->error() != QNetworkReply::NoError )
+        {
+            m_bLastSucceeded = false;
+            LOG_ERROR( "Self check failed: " + pReply->errorString().toStdString() );
         }
         else
         {
-           // timeout
-           disconnect(pReply, SIGNAL(finished()), &loop, SLOT(quit()));
-           pReply->abort();
-
-           throw COddEyeSelfCheckException("Time out!");
+            m_bLastSucceeded     = true;
+            m_nLastDurationMsecs = m_oDurationTimer.elapsed();
+            m_oCurrentLatency.Add( double(m_nLastDurationMsecs) );
         }
-
-        qint64 nElapsedTime = oTimer.elapsed();
-        return nElapsedTime;
+        // the reply is deleted by the network access manager
     }
 
 private:
-    int    m_nTimeout;
-    QString m_sURL;
+    QString        m_sURL;
+    int            m_nTimeoutMsecs;
+    int            m_nPeriodMsecs;
+    QTimer*        m_pProbeTimer;
+    QNetworkReply* m_pReply;            // running probe
+    bool           m_bTimedOut;
+    QElapsedTimer  m_oDurationTimer;
+
+    // last completed probe
+    bool           m_bLastSucceeded;
+    qint64         m_nLastDurationMsecs;
+    QElapsedTimer  m_oLastProbeTimer;
+
+    CDDSketch      m_oCurrentLatency;
+    CDDSketch      m_oPreviousLatency;
+    QElapsedTimer  m_oWindowTimer;
 };
 
 #include "oddeyeselfcheck.moc"
@@ -111,6 +186,10 @@ OddeyeSelfCheck::OddeyeSelfCheck( QObject* pParent )
 {
 }
 
+OddeyeSelfCheck::~OddeyeSelfCheck()
+{
+}
+
 void OddeyeSelfCheck::Initialize()
 {
 //    double dConfHighVal   = -1;
@@ -143,8 +222,23 @@ void OddeyeSelfCheck::Initialize()
 //    }
 
     QString sURL = ConfigSection().Value<QString>( "url", "https://api.oddeye.co/ok.txt" );
+    int nTimeoutMsecs = static_cast<int>( ConfigSection().Value<double>( "timeout_seconds", 5 ) * 1000 );
+    int nPeriodMsecs  = static_cast<int>( ConfigSection().Value<double>( "probe_period_seconds", 30 ) * 1000 );
+    if( nTimeoutMsecs <= 0 )
+        throw CInvalidConfigValueException( "timeout_seconds = " + ConfigSection().Value<QString>( "timeout_seconds", QString() ) );
+    if( nPeriodMsecs <= 0 )
+        throw CInvalidConfigValueException( "probe_period_seconds = " + ConfigSection().Value<QString>( "probe_period_seconds", QString() ) );
+
+    m_pProbe = std::make_shared<CSelfCheckProbe>( sURL, nTimeoutMsecs, nPeriodMsecs );
+    m_pProbe->Start();
+}
 
-    Base::AddMetricChecker( std::make_shared<COEHostAliveMetricChecker>(sURL, 5000) );
+MetricDataList OddeyeSelfCheck::CheckMetrics()
+{
+    // results of the probe running on its own schedule
+    if( !m_pProbe )
+        return MetricDataList();
+    return m_pProbe->MakeMetrics();
 }
 
 
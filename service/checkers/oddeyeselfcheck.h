@@ -3,6 +3,7 @@
 
 #include "metricsgroupchecker.h"
 
+class CSelfCheckProbe;
 
 class OddeyeSelfCheck : public CMetricsGroupChecker
 {
@@ -11,10 +12,15 @@ class OddeyeSelfCheck : public CMetricsGroupChecker
 
 public:
     OddeyeSelfCheck( QObject* pParent = nullptr );
+    ~OddeyeSelfCheck();
 
     // IMetricsCategoryChecker interface
 public:
     void Initialize() override;
+    MetricDataList CheckMetrics() override;
+
+private:
+    std::shared_ptr<CSelfCheckProbe> m_pProbe;
 };
 
 REGISTER_METRIC_CHECKER( OddeyeSelfCheck )
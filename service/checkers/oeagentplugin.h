@@ -0,0 +1,85 @@
+#ifndef OEAGENTPLUGIN_H
+#define OEAGENTPLUGIN_H
+
+/*
+ *  C interface of in-process checker plugins.
+ *
+ *  A plugin is a shared library exporting OE_PLUGIN_ENTRY_NAME. The agent calls
+ *  init once, the plugin registers its series there, then tick is called on every
+ *  check with an array of one value per registered series. The header is plain C,
+ *  so plugins do not depend on the compiler or Qt version of the agent.
+ *
+ *  All strings are UTF-8 and copied by the agent, the plugin keeps ownership.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OE_PLUGIN_API_VERSION 1
+#define OE_PLUGIN_ENTRY_NAME  "oe_agent_plugin"
+
+#ifdef _WIN32
+#define OE_PLUGIN_EXPORT __declspec(dllexport)
+#else
+#define OE_PLUGIN_EXPORT __attribute__((visibility("default")))
+#endif
+
+/* data types of the series, see EMetricDataType */
+enum
+{
+    OE_DATA_TYPE_NONE    = 0,
+    OE_DATA_TYPE_RATE    = 1,
+    OE_DATA_TYPE_PERCENT = 2,
+    OE_DATA_TYPE_COUNTER = 3
+};
+
+/* log levels */
+enum
+{
+    OE_LOG_INFO    = 0,
+    OE_LOG_WARNING = 1,
+    OE_LOG_ERROR   = 2
+};
+
+typedef struct oe_series
+{
+    const char* name;
+    const char* metric_type;    /* "type" tag, NULL for "plugin" */
+    int         data_type;      /* OE_DATA_TYPE_* */
+    const char* instance_type;  /* NULL if the series has no instance */
+    const char* instance_name;
+} oe_series;
+
+typedef struct oe_host_api
+{
+    int   api_version;          /* OE_PLUGIN_API_VERSION of the agent */
+    void* host;                 /* passed back in every call */
+
+    /* registers a series, valid in init only; returns its index in the values array, -1 on error */
+    int         (*register_series)( void* host, const oe_series* series );
+    /* value of a key of the plugin config section, NULL if missing; valid until shutdown */
+    const char* (*config_value)( void* host, const char* key );
+    void        (*log)( void* host, int level, const char* message );
+} oe_host_api;
+
+typedef struct oe_plugin
+{
+    int         api_version;    /* OE_PLUGIN_API_VERSION the plugin was built with */
+    const char* name;
+
+    /* registers series and creates the plugin context; returns 0 on success */
+    int  (*init)( const oe_host_api* api, void** context );
+    /* fills values of registered series, NaN for no value this tick; returns 0 on success */
+    int  (*tick)( void* context, double* values, int count );
+    void (*shutdown)( void* context );
+} oe_plugin;
+
+/* the exported entry point */
+typedef const oe_plugin* (*oe_plugin_entry)( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OEAGENTPLUGIN_H */
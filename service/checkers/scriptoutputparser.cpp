@@ -0,0 +1,253 @@
+#include "scriptoutputparser.h"
+#include "../logger.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+// errors logged per parse, the rest are only counted
+const int c_nMaxLoggedErrors = 10;
+// mantissa digits beyond this only move the exponent
+const quint64 c_nMaxMantissa = 100000000000000000ULL;
+// timestamps above this are milliseconds
+const double c_dMSecsTimestampLimit = 1e11;
+
+const double c_aPowersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+inline bool IsSeparator( char ch )
+{
+    return ch == ' ' || ch == '\t' || ch == '\r';
+}
+
+inline bool IsDigit( char ch )
+{
+    return ch >= '0' && ch <= '9';
+}
+
+inline QString BytesToString( char const* pBegin, char const* pEnd )
+{
+    return QString::fromUtf8( pBegin, int(pEnd - pBegin) );
+}
+}
+
+CScriptOutputParser::CScriptOutputParser( QString const& sFileName )
+    : m_sFileName( sFileName ),
+      m_nLine( 0 ),
+      m_nErrors( 0 )
+{
+}
+
+MetricDataList CScriptOutputParser::Parse( QByteArray const& aOutput )
+{
+    Reset();
+
+    MetricDataList lstResults;
+    char const* pPos = aOutput.constData();
+    char const* pEnd = pPos + aOutput.size();
+    while( pPos < pEnd )
+    {
+        char const* pLineEnd = static_cast<char const*>( std::memchr( pPos, '\n', size_t(pEnd - pPos) ) );
+        if( !pLineEnd )
+            pLineEnd = pEnd;
+
+        MetricDataSPtr pMetricData = ParseLine( pPos, pLineEnd );
+        if( pMetricData )
+            lstResults.append( pMetricData );
+        pPos = pLineEnd + 1;
+    }
+
+    if( m_nErrors > c_nMaxLoggedErrors )
+        LOG_ERROR( QString( "Invalid script result: %1 invalid lines: File: %2" ).arg( m_nErrors ).arg( m_sFileName ).toStdString() );
+
+    return lstResults;
+}
+
+MetricDataSPtr CScriptOutputParser::ParseLine( char const* pBegin, char const* pEnd )
+{
+    ++m_nLine;
+
+    MetricDataSPtr pMetricData;
+    int nPositional = 0;    // name, value, metric type, data type
+    char const* pPos = pBegin;
+    while( true )
+    {
+        while( pPos != pEnd && IsSeparator( *pPos ) )
+            ++pPos;
+        if( pPos == pEnd )
+            break;
+
+        char const* pToken = pPos;
+        while( pPos != pEnd && !IsSeparator( *pPos ) )
+            ++pPos;
+
+        if( nPositional == 0 )
+        {
+            pMetricData = std::make_shared<CMetricData>();
+            pMetricData->SetName( BytesToString( pToken, pPos ) );
+            ++nPositional;
+            continue;
+        }
+
+        if( nPositional == 1 )
+        {
+            double dValue = 0;
+            if( ParseDouble( pToken, pPos, dValue ) )
+                pMetricData->SetValue( dValue );
+            else
+                pMetricData->SetValue( BytesToString( pToken, pPos ) );
+            ++nPositional;
+            continue;
+        }
+
+        if( *pToken == '@' )
+        {
+            double dTimestamp = 0;
+            if( !ParseDouble( pToken + 1, pPos, dTimestamp ) || dTimestamp <= 0 )
+            {
+                ReportError( "Invalid timestamp " + BytesToString( pToken, pPos ) );
+                return nullptr;
+            }
+            qint64 nMSecs = std::llround( dTimestamp < c_dMSecsTimestampLimit? dTimestamp * 1000 : dTimestamp );
+            pMetricData->SetTime( QDateTime::fromMSecsSinceEpoch( nMSecs, Qt::UTC ) );
+            continue;
+        }
+
+        char const* pEqual = static_cast<char const*>( std::memchr( pToken, '=', size_t(pPos - pToken) ) );
+        if( pEqual )
+        {
+            if( pEqual == pToken || pEqual + 1 == pPos )
+            {
+                ReportError( "Invalid tag " + BytesToString( pToken, pPos ) );
+                return nullptr;
+            }
+            pMetricData->AddTag( BytesToString( pToken, pEqual ), BytesToString( pEqual + 1, pPos ) );
+            continue;
+        }
+
+        if( nPositional == 2 )
+            pMetricData->SetMetricType( BytesToString( pToken, pPos ) );
+        else if( nPositional == 3 )
+            pMetricData->SetDataType( BytesToString( pToken, pPos ) );
+        else
+        {
+            ReportError( "Unexpected token " + BytesToString( pToken, pPos ) );
+            return nullptr;
+        }
+        ++nPositional;
+    }
+
+    // blank line
+    if( !pMetricData )
+        return nullptr;
+
+    if( nPositional < 2 )
+    {
+        ReportError( "Insufficient number of output data" );
+        return nullptr;
+    }
+
+    return pMetricData;
+}
+
+void CScriptOutputParser::Reset()
+{
+    m_nLine   = 0;
+    m_nErrors = 0;
+    m_lstLoggedErrors.clear();
+}
+
+int CScriptOutputParser::GetErrorCount() const
+{
+    return m_nErrors;
+}
+
+QStringList const& CScriptOutputParser::GetLoggedErrors() const
+{
+    return m_lstLoggedErrors;
+}
+
+bool CScriptOutputParser::IsBlank( char const* pBegin, char const* pEnd )
+{
+    for( char const* pPos = pBegin; pPos != pEnd; ++pPos )
+        if( !IsSeparator( *pPos ) )
+            return false;
+    return true;
+}
+
+bool CScriptOutputParser::ParseDouble( char const* pBegin, char const* pEnd, double& dValue )
+{
+    char const* pPos = pBegin;
+    bool bNegative = false;
+    if( pPos != pEnd && (*pPos == '-' || *pPos == '+') )
+        bNegative = *pPos++ == '-';
+
+    quint64 nMantissa = 0;
+    int nExponent = 0;
+    int nDigits = 0;
+    for( ; pPos != pEnd && IsDigit( *pPos ); ++pPos, ++nDigits )
+    {
+        if( nMantissa < c_nMaxMantissa )
+            nMantissa = nMantissa * 10 + quint64(*pPos - '0');
+        else
+            ++nExponent;
+    }
+    if( pPos != pEnd && *pPos == '.' )
+    {
+        for( ++pPos; pPos != pEnd && IsDigit( *pPos ); ++pPos, ++nDigits )
+        {
+            if( nMantissa < c_nMaxMantissa )
+            {
+                nMantissa = nMantissa * 10 + quint64(*pPos - '0');
+                --nExponent;
+            }
+        }
+    }
+    if( nDigits == 0 )
+        return false;
+
+    if( pPos != pEnd && (*pPos == 'e' || *pPos == 'E') )
+    {
+        ++pPos;
+        bool bNegativeExponent = false;
+        if( pPos != pEnd && (*pPos == '-' || *pPos == '+') )
+            bNegativeExponent = *pPos++ == '-';
+
+        int nExplicitExponent = 0;
+        char const* pExponentBegin = pPos;
+        for( ; pPos != pEnd && IsDigit( *pPos ); ++pPos )
+        {
+            if( nExplicitExponent < 10000 )
+                nExplicitExponent = nExplicitExponent * 10 + (*pPos - '0');
+        }
+        if( pPos == pExponentBegin )
+            return false;
+        nExponent += bNegativeExponent? -nExplicitExponent : nExplicitExponent;
+    }
+    if( pPos != pEnd )
+        return false;
+
+    // exact for the usual short values, the power table keeps rounding to one step
+    double dResult = double(nMantissa);
+    if( nExponent >= 0 && nExponent <= 22 )
+        dResult *= c_aPowersOf10[nExponent];
+    else if( nExponent < 0 && nExponent >= -22 )
+        dResult /= c_aPowersOf10[-nExponent];
+    else
+        dResult *= std::pow( 10.0, nExponent );
+
+    dValue = bNegative? -dResult : dResult;
+    return true;
+}
+
+void CScriptOutputParser::ReportError( QString const& sReason )
+{
+    ++m_nErrors;
+    if( m_nErrors > c_nMaxLoggedErrors )
+        return;
+
+    QString sError = QString( "Invalid script result at line %1: %2: File: %3" ).arg( m_nLine ).arg( sReason, m_sFileName );
+    m_lstLoggedErrors.append( sError );
+    LOG_ERROR( sError.toStdString() );
+}
@@ -0,0 +1,62 @@
+#ifndef SCRIPTOUTPUTPARSER_H
+#define SCRIPTOUTPUTPARSER_H
+
+//
+//  Includes
+//
+#include "../metricdata.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CScriptOutputParser
+///
+/// Single pass tokenizer over the raw output bytes of a script. A result line is
+///
+///     name value [metric_type [data_type]] [tag=value ...] [@timestamp]
+///
+/// Tokens are separated by spaces or tabs. The value is parsed to double right from
+/// the bytes, a value which is not a number is kept as text. The timestamp is epoch
+/// time in seconds with an optional fraction, values above 1e11 are taken as
+/// milliseconds. Invalid lines are skipped and logged with their line numbers.
+///
+class CScriptOutputParser
+{
+public:
+    CScriptOutputParser( QString const& sFileName = QString() );
+
+public:
+    //
+    //	Main Interface
+    //
+    // parses all lines of aOutput, the last line may end without a newline
+    MetricDataList Parse( QByteArray const& aOutput );
+    // parses one line without the newline, nullptr for a blank or invalid line
+    MetricDataSPtr ParseLine( char const* pBegin, char const* pEnd );
+    // restarts line numbering and error count
+    void           Reset();
+    // invalid lines since Reset, and the messages logged for the first of them
+    int                GetErrorCount() const;
+    QStringList const& GetLoggedErrors() const;
+
+    static bool    IsBlank( char const* pBegin, char const* pEnd );
+    static bool    ParseDouble( char const* pBegin, char const* pEnd, double& dValue );
+
+private:
+    void           ReportError( QString const& sReason );
+
+private:
+    //
+    //	Content
+    //
+    QString m_sFileName;
+    int     m_nLine;
+    int     m_nErrors;
+    QStringList m_lstLoggedErrors;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // SCRIPTOUTPUTPARSER_H
@@ -1,40 +1,187 @@
 #include "scriptsmetricschecker.h"
 #include "../logger.h"
+#include "../tickclock.h"
 
 // Qt
 #include <QFileInfo>
 #include <QProcess>
+#include <QTimer>
 
-CScriptsMetricsChecker::CScriptsMetricsChecker(QObject *pParent)
-    : Base( pParent )
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CJobProcess
+///
+/// Scripts are run by cmd.exe, which starts the interpreter as its own child, so
+/// QProcess::kill() stops only cmd.exe. On Windows the process is created
+/// suspended and put into a job object before it runs, KillTree() terminates the
+/// job with every process in it. The job is closed with the process object and
+/// JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE stops whatever is still running then.
+/// Elsewhere KillTree() is kill().
+///
+class CJobProcess : public QProcess
 {
-    m_pProcess = std::make_unique<QProcess>();
-    connect( m_pProcess.get(), &QProcess::readyReadStandardError, this,
-    [this]()
-    {
-        QByteArray aError = m_pProcess->readAllStandardOutput();
+public:
+    explicit CJobProcess( QObject* pParent = nullptr );
+    ~CJobProcess();
 
-        QString sFileName;
-        if( m_pProcess->arguments().size() >= 2 )
-        {
-            QString sFilePathArg = m_pProcess->arguments().at(1);
-            sFileName = QFileInfo(sFilePathArg).fileName();
-        }
-        LOG_ERROR( QString("Script execution error: %1 : File: %2").arg(aError, sFileName ).toStdString() );
+    void KillTree();
+
+#ifdef Q_OS_WIN
+private:
+    void onStarted();
+
+private:
+    HANDLE m_hJob;
+    bool   m_bAssigned;
+#endif
+};
+
+#ifdef Q_OS_WIN
+CJobProcess::CJobProcess( QObject* pParent )
+    : QProcess( pParent ),
+      m_hJob( CreateJobObject( nullptr, nullptr ) ),
+      m_bAssigned( false )
+{
+    if( !m_hJob )
+        return;
+
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION oLimits = {};
+    oLimits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+    SetInformationJobObject( m_hJob, JobObjectExtendedLimitInformation, &oLimits, sizeof(oLimits) );
+
+    // the process may not start children before it is in the job
+    setCreateProcessArgumentsModifier( []( QProcess::CreateProcessArguments* pArgs )
+    {
+        pArgs->flags |= CREATE_SUSPENDED;
     });
+    connect( this, &QProcess::started, this, &CJobProcess::onStarted );
+}
+
+CJobProcess::~CJobProcess()
+{
+    if( m_hJob )
+        CloseHandle( m_hJob );
+}
+
+void CJobProcess::KillTree()
+{
+    if( m_bAssigned && TerminateJobObject( m_hJob, 1 ) )
+        return;
+    kill();
+}
+
+void CJobProcess::onStarted()
+{
+    Q_PID pInfo = pid();
+    if( !pInfo )
+        return;
+
+    m_bAssigned = m_hJob && AssignProcessToJobObject( m_hJob, pInfo->hProcess );
+    if( !m_bAssigned )
+        LOG_WARNING( "Script process is not in a job, its child processes may outlive it" );
+    ResumeThread( pInfo->hThread );
+}
+#else
+CJobProcess::CJobProcess( QObject* pParent )
+    : QProcess( pParent )
+{
+}
+
+CJobProcess::~CJobProcess()
+{
+}
+
+void CJobProcess::KillTree()
+{
+    kill();
+}
+#endif
+////////////////////////////////////////////////////////////////////////////////////////
+
+
+CScriptsMetricsChecker::CScriptsMetricsChecker(QObject *pParent)
+    : Base( pParent ),
+      m_nRunning( 0 ),
+      m_nMaxConcurrent( 4 ),
+      m_nTimeoutMsecs( 60000 )
+{
 }
 
 CScriptsMetricsChecker::~CScriptsMetricsChecker()
-{}
+{
+    for( SScript& oScript : m_aScripts )
+    {
+        if( !oScript.pProcess )
+            continue;
+        oScript.pProcess->disconnect( this );
+        oScript.pProcess->KillTree();
+        oScript.pProcess->waitForFinished( 1000 );
+    }
+}
 
-MetricDataList CScriptsMetricsChecker::CheckMetrics()
+void CScriptsMetricsChecker::Initialize()
 {
-    MetricDataList lstResults;
+    m_nMaxConcurrent = qMax( ConfMgr.GetMainConfiguration().Value<int>( "SelfConfig/max_concurrent_scripts", 4 ), 1 );
+    m_nTimeoutMsecs  = static_cast<int>( ConfMgr.GetMainConfiguration().Value<double>( "SelfConfig/script_timeout_seconds", 60 ) * 1000 );
+
+    // file names of scripts running as persistent plugins
+    QStringList lstPersistent;
+    for( QString const& sName : ConfMgr.GetMainConfiguration().Value<QStringList>( "SelfConfig/persistent_scripts", QStringList() ) )
+        lstPersistent.append( sName.trimmed() );
 
     QStringList lstScriptFiles = ConfigSection().Value<QStringList>("scripts_enabled", QStringList());
-    for( auto& sScriptFile : lstScriptFiles )
+    for( QString const& sScriptFile : lstScriptFiles )
+    {
+        SScript oScript;
+        oScript.sFilePath   = sScriptFile;
+        oScript.sFileName   = QFileInfo( sScriptFile ).fileName();
+        oScript.bPersistent = lstPersistent.contains( oScript.sFileName, Qt::CaseInsensitive );
+        oScript.oParser     = CScriptOutputParser( oScript.sFileName );
+        m_aScripts.push_back( oScript );
+    }
+}
+
+MetricDataList CScriptsMetricsChecker::CheckMetrics()
+{
+    // scripts still running from the previous check are not started again
+    for( int i = 0; i < int(m_aScripts.size()); ++i )
     {
-        lstResults.append( GetScriptFileResults( sScriptFile ) );
+        SScript& oScript = m_aScripts[i];
+        if( oScript.bPersistent )
+        {
+            CheckPlugin( i );
+            continue;
+        }
+        if( oScript.pProcess || oScript.bPending )
+            continue;
+        oScript.bPending = true;
+        m_qPending.enqueue( i );
+    }
+    StartPendingScripts();
+
+    // results of the last finished runs, stamped with this check time unless the script gave one
+    MetricDataList lstResults;
+    QDateTime oTime = CTickClock::Instance().GetTickTime();
+    for( SScript const& oScript : m_aScripts )
+    {
+        for( MetricDataSPtr const& pLastResult : oScript.lstLastResults )
+        {
+            MetricDataSPtr pMetricData = std::make_shared<CMetricData>( *pLastResult );
+            if( !pMetricData->GetTime().isValid() )
+                pMetricData->SetTime( oTime );
+            lstResults.append( pMetricData );
+        }
+
+        lstResults.append( std::make_shared<CMetricData>( "script_duration", oScript.nLastDurationMsecs / 1000.,
+                                                          EMetricDataType::None, oTime, "health", 0,
+                                                          "script", oScript.sFileName ) );
+        lstResults.append( std::make_shared<CMetricData>( "script_failures", oScript.nFailures,
+                                                          EMetricDataType::Counter, oTime, "health", 0,
+                                                          "script", oScript.sFileName ) );
     }
 
     return lstResults;
@@ -52,66 +199,237 @@ QStringList CScriptsMetricsChecker::GetScriptFileNameList()
     return lstScriptFileNames;
 }
 
-MetricDataList CScriptsMetricsChecker::GetScriptFileResults(const QString &sSrcoptFilePath)
+void CScriptsMetricsChecker::StartPendingScripts()
 {
-    MetricDataList lstResltMetricsData;
+    while( m_nRunning < m_nMaxConcurrent && !m_qPending.isEmpty() )
+    {
+        int nScript = m_qPending.dequeue();
+        m_aScripts[nScript].bPending = false;
+        StartScript( nScript );
+    }
+}
 
-    if( !QFile(sSrcoptFilePath).exists() )
+void CScriptsMetricsChecker::StartScript( int nScript )
+{
+    SScript& oScript = m_aScripts[nScript];
+
+    if( !QFile(oScript.sFilePath).exists() )
     {
-        LOG_ERROR("Script execution error: Script file not exists. File: " +
-                  QFileInfo( sSrcoptFilePath ).fileName().toStdString() );
-        return lstResltMetricsData;
+        LOG_ERROR("Script execution error: Script file not exists. File: " + oScript.sFileName.toStdString() );
+        ++oScript.nFailures;
+        oScript.lstLastResults.clear();
+        return;
     }
 
-    auto sCommand = QString("cmd.exe");
-    auto lstArguments = QStringList{ QString("/C"), sSrcoptFilePath };
+    CJobProcess* pProcess = CreateProcess( nScript );
+    ++m_nRunning;
+
+    void (QProcess:: *pFinished)(int, QProcess::ExitStatus) = &QProcess::finished;
+    connect( pProcess, pFinished, this, [this, nScript]() { onScriptFinished( nScript ); } );
+    connect( pProcess, &QProcess::errorOccurred, this,
+    [this, nScript]( QProcess::ProcessError eError )
+    {
+        // finished is not emitted if the process could not start
+        if( eError == QProcess::FailedToStart )
+            onScriptFinished( nScript );
+    });
+
+    // kill on timeout, the timer is gone with the process
+    QTimer::singleShot( m_nTimeoutMsecs, pProcess,
+    [this, nScript, pProcess]()
+    {
+        SScript& oTimedOut = m_aScripts[nScript];
+        if( oTimedOut.pProcess != pProcess )
+            return;
+        oTimedOut.bTimedOut = true;
+        pProcess->KillTree();
+    });
+
+    oScript.oRunTimer.start();
+    pProcess->start( "cmd.exe", QStringList{ QString("/C"), oScript.sFilePath } );
+}
+
+CJobProcess* CScriptsMetricsChecker::CreateProcess( int nScript )
+{
+    SScript& oScript = m_aScripts[nScript];
+
+    CJobProcess* pProcess = new CJobProcess( this );
+    oScript.pProcess  = pProcess;
+    oScript.bTimedOut = false;
+
+    QString sFileName = oScript.sFileName;
+    connect( pProcess, &QProcess::readyReadStandardError, this,
+    [pProcess, sFileName]()
+    {
+        QByteArray aError = pProcess->readAllStandardError();
+        LOG_ERROR( QString("Script execution error: %1 : File: %2").arg( QString(aError), sFileName ).toStdString() );
+    });
+
+    return pProcess;
+}
 
-    Q_ASSERT( m_pProcess->state() == QProcess::NotRunning );
+void CScriptsMetricsChecker::onScriptFinished( int nScript )
+{
+    SScript& oScript = m_aScripts[nScript];
+    CJobProcess* pProcess = oScript.pProcess;
+    if( !pProcess )
+        return;
 
-    m_pProcess->start(sCommand, lstArguments);
-    m_pProcess->waitForFinished(-1);
+    oScript.pProcess = nullptr;
+    oScript.nLastDurationMsecs = oScript.oRunTimer.elapsed();
+    --m_nRunning;
 
-    if( m_pProcess->exitStatus() == QProcess::NormalExit )
+    if( oScript.bTimedOut )
+    {
+        LOG_ERROR( QString( "Error: Script killed after %1 msec timeout: File: %2" )
+                   .arg( m_nTimeoutMsecs ).arg( oScript.sFileName ).toStdString() );
+        ++oScript.nFailures;
+        oScript.lstLastResults.clear();
+    }
+    else if( pProcess->error() == QProcess::FailedToStart || pProcess->exitStatus() != QProcess::NormalExit )
+    {
+        LOG_ERROR( "Error: Script has been crashed: File: " + oScript.sFileName.toStdString() );
+        ++oScript.nFailures;
+        oScript.lstLastResults.clear();
+    }
+    else
+    {
+        oScript.lstLastResults = oScript.oParser.Parse( pProcess->readAllStandardOutput() );
+    }
+
+    pProcess->disconnect( this );
+    pProcess->deleteLater();
+
+    // the freed process slot takes the next waiting script
+    StartPendingScripts();
+}
+
+void CScriptsMetricsChecker::CheckPlugin( int nScript )
+{
+    SScript& oScript = m_aScripts[nScript];
+    if( !oScript.pProcess )
     {
-        QString sResult = m_pProcess->readAllStandardOutput();
-        QStringList lstResultLines = sResult.split( "\r\n", QString::SkipEmptyParts );
+        // restart after the backoff delay
+        if( oScript.oRestartTimer.isValid() && oScript.oRestartTimer.elapsed() < oScript.nRestartDelayMsecs )
+            return;
+        StartPlugin( nScript );
+        return;
+    }
+
+    if( oScript.pProcess->state() != QProcess::Running )
+        return;
 
-        for( QString& sResultLine : lstResultLines )
+    if( oScript.bAwaitingSample )
+    {
+        // no new request until the previous one is answered
+        if( oScript.oRunTimer.elapsed() > m_nTimeoutMsecs )
         {
-            QStringList lstMetricData = sResultLine.split( " ", QString::SkipEmptyParts );
-            if( lstMetricData.size() < 2 )
-            {
-                // Invalid result
-                LOG_ERROR( "Invalid script result. Insufficient number of output data: File: "
-                           + QFileInfo( sSrcoptFilePath ).fileName().toStdString() );
-                continue;
-            }
-
-            // output count is 2+
-            // create metric data object
-            MetricDataSPtr pMetricData = std::make_shared<CMetricData>();
-            pMetricData->SetName( lstMetricData[0] );
-            pMetricData->SetValue( QVariant( lstMetricData[1] ) );
-            pMetricData->SetTime( QDateTime::currentDateTime() );
-
-            // continue commiting outputs
-            if( lstMetricData.size() >= 3 )
-            {
-                pMetricData->SetMetricType( lstMetricData[2] );
-                if( lstMetricData.size() >= 4 )
-                {
-                    pMetricData->SetDataType( lstMetricData[3] );
-                }
-            }
-
-            lstResltMetricsData.append( pMetricData );
+            oScript.bTimedOut = true;
+            oScript.pProcess->KillTree();
         }
+        return;
     }
-    else
+
+    oScript.bAwaitingSample = true;
+    oScript.lstSample.clear();
+    oScript.oParser.Reset();
+    oScript.oRunTimer.start();
+    oScript.pProcess->write( "tick\n" );
+}
+
+void CScriptsMetricsChecker::StartPlugin( int nScript )
+{
+    SScript& oScript = m_aScripts[nScript];
+
+    if( !QFile(oScript.sFilePath).exists() )
     {
-        LOG_ERROR( "Error: Script has been crashed: File: " + QFileInfo( sSrcoptFilePath ).fileName().toStdString() );
+        LOG_ERROR("Script execution error: Script file not exists. File: " + oScript.sFileName.toStdString() );
+        ++oScript.nFailures;
+        oScript.nRestartDelayMsecs = 60000;
+        oScript.oRestartTimer.start();
+        return;
     }
 
-    return lstResltMetricsData;
+    CJobProcess* pProcess = CreateProcess( nScript );
+    oScript.bAwaitingSample = false;
+    oScript.aOutputBuffer.clear();
+    oScript.lstSample.clear();
+
+    connect( pProcess, &QProcess::readyReadStandardOutput, this, [this, nScript]() { onPluginOutput( nScript ); } );
+    void (QProcess:: *pFinished)(int, QProcess::ExitStatus) = &QProcess::finished;
+    connect( pProcess, pFinished, this, [this, nScript]() { onPluginFinished( nScript ); } );
+    connect( pProcess, &QProcess::errorOccurred, this,
+    [this, nScript]( QProcess::ProcessError eError )
+    {
+        if( eError == QProcess::FailedToStart )
+            onPluginFinished( nScript );
+    });
+
+    pProcess->start( "cmd.exe", QStringList{ QString("/C"), oScript.sFilePath } );
+    LOG_INFO( "Script plugin started: " + oScript.sFileName );
+}
+
+void CScriptsMetricsChecker::onPluginOutput( int nScript )
+{
+    SScript& oScript = m_aScripts[nScript];
+    if( !oScript.pProcess )
+        return;
+
+    oScript.aOutputBuffer.append( oScript.pProcess->readAllStandardOutput() );
+
+    // complete lines are parsed in place, the tail waits for more output
+    char const* pData = oScript.aOutputBuffer.constData();
+    int nLineBegin = 0;
+    int nLineEnd;
+    while( (nLineEnd = oScript.aOutputBuffer.indexOf( '\n', nLineBegin )) >= 0 )
+    {
+        char const* pLine    = pData + nLineBegin;
+        char const* pLineEnd = pData + nLineEnd;
+        nLineBegin = nLineEnd + 1;
+
+        if( !CScriptOutputParser::IsBlank( pLine, pLineEnd ) )
+        {
+            MetricDataSPtr pMetricData = oScript.oParser.ParseLine( pLine, pLineEnd );
+            if( pMetricData )
+                oScript.lstSample.append( pMetricData );
+            continue;
+        }
+
+        // empty line ends the answer
+        if( !oScript.bAwaitingSample )
+            continue;
+        oScript.lstLastResults = oScript.lstSample;
+        oScript.lstSample.clear();
+        oScript.nLastDurationMsecs = oScript.oRunTimer.elapsed();
+        oScript.bAwaitingSample    = false;
+        oScript.nRestartDelayMsecs = 0;
+    }
+    oScript.aOutputBuffer.remove( 0, nLineBegin );
 }
 
+void CScriptsMetricsChecker::onPluginFinished( int nScript )
+{
+    SScript& oScript = m_aScripts[nScript];
+    CJobProcess* pProcess = oScript.pProcess;
+    if( !pProcess )
+        return;
+
+    oScript.pProcess = nullptr;
+    ++oScript.nFailures;
+    oScript.lstLastResults.clear();
+
+    // 1, 2, 4 ... 60 seconds while the plugin keeps failing
+    oScript.nRestartDelayMsecs = oScript.nRestartDelayMsecs == 0? 1000 : qMin( oScript.nRestartDelayMsecs * 2, 60000 );
+    oScript.oRestartTimer.start();
+
+    LOG_ERROR( QString( "Error: Script plugin %1, restart in %2 msec: File: %3" )
+               .arg( oScript.bTimedOut? "did not answer in time" : "exited" )
+               .arg( oScript.nRestartDelayMsecs )
+               .arg( oScript.sFileName ).toStdString() );
+
+    // cmd.exe may be gone while the interpreter still runs, the restarted
+    // plugin must not find an orphan of the previous one
+    pProcess->disconnect( this );
+    pProcess->KillTree();
+    pProcess->deleteLater();
+}
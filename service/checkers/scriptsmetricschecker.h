@@ -2,10 +2,30 @@
 #define SCRIPTSMETRICSCHECKER_H
 
 #include "imetricscategorychecker.h"
+#include "scriptoutputparser.h"
 // Qt
+#include <QElapsedTimer>
+#include <QQueue>
+#include <vector>
 
-class QProcess;
+class CJobProcess;
 
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CScriptsMetricsChecker
+///
+/// Runs check_*.* scripts asynchronously, at most max_concurrent_scripts at once.
+/// A script running longer than script_timeout_seconds is killed together with
+/// the processes it started. Every check reports the results of the last finished
+/// run of each script, so a slow script never blocks collection, plus
+/// script_duration and script_failures per script.
+/// Output is parsed by CScriptOutputParser, results with an own timestamp keep it.
+///
+/// Scripts listed in persistent_scripts are plugins: started once, they get a
+/// "tick" line on stdin every check and answer with result lines terminated by an
+/// empty line. A plugin which exits or does not answer in time is restarted with
+/// exponential backoff.
+///
 class CScriptsMetricsChecker : public IMetricsCategoryChecker
 {
     Q_OBJECT
@@ -17,15 +37,51 @@ public:
 
     // IMetricsCategoryChecker interface
 public:
-    MetricDataList CheckMetrics();
+    void Initialize() override;
+    MetricDataList CheckMetrics() override;
     QStringList GetScriptFileNameList();
 
 private:
+    struct SScript
+    {
+        QString        sFilePath;
+        QString        sFileName;
+        CJobProcess*   pProcess           = nullptr;    // null if not running
+        QElapsedTimer  oRunTimer;
+        bool           bTimedOut          = false;
+        bool           bPending           = false;      // waiting for a free process
+        MetricDataList lstLastResults;
+        qint64         nLastDurationMsecs = 0;
+        int            nFailures          = 0;
+        CScriptOutputParser oParser;
+
+        // persistent plugin
+        bool           bPersistent        = false;
+        bool           bAwaitingSample    = false;
+        QByteArray     aOutputBuffer;                   // incomplete output line
+        MetricDataList lstSample;                       // lines of the current answer
+        int            nRestartDelayMsecs = 0;
+        QElapsedTimer  oRestartTimer;
+    };
+
     // helpers
-    MetricDataList GetScriptFileResults( QString const& sSrcoptFilePath );
+    void StartPendingScripts();
+    void StartScript( int nScript );
+    void onScriptFinished( int nScript );
+    CJobProcess* CreateProcess( int nScript );
+
+    void CheckPlugin( int nScript );
+    void StartPlugin( int nScript );
+    void onPluginOutput( int nScript );
+    void onPluginFinished( int nScript );
 
 private:
-    std::unique_ptr<QProcess> m_pProcess;
+    std::vector<SScript> m_aScripts;
+    QQueue<int>          m_qPending;
+    int                  m_nRunning;
+    int                  m_nMaxConcurrent;
+    int                  m_nTimeoutMsecs;
 };
+////////////////////////////////////////////////////////////////////////////////////////
 
 #endif // SCRIPTSMETRICSCHECKER_H
@@ -0,0 +1,311 @@
+#include "statsdchecker.h"
+#include "scriptoutputparser.h"
+#include "../commonexceptions.h"
+#include "../logger.h"
+#include "../tickclock.h"
+
+// Qt
+#include <QUdpSocket>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+// gauges are repeated this many checks after their last update
+const int c_nGaugeExpireTicks = 60;
+const int c_nMaxDatagramSize  = 65536;
+const int c_nMaxKeySize       = 1024;
+
+inline char const* Find( char const* pBegin, char const* pEnd, char ch )
+{
+    char const* pFound = static_cast<char const*>( std::memchr( pBegin, ch, size_t(pEnd - pBegin) ) );
+    return pFound? pFound : pEnd;
+}
+
+inline bool Equals( char const* pBegin, char const* pEnd, char const* szText )
+{
+    size_t nLength = std::strlen( szText );
+    return size_t(pEnd - pBegin) == nLength && std::memcmp( pBegin, szText, nLength ) == 0;
+}
+}
+
+CStatsDChecker::CStatsDChecker( quint16 nPort, QObject* pParent )
+    : Base( pParent ),
+      m_nPort( nPort ),
+      m_pSocket( nullptr ),
+      m_nMaxSeries( 10000 ),
+      m_nReceivedLines( 0 ),
+      m_nInvalidLines( 0 ),
+      m_nDroppedLines( 0 )
+{
+}
+
+void CStatsDChecker::Initialize()
+{
+    Base::Initialize();
+
+    m_nMaxSeries = qMax( ConfMgr.GetMainConfiguration().Value<int>( "SelfConfig/statsd_max_series", 10000 ), 1 );
+
+    m_lstQuantiles.clear();
+    for( QString const& sPercent : ConfMgr.GetMainConfiguration().Value<QStringList>( "SelfConfig/quantiles",
+                                                                                       QStringList() << "50" << "90" << "99" ) )
+    {
+        bool bOk = false;
+        double dPercent = sPercent.trimmed().toDouble( &bOk );
+        if( bOk && dPercent > 0 && dPercent < 100 )
+            m_lstQuantiles.append( dPercent / 100 );
+    }
+
+    // buffers keep their capacity, receiving and lookups do not allocate
+    m_aDatagram.reserve( c_nMaxDatagramSize );
+    m_aKey.reserve( c_nMaxKeySize );
+
+    m_pSocket = new QUdpSocket( this );
+    if( !m_pSocket->bind( QHostAddress::LocalHost, m_nPort ) )
+        throw CCheckerInitializationException( QString( "StatsD listener on port %1: %2" ).arg( m_nPort ).arg( m_pSocket->errorString() ) );
+    connect( m_pSocket, &QUdpSocket::readyRead, this, &CStatsDChecker::onReadyRead );
+
+    m_oFlushTimer.start();
+    LOG_INFO( QString( "StatsD listener started on localhost:%1" ).arg( m_nPort ) );
+}
+
+MetricDataList CStatsDChecker::CheckMetrics()
+{
+    // take what is waiting in the socket into this check
+    onReadyRead();
+
+    MetricDataList lstResults;
+    QDateTime oTime = CTickClock::Instance().GetTickTime();
+    double dSeconds = qMax( m_oFlushTimer.restart(), qint64(1) ) / 1000.;
+
+    for( SSeries& oSeries : m_aSeries )
+    {
+        if( !oSeries.bUpdated )
+        {
+            // gauges keep the last value for a while
+            if( oSeries.eKind == ESeriesKind::Gauge && oSeries.nIdleTicks < c_nGaugeExpireTicks )
+            {
+                ++oSeries.nIdleTicks;
+                AppendPoint( lstResults, oSeries, QString(), oSeries.dValue, EMetricDataType::None, oTime );
+            }
+            continue;
+        }
+
+        switch( oSeries.eKind )
+        {
+        case ESeriesKind::Counter:
+            AppendPoint( lstResults, oSeries, QString(), oSeries.dValue, EMetricDataType::None, oTime );
+            AppendPoint( lstResults, oSeries, "_rate", oSeries.dValue / dSeconds, EMetricDataType::Rate, oTime );
+            oSeries.dValue = 0;
+            break;
+        case ESeriesKind::Gauge:
+            AppendPoint( lstResults, oSeries, QString(), oSeries.dValue, EMetricDataType::None, oTime );
+            break;
+        case ESeriesKind::Timer:
+            AppendPoint( lstResults, oSeries, "_count", oSeries.dCount, EMetricDataType::None, oTime );
+            AppendPoint( lstResults, oSeries, "_mean", oSeries.dSum / oSeries.dCount, EMetricDataType::None, oTime );
+            AppendPoint( lstResults, oSeries, "_min", oSeries.dMin, EMetricDataType::None, oTime );
+            AppendPoint( lstResults, oSeries, "_max", oSeries.dMax, EMetricDataType::None, oTime );
+            for( double dQuantile : m_lstQuantiles )
+                AppendPoint( lstResults, oSeries, "_p" + QString::number( dQuantile * 100 ),
+                             oSeries.pSketch->GetQuantile( dQuantile ), EMetricDataType::None, oTime );
+            oSeries.dCount = oSeries.dSum = 0;
+            oSeries.pSketch->Clear();
+            break;
+        }
+
+        oSeries.bUpdated   = false;
+        oSeries.nIdleTicks = 0;
+    }
+
+    lstResults.append( std::make_shared<CMetricData>( "statsd_lines", m_nReceivedLines, EMetricDataType::Counter,
+                                                      oTime, "health" ) );
+    lstResults.append( std::make_shared<CMetricData>( "statsd_invalid_lines", m_nInvalidLines, EMetricDataType::Counter,
+                                                      oTime, "health" ) );
+    lstResults.append( std::make_shared<CMetricData>( "statsd_dropped_lines", m_nDroppedLines, EMetricDataType::Counter,
+                                                      oTime, "health" ) );
+    return lstResults;
+}
+
+void CStatsDChecker::onReadyRead()
+{
+    if( !m_pSocket )
+        return;
+
+    while( m_pSocket->hasPendingDatagrams() )
+    {
+        qint64 nSize = m_pSocket->pendingDatagramSize();
+        m_aDatagram.resize( int( qBound( qint64(1), nSize, qint64(c_nMaxDatagramSize) ) ) );
+        nSize = m_pSocket->readDatagram( m_aDatagram.data(), m_aDatagram.size() );
+        if( nSize <= 0 )
+            continue;
+
+        char const* pPos = m_aDatagram.constData();
+        char const* pEnd = pPos + nSize;
+        while( pPos < pEnd )
+        {
+            char const* pLineEnd = Find( pPos, pEnd, '\n' );
+            if( pLineEnd != pPos )
+                ParseLine( pPos, pLineEnd );
+            pPos = pLineEnd + 1;
+        }
+    }
+}
+
+void CStatsDChecker::ParseLine( char const* pBegin, char const* pEnd )
+{
+    if( pEnd != pBegin && pEnd[-1] == '\r' )
+        --pEnd;
+    if( pEnd == pBegin )
+        return;
+    ++m_nReceivedLines;
+
+    // name:value|type[|@rate][|#tags]
+    char const* pColon = Find( pBegin, pEnd, ':' );
+    char const* pValueEnd = Find( pColon, pEnd, '|' );
+    if( pColon == pBegin || pColon == pEnd || pValueEnd == pEnd )
+    {
+        ++m_nInvalidLines;
+        return;
+    }
+    char const* pValue = pColon + 1;
+    char const* pType = pValueEnd + 1;
+    char const* pTypeEnd = Find( pType, pEnd, '|' );
+
+    ESeriesKind eKind;
+    if( Equals( pType, pTypeEnd, "c" ) )
+        eKind = ESeriesKind::Counter;
+    else if( Equals( pType, pTypeEnd, "g" ) )
+        eKind = ESeriesKind::Gauge;
+    else if( Equals( pType, pTypeEnd, "ms" ) || Equals( pType, pTypeEnd, "h" ) )
+        eKind = ESeriesKind::Timer;
+    else
+    {
+        // sets and unknown types
+        ++m_nInvalidLines;
+        return;
+    }
+
+    double dValue = 0;
+    if( !CScriptOutputParser::ParseDouble( pValue, pValueEnd, dValue ) )
+    {
+        ++m_nInvalidLines;
+        return;
+    }
+
+    double dRate = 1;
+    char const* pTags = pEnd;
+    char const* pTagsEnd = pEnd;
+    for( char const* pSection = pTypeEnd; pSection < pEnd; )
+    {
+        char const* pSectionBegin = pSection + 1;
+        char const* pSectionEnd = Find( pSectionBegin, pEnd, '|' );
+        if( pSectionBegin != pSectionEnd && *pSectionBegin == '@' )
+        {
+            if( !CScriptOutputParser::ParseDouble( pSectionBegin + 1, pSectionEnd, dRate ) || dRate <= 0 || dRate > 1 )
+            {
+                ++m_nInvalidLines;
+                return;
+            }
+        }
+        else if( pSectionBegin != pSectionEnd && *pSectionBegin == '#' )
+        {
+            pTags = pSectionBegin + 1;
+            pTagsEnd = pSectionEnd;
+        }
+        pSection = pSectionEnd;
+    }
+
+    // key is the name with tags, built in a buffer which keeps its capacity
+    m_aKey.resize( 0 );
+    m_aKey.append( pBegin, int(pColon - pBegin) );
+    if( pTags != pTagsEnd )
+    {
+        m_aKey.append( '|' );
+        m_aKey.append( pTags, int(pTagsEnd - pTags) );
+    }
+
+    int nSeries;
+    auto it = m_mapSeries.constFind( m_aKey );
+    if( it != m_mapSeries.constEnd() )
+        nSeries = it.value();
+    else
+    {
+        nSeries = AddSeries( m_aKey, pBegin, pColon, pTags, pTagsEnd, eKind );
+        if( nSeries < 0 )
+            return;
+    }
+
+    SSeries& oSeries = m_aSeries[size_t(nSeries)];
+    if( oSeries.eKind != eKind )
+    {
+        ++m_nInvalidLines;
+        return;
+    }
+
+    switch( eKind )
+    {
+    case ESeriesKind::Counter:
+        oSeries.dValue += dValue / dRate;
+        break;
+    case ESeriesKind::Gauge:
+        // signed values change the gauge
+        if( *pValue == '+' || *pValue == '-' )
+            oSeries.dValue += dValue;
+        else
+            oSeries.dValue = dValue;
+        break;
+    case ESeriesKind::Timer:
+        if( oSeries.dCount == 0 )
+            oSeries.dMin = oSeries.dMax = dValue;
+        oSeries.dMin    = std::min( oSeries.dMin, dValue );
+        oSeries.dMax    = std::max( oSeries.dMax, dValue );
+        oSeries.dCount += 1 / dRate;
+        oSeries.dSum   += dValue / dRate;
+        oSeries.pSketch->Add( dValue );
+        break;
+    }
+    oSeries.bUpdated = true;
+}
+
+int CStatsDChecker::AddSeries( QByteArray const& aKey, char const* pName, char const* pNameEnd,
+                               char const* pTags, char const* pTagsEnd, ESeriesKind eKind )
+{
+    if( int(m_aSeries.size()) >= m_nMaxSeries )
+    {
+        if( m_nDroppedLines++ == 0 )
+            LOG_WARNING( QString( "StatsD series limit %1 reached, new series are dropped" ).arg( m_nMaxSeries ).toStdString() );
+        return -1;
+    }
+
+    SSeries oSeries;
+    oSeries.sName = QString::fromUtf8( pName, int(pNameEnd - pName) );
+    oSeries.eKind = eKind;
+    if( eKind == ESeriesKind::Timer )
+        oSeries.pSketch = std::make_shared<CDDSketch>();
+
+    // tag:value,tag:value
+    for( char const* pTag = pTags; pTag < pTagsEnd; )
+    {
+        char const* pTagEnd = Find( pTag, pTagsEnd, ',' );
+        char const* pSeparator = Find( pTag, pTagEnd, ':' );
+        if( pSeparator != pTag && pSeparator != pTagEnd )
+            oSeries.lstTags.append( qMakePair( QString::fromUtf8( pTag, int(pSeparator - pTag) ),
+                                               QString::fromUtf8( pSeparator + 1, int(pTagEnd - pSeparator - 1) ) ) );
+        pTag = pTagEnd + 1;
+    }
+
+    m_mapSeries.insert( QByteArray( aKey.constData(), aKey.size() ), int(m_aSeries.size()) );
+    m_aSeries.push_back( oSeries );
+    return int(m_aSeries.size()) - 1;
+}
+
+void CStatsDChecker::AppendPoint( MetricDataList& lstResults, SSeries const& oSeries, QString const& sSuffix,
+                                  double dValue, EMetricDataType eDataType, QDateTime const& oTime ) const
+{
+    MetricDataSPtr pMetricData = std::make_shared<CMetricData>( oSeries.sName + sSuffix, dValue, eDataType, oTime, "statsd" );
+    for( auto const& oTag : oSeries.lstTags )
+        pMetricData->AddTag( oTag.first, oTag.second );
+    lstResults.append( pMetricData );
+}
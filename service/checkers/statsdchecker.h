@@ -0,0 +1,94 @@
+#ifndef STATSDCHECKER_H
+#define STATSDCHECKER_H
+
+#include "imetricscategorychecker.h"
+#include "../ddsketch.h"
+// Qt
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <memory>
+#include <vector>
+
+class QUdpSocket;
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CStatsDChecker
+///
+/// Receives application metrics pushed in StatsD format over UDP on localhost:
+///
+///     name:value|c|@rate|#tag:value,...   counter, sent as the count and _rate per second
+///     name:value|g                        gauge, +value / -value change it
+///     name:value|ms (or h)                timer, sent as _count, _mean, _min, _max, _pNN
+///
+/// Datagrams are parsed in place from a reused buffer and known series are found
+/// without allocating, so the per line cost is a hash lookup and an add. Each check
+/// flushes the values accumulated since the previous one. The socket is served by
+/// the engine thread, so the accumulators need no locking.
+///
+class CStatsDChecker : public IMetricsCategoryChecker
+{
+    Q_OBJECT
+    using Base = IMetricsCategoryChecker;
+
+public:
+    CStatsDChecker( quint16 nPort, QObject* pParent = nullptr );
+
+    // IMetricsCategoryChecker interface
+public:
+    void Initialize() override;
+    MetricDataList CheckMetrics() override;
+
+private:
+    enum class ESeriesKind
+    {
+        Counter,
+        Gauge,
+        Timer
+    };
+
+    struct SSeries
+    {
+        QString       sName;
+        MetricTagList lstTags;
+        ESeriesKind   eKind;
+        double        dValue     = 0;       // counter sum, gauge value
+        double        dCount     = 0;       // timer values, scaled by sample rate
+        double        dSum       = 0;
+        double        dMin       = 0;
+        double        dMax       = 0;
+        std::shared_ptr<CDDSketch> pSketch;
+        bool          bUpdated   = false;
+        int           nIdleTicks = 0;
+    };
+
+    // helpers
+    void onReadyRead();
+    void ParseLine( char const* pBegin, char const* pEnd );
+    int  AddSeries( QByteArray const& aKey, char const* pName, char const* pNameEnd,
+                    char const* pTags, char const* pTagsEnd, ESeriesKind eKind );
+    void AppendPoint( MetricDataList& lstResults, SSeries const& oSeries, QString const& sSuffix,
+                      double dValue, EMetricDataType eDataType, QDateTime const& oTime ) const;
+
+private:
+    //
+    //	Content
+    //
+    quint16              m_nPort;
+    QUdpSocket*          m_pSocket;
+    QByteArray           m_aDatagram;       // reused receive buffer
+    QByteArray           m_aKey;            // reused series key buffer
+    QHash<QByteArray, int> m_mapSeries;
+    std::vector<SSeries> m_aSeries;
+    int                  m_nMaxSeries;
+    QList<double>        m_lstQuantiles;
+    QElapsedTimer        m_oFlushTimer;
+
+    qint64               m_nReceivedLines;
+    qint64               m_nInvalidLines;
+    qint64               m_nDroppedLines;   // new series over the limit
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // STATSDCHECKER_H
@@ -0,0 +1,193 @@
+#include "system_process_stats.h"
+#include "../commonexceptions.h"
+#include "../winpdhexception.h"
+#include "../performancecountersinfoprovider.h"
+#include "../tickclock.h"
+
+#include <QThread>
+#include <algorithm>
+
+namespace
+{
+struct SProcessMetric
+{
+    char const*     szName;
+    char const*     szCounter;
+    EMetricDataType eDataType;
+};
+
+// indexed by SystemProcessStats::ESortKey
+const SProcessMetric c_aProcessMetrics[] =
+{
+    { "process_cpu",     "% Processor Time",  EMetricDataType::Percent },
+    { "process_memory",  "Working Set",       EMetricDataType::Counter },
+    { "process_io",      "IO Data Bytes/sec", EMetricDataType::Rate    },
+    { "process_handles", "Handle Count",      EMetricDataType::Counter }
+};
+const int c_nProcessMetricCount = sizeof(c_aProcessMetrics) / sizeof(c_aProcessMetrics[0]);
+}
+
+SystemProcessStats::SystemProcessStats( QObject* pParent )
+    : Base( pParent ),
+      m_nTopCount( 10 ),
+      m_eSortKey( ESortKey::Cpu ),
+      m_bOtherEnabled( true ),
+      m_dCpuScale( 1 ),
+      m_nObjectIndex( 0 ),
+      m_nStartTimeIndex( 0 )
+{
+    std::fill( std::begin(m_aCounterIndexes), std::end(m_aCounterIndexes), 0 );
+}
+
+void SystemProcessStats::Initialize()
+{
+    m_nTopCount     = ConfigSection().Value<int>( "top_n", 10 );
+    m_bOtherEnabled = ConfigSection().Value<bool>( "other_bucket", true );
+    if( m_nTopCount < 0 )
+        throw CInvalidConfigValueException( "top_n = " + QString::number( m_nTopCount ) );
+
+    QString sSortBy = ConfigSection().Value<QString>( "sort_by", "cpu" ).trimmed().toLower();
+    if( sSortBy == "cpu" )
+        m_eSortKey = ESortKey::Cpu;
+    else if( sSortBy == "memory" )
+        m_eSortKey = ESortKey::Memory;
+    else if( sSortBy == "io" )
+        m_eSortKey = ESortKey::IO;
+    else if( sSortBy == "handles" )
+        m_eSortKey = ESortKey::Handles;
+    else
+        throw CInvalidConfigValueException( "sort_by = " + sSortBy );
+
+    int nProcessorCount = QThread::idealThreadCount();
+    m_dCpuScale = nProcessorCount > 0? 1.0 / nProcessorCount : 1.0;
+
+    BulkPerfDataCollectorSPtr pCollector = BulkPerfDataCollector();
+    Q_ASSERT(pCollector);
+    if( !pCollector )
+        throw CException( "Bulk performance data collector is not set" );
+
+    m_nObjectIndex = pCollector->RegisterObject( "Process" );
+    for( int i = 0; i < c_nProcessMetricCount; ++i )
+    {
+        m_aCounterIndexes[i] = pCollector->GetNameIndex( c_aProcessMetrics[i].szCounter );
+        if( m_aCounterIndexes[i] == 0 )
+            throw CWinCounterRetrieveException( QString( "Process counter not found: %1" ).arg( c_aProcessMetrics[i].szCounter ) );
+    }
+    m_nStartTimeIndex = pCollector->GetNameIndex( "Elapsed Time" );
+}
+
+MetricDataList SystemProcessStats::CheckMetrics()
+{
+    MetricDataList lstMetrics;
+
+    SampleProcesses();
+    if( m_aRows.empty() )
+        return lstMetrics;
+
+    SPerfObject const* pObject = BulkPerfDataCollector()->GetObject( m_nObjectIndex );
+    Q_ASSERT(pObject);
+
+    // only the top rows get ordered
+    int nSortKey = static_cast<int>( m_eSortKey );
+    auto itTopEnd = m_aRows.begin() + std::min<size_t>( size_t(m_nTopCount), m_aRows.size() );
+    std::partial_sort( m_aRows.begin(), itTopEnd, m_aRows.end(),
+                       [nSortKey]( SProcessRow const& oLeft, SProcessRow const& oRight )
+    {
+        if( oLeft.aValues[nSortKey] != oRight.aValues[nSortKey] )
+            return oLeft.aValues[nSortKey] > oRight.aValues[nSortKey];
+        return oLeft.nStartTime < oRight.nStartTime;
+    } );
+
+    QDateTime oTime = CTickClock::Instance().GetTickTime();
+    for( auto it = m_aRows.begin(); it != itTopEnd; ++it )
+        AppendMetrics( lstMetrics, it->aValues, MakeIdentity( *pObject, *it ), oTime );
+
+    if( m_bOtherEnabled && itTopEnd != m_aRows.end() )
+    {
+        double aOther[c_nProcessMetricCount] = {};
+        for( auto it = itTopEnd; it != m_aRows.end(); ++it )
+            for( int i = 0; i < c_nProcessMetricCount; ++i )
+                aOther[i] += it->aValues[i];
+
+        AppendMetrics( lstMetrics, aOther, "other", oTime );
+    }
+
+    return lstMetrics;
+}
+
+void SystemProcessStats::SampleProcesses()
+{
+    m_aRows.clear();
+
+    BulkPerfDataCollectorSPtr pCollector = BulkPerfDataCollector();
+    Q_ASSERT(pCollector);
+    SPerfObject const* pObject = pCollector->GetObject( m_nObjectIndex );
+    if( !pObject || !pObject->bHasInstances )
+        return;
+
+    CBulkPerfDataCollector::SCounter aCounters[c_nProcessMetricCount];
+    for( int i = 0; i < c_nProcessMetricCount; ++i )
+        aCounters[i] = pCollector->ResolveCounter( m_nObjectIndex, m_aCounterIndexes[i] );
+    CBulkPerfDataCollector::SCounter oStartTime = pCollector->ResolveCounter( m_nObjectIndex, m_nStartTimeIndex );
+
+    m_aRows.reserve( pObject->nInstanceCount );
+    for( uint32_t nInstance = 0; nInstance < pObject->nInstanceCount; ++nInstance )
+    {
+        SPerfNameView const& oName = pObject->pInstances[nInstance].oName;
+        // "_Total" is a sum and "Idle" is not a process
+        if( oName.GetLength() == 6 && CPerformanceCountersInfoProvider::ToString( oName ) == "_Total" )
+            continue;
+        if( oName.GetLength() == 4 && CPerformanceCountersInfoProvider::ToString( oName ) == "Idle" )
+            continue;
+
+        SProcessRow oRow;
+        oRow.nInstance = nInstance;
+        oRow.nStartTime = 0;
+        pCollector->GetRawCounterValue( oStartTime, nInstance, oRow.nStartTime );
+
+        for( int i = 0; i < c_nProcessMetricCount; ++i )
+        {
+            // rates are not available on the first check
+            if( !pCollector->GetCounterValue( aCounters[i], nInstance, oRow.aValues[i] ) )
+                oRow.aValues[i] = 0;
+        }
+        oRow.aValues[static_cast<int>(ESortKey::Cpu)] *= m_dCpuScale;
+
+        m_aRows.push_back( oRow );
+    }
+}
+
+QString SystemProcessStats::MakeIdentity( SPerfObject const& oObject, SProcessRow const& oRow ) const
+{
+    SPerfNameView const& oName = oObject.pInstances[oRow.nInstance].oName;
+
+    // processes with the same name are numbered from the oldest one
+    int nOrdinal = 0;
+    for( SProcessRow const& oOther : m_aRows )
+    {
+        if( oOther.nInstance == oRow.nInstance || oObject.pInstances[oOther.nInstance].oName != oName )
+            continue;
+        if( oOther.nStartTime < oRow.nStartTime
+                || (oOther.nStartTime == oRow.nStartTime && oOther.nInstance < oRow.nInstance) )
+            ++nOrdinal;
+    }
+
+    QString sIdentity = CPerformanceCountersInfoProvider::ToString( oName );
+    if( nOrdinal > 0 )
+        sIdentity += "#" + QString::number( nOrdinal );
+    return sIdentity;
+}
+
+void SystemProcessStats::AppendMetrics( MetricDataList& lstMetrics, double const* pValues,
+                                        QString const& sInstanceName, QDateTime const& oTime ) const
+{
+    for( int i = 0; i < c_nProcessMetricCount; ++i )
+    {
+        lstMetrics.append( std::make_shared<CMetricData>( c_aProcessMetrics[i].szName,
+                                                          pValues[i],
+                                                          c_aProcessMetrics[i].eDataType,
+                                                          oTime,
+                                                          "SYSTEM", 0,
+                                                          "Process", sInstanceName ) );
+    }
+}
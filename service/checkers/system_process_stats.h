@@ -0,0 +1,72 @@
+#ifndef SYSTEMPROCESSSTATS_H
+#define SYSTEMPROCESSSTATS_H
+
+#include "../imetricscategorychecker.h"
+
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class SystemProcessStats
+///
+/// Per-process metrics of the top N processes, ordered by CPU, working set, I/O or
+/// handle count. All processes are sampled with one bulk data block read per check,
+/// only the selected ones are reported; the rest are summed into the "other"
+/// instance. Instance names are process names, numbered by start time when several
+/// processes share a name, so a restarted process keeps its series.
+///
+class SystemProcessStats : public IMetricsCategoryChecker
+{
+    DECLARE_MERTIC_CHECKER(SystemProcessStats)
+    using Base = IMetricsCategoryChecker;
+
+public:
+    enum class ESortKey
+    {
+        Cpu = 0,
+        Memory,
+        IO,
+        Handles
+    };
+
+public:
+    SystemProcessStats( QObject* pParent = nullptr );
+
+public:
+    // IMetricsCategoryChecker interface
+    void Initialize() override;
+    MetricDataList CheckMetrics() override;
+
+private:
+    struct SProcessRow
+    {
+        uint32_t nInstance;         // position in the current data block
+        uint64_t nStartTime;        // raw "Elapsed Time" value, smaller is older
+        double   aValues[4];        // indexed by ESortKey
+    };
+
+    void SampleProcesses();
+    QString MakeIdentity( SPerfObject const& oObject, SProcessRow const& oRow ) const;
+    void AppendMetrics( MetricDataList& lstMetrics, double const* pValues,
+                        QString const& sInstanceName, QDateTime const& oTime ) const;
+
+private:
+    //
+    //  Content
+    //
+    int      m_nTopCount;
+    ESortKey m_eSortKey;
+    bool     m_bOtherEnabled;
+    double   m_dCpuScale;           // to make 100% mean all logical processors
+
+    uint32_t m_nObjectIndex;
+    uint32_t m_aCounterIndexes[4];  // indexed by ESortKey
+    uint32_t m_nStartTimeIndex;
+
+    std::vector<SProcessRow> m_aRows;
+};
+
+REGISTER_METRIC_CHECKER( SystemProcessStats )
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // SYSTEMPROCESSSTATS_H
@@ -0,0 +1,13 @@
+#include "uploadstatschecker.h"
+#include "../upload/uploadstatistics.h"
+#include "../tickclock.h"
+
+CUploadStatsChecker::CUploadStatsChecker( QObject* pParent )
+    : Base( pParent )
+{
+}
+
+MetricDataList CUploadStatsChecker::CheckMetrics()
+{
+    return CUploadStatistics::Instance().MakeMetrics( CTickClock::Instance().GetTickTime() );
+}
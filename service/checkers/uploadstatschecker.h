@@ -0,0 +1,27 @@
+#ifndef UPLOADSTATSCHECKER_H
+#define UPLOADSTATSCHECKER_H
+
+#include "imetricscategorychecker.h"
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CUploadStatsChecker
+///
+/// Sends the upload pipeline counters of CUploadStatistics as agent self metrics,
+/// so backend slowness and a growing cache are seen before data is lost.
+///
+class CUploadStatsChecker : public IMetricsCategoryChecker
+{
+    Q_OBJECT
+    using Base = IMetricsCategoryChecker;
+
+public:
+    CUploadStatsChecker( QObject* pParent = nullptr );
+
+    // IMetricsCategoryChecker interface
+public:
+    MetricDataList CheckMetrics() override;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // UPLOADSTATSCHECKER_H
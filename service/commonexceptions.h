@@ -68,15 +68,6 @@ public:
 ////////////////////////////////////////////////////////////////
 
 
-////////////////////////////////////////////////////////////////
-class CPingFailedException : public CException
-{
-public:
-    inline CPingFailedException(QString sMsg)
-        : CException("Ping failed. " + sMsg) {}
-};
-////////////////////////////////////////////////////////////////
-
 ////////////////////////////////////////////////////////////////
 class CPriceInfoFetchFailedException : public CException
 {
@@ -116,4 +107,22 @@ private:
     QString m_sInstanceName;
 };
 ////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////
+class CPerfDataParseException : public CException
+{
+public:
+    inline CPerfDataParseException(QString sMsg)
+        : CException("Malformed performance data block: " + sMsg) {}
+};
+////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////
+class CDerivedMetricException : public CException
+{
+public:
+    inline CDerivedMetricException(QString sMsg)
+        : CException("Invalid derived metric: " + sMsg) {}
+};
+////////////////////////////////////////////////////////////////
 #endif // COMMONEXCEPTIONS_H
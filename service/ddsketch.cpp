@@ -0,0 +1,163 @@
+#include "ddsketch.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+// smaller values are counted as zero, keeps bucket indexes in int range
+const double c_dMinIndexableValue = 1e-9;
+}
+
+CDDSketch::CDDSketch( double dRelativeAccuracy )
+{
+    assert( dRelativeAccuracy > 0 && dRelativeAccuracy < 1 );
+    m_dGamma    = (1 + dRelativeAccuracy) / (1 - dRelativeAccuracy);
+    m_dLogGamma = std::log( m_dGamma );
+    Clear();
+}
+
+void CDDSketch::Clear()
+{
+    m_aBuckets.fill( 0 );
+    m_nOffset     = 0;
+    m_bHasBuckets = false;
+    m_nZeroCount  = 0;
+    m_nCount      = 0;
+    m_dMin        = std::numeric_limits<double>::infinity();
+    m_dMax        = -std::numeric_limits<double>::infinity();
+}
+
+void CDDSketch::Add( double dValue )
+{
+    if( std::isnan( dValue ) )
+        return;
+
+    ++m_nCount;
+    m_dMin = std::min( m_dMin, dValue );
+    m_dMax = std::max( m_dMax, dValue );
+
+    if( dValue <= c_dMinIndexableValue )
+        ++m_nZeroCount;
+    else
+        AddToBucket( BucketIndex( dValue ), 1 );
+}
+
+void CDDSketch::Merge( CDDSketch const& oOther )
+{
+    assert( m_dGamma == oOther.m_dGamma );
+    if( oOther.IsEmpty() )
+        return;
+
+    m_nCount     += oOther.m_nCount;
+    m_nZeroCount += oOther.m_nZeroCount;
+    m_dMin = std::min( m_dMin, oOther.m_dMin );
+    m_dMax = std::max( m_dMax, oOther.m_dMax );
+
+    // from the top, so the window is placed by the highest bucket first
+    for( int i = c_nBucketCount - 1; i >= 0; --i )
+        if( oOther.m_aBuckets[i] != 0 )
+            AddToBucket( oOther.m_nOffset + i, oOther.m_aBuckets[i] );
+}
+
+bool CDDSketch::IsEmpty() const
+{
+    return m_nCount == 0;
+}
+
+uint64_t CDDSketch::GetCount() const
+{
+    return m_nCount;
+}
+
+double CDDSketch::GetMin() const
+{
+    return IsEmpty()? 0 : m_dMin;
+}
+
+double CDDSketch::GetMax() const
+{
+    return IsEmpty()? 0 : m_dMax;
+}
+
+double CDDSketch::GetQuantile( double dQuantile ) const
+{
+    if( IsEmpty() )
+        return 0;
+    if( dQuantile <= 0 )
+        return m_dMin;
+    if( dQuantile >= 1 )
+        return m_dMax;
+
+    uint64_t nRank = static_cast<uint64_t>( dQuantile * double(m_nCount - 1) );
+    if( nRank < m_nZeroCount )
+        return std::max( m_dMin, 0.0 );
+
+    uint64_t nCumulative = m_nZeroCount;
+    for( int i = 0; i < c_nBucketCount; ++i )
+    {
+        nCumulative += m_aBuckets[i];
+        if( nCumulative > nRank )
+        {
+            // middle of the bucket in the relative sense
+            double dValue = 2 * std::pow( m_dGamma, m_nOffset + i ) / (m_dGamma + 1);
+            return std::min( std::max( dValue, m_dMin ), m_dMax );
+        }
+    }
+
+    return m_dMax;
+}
+
+int CDDSketch::BucketIndex( double dValue ) const
+{
+    return static_cast<int>( std::ceil( std::log( dValue ) / m_dLogGamma ) );
+}
+
+void CDDSketch::AddToBucket( int nIndex, uint64_t nCount )
+{
+    if( !m_bHasBuckets )
+    {
+        // start in the middle, the range may grow both ways
+        m_nOffset     = nIndex - c_nBucketCount / 2;
+        m_bHasBuckets = true;
+    }
+
+    if( nIndex >= m_nOffset + c_nBucketCount )
+    {
+        // move up, lowest buckets are collapsed
+        ShiftWindow( nIndex - c_nBucketCount + 1 );
+    }
+    else if( nIndex < m_nOffset )
+    {
+        int nTop = c_nBucketCount - 1;
+        while( nTop > 0 && m_aBuckets[nTop] == 0 )
+            --nTop;
+
+        if( m_nOffset + nTop - nIndex < c_nBucketCount )
+            ShiftWindow( nIndex );
+        else
+            nIndex = m_nOffset;     // range is too wide, collapse into the lowest bucket
+    }
+
+    m_aBuckets[nIndex - m_nOffset] += nCount;
+}
+
+void CDDSketch::ShiftWindow( int nNewOffset )
+{
+    std::array<uint64_t, c_nBucketCount> aShifted;
+    aShifted.fill( 0 );
+
+    for( int i = 0; i < c_nBucketCount; ++i )
+    {
+        if( m_aBuckets[i] == 0 )
+            continue;
+        int nPos = std::max( m_nOffset + i - nNewOffset, 0 );
+        assert( nPos < c_nBucketCount );
+        aShifted[nPos] += m_aBuckets[i];
+    }
+
+    m_aBuckets = aShifted;
+    m_nOffset  = nNewOffset;
+}
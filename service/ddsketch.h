@@ -0,0 +1,68 @@
+#ifndef DDSKETCH_H
+#define DDSKETCH_H
+
+//
+//  Includes
+//
+#include <array>
+#include <cstdint>
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CDDSketch
+///
+/// Quantile sketch with relative accuracy guarantee (DDSketch). A value x goes to
+/// bucket ceil(log_gamma(x)), gamma = (1 + a) / (1 - a), so every quantile is
+/// estimated within relative error a. Buckets live in a fixed array: memory per
+/// sketch is constant and adding a value is O(1), except for a rare shift when the
+/// value range moves. When the range is wider than the array the lowest buckets
+/// are collapsed, which keeps upper quantiles (the tail) accurate.
+///
+/// Sketches with the same accuracy are mergeable. Values <= 0 are counted as zero.
+///
+class CDDSketch
+{
+public:
+    static const int c_nBucketCount = 512;
+
+public:
+    explicit CDDSketch( double dRelativeAccuracy = 0.01 );
+
+public:
+    //
+    //	Main Interface
+    //
+    void     Add( double dValue );
+    void     Merge( CDDSketch const& oOther );
+    void     Clear();
+
+    bool     IsEmpty() const;
+    uint64_t GetCount() const;
+    double   GetMin() const;
+    double   GetMax() const;
+    // q in [0, 1]. Returns 0 for empty sketch
+    double   GetQuantile( double dQuantile ) const;
+
+private:
+    int  BucketIndex( double dValue ) const;
+    void AddToBucket( int nIndex, uint64_t nCount );
+    void ShiftWindow( int nNewOffset );
+
+private:
+    //
+    //	Content
+    //
+    double   m_dGamma;
+    double   m_dLogGamma;
+
+    std::array<uint64_t, c_nBucketCount> m_aBuckets;
+    int      m_nOffset;         // bucket index of m_aBuckets[0]
+    bool     m_bHasBuckets;
+    uint64_t m_nZeroCount;
+    uint64_t m_nCount;
+    double   m_dMin;
+    double   m_dMax;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // DDSKETCH_H
@@ -0,0 +1,88 @@
+#include "deadbandfilter.h"
+
+#include <algorithm>
+#include <cmath>
+
+CDeadbandFilter::CDeadbandFilter()
+    : m_bEnabled( false ),
+      m_dAbsolute( 0 ),
+      m_dPercent( 0 ),
+      m_nHeartbeatTicks( 10 )
+{
+}
+
+void CDeadbandFilter::SetSettings( bool bEnabled, double dAbsolute, double dPercent, int nHeartbeatTicks )
+{
+    m_bEnabled        = bEnabled;
+    m_dAbsolute       = std::max( dAbsolute, 0.0 );
+    m_dPercent        = std::max( dPercent, 0.0 );
+    m_nHeartbeatTicks = std::max( nHeartbeatTicks, 1 );
+
+    m_mapSeries.clear();
+    m_aStates.clear();
+}
+
+bool CDeadbandFilter::IsEnabled() const
+{
+    return m_bEnabled;
+}
+
+void CDeadbandFilter::Apply( MetricDataList& lstMetrics, int nFrom )
+{
+    if( !m_bEnabled )
+        return;
+
+    for( int i = nFrom; i < lstMetrics.size(); ++i )
+        Apply( *lstMetrics[i] );
+}
+
+void CDeadbandFilter::Apply( CMetricData& oMetric )
+{
+    if( !m_bEnabled )
+        return;
+
+    bool bNumeric = false;
+    double dValue = oMetric.GetValue().toDouble( &bNumeric );
+    if( !bNumeric )
+        return;
+
+    QString sKey = oMetric.GetSeriesKey();
+    auto it = m_mapSeries.find( sKey );
+    if( it == m_mapSeries.end() )
+    {
+        // first point of the series is always reported
+        m_mapSeries.insert( sKey, int(m_aStates.size()) );
+        m_aStates.push_back( SState{ dValue, 0 } );
+        return;
+    }
+
+    SState& oState = m_aStates[it.value()];
+    ++oState.nTicksSinceReported;
+    if( oState.nTicksSinceReported < m_nHeartbeatTicks && IsWithinDeadband( dValue, oState.dReported ) )
+    {
+        oMetric.SetUnchanged( true );
+        return;
+    }
+
+    oState.dReported           = dValue;
+    oState.nTicksSinceReported = 0;
+}
+
+void CDeadbandFilter::ApplyAssigned( MetricDataList& lstMetrics )
+{
+    for( MetricDataSPtr const& pMetric : lstMetrics )
+        if( pMetric->GetDeadband() )
+            pMetric->GetDeadband()->Apply( *pMetric );
+}
+
+bool CDeadbandFilter::IsWithinDeadband( double dValue, double dReported ) const
+{
+    double dDelta = std::fabs( dValue - dReported );
+    if( dDelta == 0 )
+        return true;
+    if( m_dAbsolute == 0 && m_dPercent == 0 )
+        return false;
+
+    return (m_dAbsolute == 0 || dDelta <= m_dAbsolute)
+        && (m_dPercent  == 0 || dDelta <= std::fabs( dReported ) * m_dPercent / 100);
+}
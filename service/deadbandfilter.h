@@ -0,0 +1,69 @@
+#ifndef DEADBANDFILTER_H
+#define DEADBANDFILTER_H
+
+//
+//  Includes
+//
+#include "metricdata.h"
+
+#include <QHash>
+#include <QString>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CDeadbandFilter
+///
+/// Change-only reporting. A point is marked as unchanged when its value stays
+/// within the deadband of the last reported value, CEngine does not send such
+/// points. Every series is reported at least once per heartbeat, so the backend
+/// can tell an unchanged series from a missing one.
+///
+/// The value is within the deadband if it differs from the last reported one by
+/// no more than each configured band (absolute and percent of the last value).
+/// Without bands only equal values are suppressed.
+///
+class CDeadbandFilter
+{
+public:
+    CDeadbandFilter();
+
+public:
+    //
+    //	Main Interface
+    //
+    // nHeartbeatTicks: a series is reported at least every N ticks
+    void SetSettings( bool bEnabled, double dAbsolute, double dPercent, int nHeartbeatTicks );
+    bool IsEnabled() const;
+
+    // Marks unchanged points of lstMetrics starting from nFrom
+    void Apply( MetricDataList& lstMetrics, int nFrom = 0 );
+    void Apply( CMetricData& oMetric );
+
+    // Marks unchanged points with the filter each point carries, see CMetricData::SetDeadband
+    static void ApplyAssigned( MetricDataList& lstMetrics );
+
+private:
+    struct SState
+    {
+        double dReported;
+        int    nTicksSinceReported;
+    };
+
+    bool IsWithinDeadband( double dValue, double dReported ) const;
+
+private:
+    //
+    //	Content
+    //
+    bool   m_bEnabled;
+    double m_dAbsolute;
+    double m_dPercent;
+    int    m_nHeartbeatTicks;
+
+    QHash<QString, int> m_mapSeries;        // series key to state index
+    std::vector<SState> m_aStates;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // DEADBANDFILTER_H
@@ -0,0 +1,382 @@
+#include "derivedmetrics.h"
+#include "commonexceptions.h"
+#include "logger.h"
+#include "tickclock.h"
+
+#include <cmath>
+
+CDerivedMetricsEvaluator::CDerivedMetricsEvaluator()
+{
+    // replaces the checker which read both disk counters a second time
+    AddDefinition( "disk_total_bytes", "disk_free_bytes*100/(100-disk_busy_space)", EMetricDataType::Counter );
+}
+
+void CDerivedMetricsEvaluator::Load( CConfigSection const& oSection )
+{
+    for( auto it = oSection.begin(); it != oSection.end(); ++it )
+    {
+        // QSettings splits comma separated values into a list
+        QStringList lstParts = it.value().toStringList();
+        if( lstParts.isEmpty() )
+            continue;
+
+        try
+        {
+            EMetricDataType eDataType = lstParts.size() > 1? GetMetricDataTypeFromString( lstParts.at(1).trimmed() )
+                                                           : EMetricDataType::None;
+            QString sMetricType = lstParts.size() > 2? lstParts.at(2).trimmed() : QString("SYSTEM");
+            AddDefinition( it.key().trimmed(), lstParts.at(0).trimmed(), eDataType, sMetricType );
+        }
+        catch( std::exception const& oExc )
+        {
+            LOG_ERROR( std::string("Derived metric skipped: ") + oExc.what() );
+        }
+    }
+}
+
+void CDerivedMetricsEvaluator::AddDefinition( QString const& sName,
+                                              QString const& sExpression,
+                                              EMetricDataType eDataType,
+                                              QString const& sMetricType )
+{
+    if( sName.isEmpty() )
+        throw CDerivedMetricException( "name is empty" );
+
+    SDefinition oDefinition;
+    oDefinition.sName           = sName;
+    oDefinition.sExpression     = sExpression;
+    oDefinition.eDataType       = eDataType;
+    oDefinition.sMetricType     = sMetricType.isEmpty()? QString("SYSTEM") : sMetricType;
+    oDefinition.nBoundReference = -1;
+    Compile( oDefinition );
+
+    for( int i = 0; i < m_aDefinitions.size(); ++i )
+    {
+        if( m_aDefinitions[i].sName == sName )
+        {
+            m_aDefinitions.remove( i );
+            break;
+        }
+    }
+    m_aDefinitions.append( oDefinition );
+
+    SortDefinitions();
+}
+
+bool CDerivedMetricsEvaluator::IsEmpty() const
+{
+    return m_aDefinitions.isEmpty();
+}
+
+void CDerivedMetricsEvaluator::Compile( SDefinition& oDefinition )
+{
+    QString const& sExpr = oDefinition.sExpression;
+    auto fnError = [&sExpr]( QString const& sReason, int nPos )
+    {
+        return CDerivedMetricException( QString("%1 at %2: %3").arg( sReason ).arg( nPos ).arg( sExpr ) );
+    };
+
+    // shunting-yard, operators wait on the stack until an operator of lower precedence comes
+    auto fnPrecedence = []( EOperation eOperation )
+    {
+        switch( eOperation )
+        {
+        case EOperation::Negate:   return 3;
+        case EOperation::Multiply:
+        case EOperation::Divide:   return 2;
+        default:                   return 1;
+        }
+    };
+
+    QVector<SToken> aProgram;
+    QVector<int>    aOperators;    // EOperation or -1 for '('
+    bool bOperandExpected = true;
+    int  nPos = 0;
+
+    while( nPos < sExpr.size() )
+    {
+        QChar ch = sExpr.at( nPos );
+        if( ch.isSpace() )
+        {
+            ++nPos;
+            continue;
+        }
+
+        if( ch.isDigit() || ch == '.' )
+        {
+            if( !bOperandExpected )
+                throw fnError( "Unexpected number", nPos );
+
+            int nStart = nPos;
+            while( nPos < sExpr.size() && (sExpr.at(nPos).isDigit() || sExpr.at(nPos) == '.') )
+                ++nPos;
+            if( nPos < sExpr.size() && (sExpr.at(nPos) == 'e' || sExpr.at(nPos) == 'E') )
+            {
+                ++nPos;
+                if( nPos < sExpr.size() && (sExpr.at(nPos) == '+' || sExpr.at(nPos) == '-') )
+                    ++nPos;
+                while( nPos < sExpr.size() && sExpr.at(nPos).isDigit() )
+                    ++nPos;
+            }
+
+            bool bOK = false;
+            double dValue = sExpr.mid( nStart, nPos - nStart ).toDouble( &bOK );
+            if( !bOK )
+                throw fnError( "Invalid number", nStart );
+
+            aProgram.append( SToken{ EOperation::Number, dValue, -1 } );
+            bOperandExpected = false;
+        }
+        else if( ch.isLetter() || ch == '_' )
+        {
+            if( !bOperandExpected )
+                throw fnError( "Unexpected name", nPos );
+
+            int nStart = nPos;
+            while( nPos < sExpr.size() && (sExpr.at(nPos).isLetterOrNumber() || sExpr.at(nPos) == '_' || sExpr.at(nPos) == '.') )
+                ++nPos;
+
+            SReference oReference;
+            oReference.sMetricName    = sExpr.mid( nStart, nPos - nStart );
+            oReference.bFixedInstance = false;
+            if( nPos < sExpr.size() && sExpr.at(nPos) == '{' )
+            {
+                int nClose = sExpr.indexOf( '}', nPos );
+                if( nClose < 0 )
+                    throw fnError( "Missing '}'", nPos );
+                oReference.sInstanceName  = sExpr.mid( nPos + 1, nClose - nPos - 1 ).trimmed();
+                oReference.bFixedInstance = true;
+                nPos = nClose + 1;
+            }
+
+            if( !oReference.bFixedInstance && oDefinition.nBoundReference < 0 )
+                oDefinition.nBoundReference = oDefinition.aReferences.size();
+            oDefinition.aReferences.append( oReference );
+
+            aProgram.append( SToken{ EOperation::Reference, 0, oDefinition.aReferences.size() - 1 } );
+            bOperandExpected = false;
+        }
+        else if( ch == '(' )
+        {
+            if( !bOperandExpected )
+                throw fnError( "Unexpected '('", nPos );
+            aOperators.append( -1 );
+            ++nPos;
+        }
+        else if( ch == ')' )
+        {
+            if( bOperandExpected )
+                throw fnError( "Unexpected ')'", nPos );
+            while( !aOperators.isEmpty() && aOperators.last() != -1 )
+            {
+                aProgram.append( SToken{ static_cast<EOperation>( aOperators.last() ), 0, -1 } );
+                aOperators.removeLast();
+            }
+            if( aOperators.isEmpty() )
+                throw fnError( "Unbalanced ')'", nPos );
+            aOperators.removeLast();
+            ++nPos;
+        }
+        else if( ch == '+' || ch == '-' || ch == '*' || ch == '/' )
+        {
+            EOperation eOperation;
+            if( bOperandExpected )
+            {
+                if( ch == '+' )
+                {
+                    // unary plus changes nothing
+                    ++nPos;
+                    continue;
+                }
+                if( ch != '-' )
+                    throw fnError( "Operand expected", nPos );
+                eOperation = EOperation::Negate;
+            }
+            else
+            {
+                eOperation = ch == '+'? EOperation::Add :
+                             ch == '-'? EOperation::Subtract :
+                             ch == '*'? EOperation::Multiply : EOperation::Divide;
+            }
+
+            // unary operators are right associative
+            while( !aOperators.isEmpty() && aOperators.last() != -1 && eOperation != EOperation::Negate
+                   && fnPrecedence( static_cast<EOperation>( aOperators.last() ) ) >= fnPrecedence( eOperation ) )
+            {
+                aProgram.append( SToken{ static_cast<EOperation>( aOperators.last() ), 0, -1 } );
+                aOperators.removeLast();
+            }
+            aOperators.append( static_cast<int>( eOperation ) );
+            bOperandExpected = true;
+            ++nPos;
+        }
+        else
+        {
+            throw fnError( QString("Unexpected '%1'").arg( ch ), nPos );
+        }
+    }
+
+    if( bOperandExpected )
+        throw fnError( "Operand expected", nPos );
+
+    while( !aOperators.isEmpty() )
+    {
+        if( aOperators.last() == -1 )
+            throw fnError( "Unbalanced '('", nPos );
+        aProgram.append( SToken{ static_cast<EOperation>( aOperators.last() ), 0, -1 } );
+        aOperators.removeLast();
+    }
+
+    oDefinition.aProgram = aProgram;
+}
+
+void CDerivedMetricsEvaluator::SortDefinitions()
+{
+    // Kahn's algorithm over references between derived metrics
+    QHash<QString, int> mapIndexes;
+    for( int i = 0; i < m_aDefinitions.size(); ++i )
+        mapIndexes.insert( m_aDefinitions[i].sName, i );
+
+    QVector<int>           aPending( m_aDefinitions.size(), 0 );
+    QVector<QVector<int>>  aDependents( m_aDefinitions.size() );
+    for( int i = 0; i < m_aDefinitions.size(); ++i )
+    {
+        QSet<int> setDependencies;
+        for( SReference const& oReference : m_aDefinitions[i].aReferences )
+        {
+            auto it = mapIndexes.find( oReference.sMetricName );
+            if( it != mapIndexes.end() )
+                setDependencies.insert( it.value() );
+        }
+        for( int nDependency : setDependencies )
+            aDependents[nDependency].append( i );
+        aPending[i] = setDependencies.size();
+    }
+
+    QVector<int> aOrder;
+    for( int i = 0; i < m_aDefinitions.size(); ++i )
+        if( aPending[i] == 0 )
+            aOrder.append( i );
+    for( int nNext = 0; nNext < aOrder.size(); ++nNext )
+        for( int nDependent : aDependents[aOrder[nNext]] )
+            if( --aPending[nDependent] == 0 )
+                aOrder.append( nDependent );
+
+    QVector<SDefinition> aSorted;
+    aSorted.reserve( aOrder.size() );
+    for( int nIndex : aOrder )
+        aSorted.append( m_aDefinitions[nIndex] );
+
+    for( int i = 0; i < m_aDefinitions.size(); ++i )
+        if( aPending[i] > 0 )
+            LOG_ERROR( "Derived metric skipped, circular reference: " + m_aDefinitions[i].sName.toStdString() );
+
+    m_aDefinitions = aSorted;
+
+    m_setReferenced.clear();
+    for( SDefinition const& oDefinition : m_aDefinitions )
+        for( SReference const& oReference : oDefinition.aReferences )
+            m_setReferenced.insert( oReference.sMetricName );
+}
+
+void CDerivedMetricsEvaluator::Evaluate( MetricDataList& lstMetrics )
+{
+    if( m_aDefinitions.isEmpty() )
+        return;
+
+    // collect only values some formula refers to
+    m_mapValues.clear();
+    for( MetricDataSPtr const& pMetric : lstMetrics )
+    {
+        if( !pMetric || !m_setReferenced.contains( pMetric->GetName() ) )
+            continue;
+        m_mapValues[pMetric->GetName()].insert( pMetric->GetInstanceName(),
+                                                SValue{ pMetric->GetValue().toDouble(), pMetric->GetInstanceType() } );
+    }
+
+    QDateTime oTime = CTickClock::Instance().GetTickTime();
+    for( SDefinition const& oDefinition : m_aDefinitions )
+    {
+        bool bReferenced = m_setReferenced.contains( oDefinition.sName );
+
+        auto fnAppend = [&]( QString const& sInstanceType, QString const& sInstanceName, double dValue )
+        {
+            lstMetrics.append( std::make_shared<CMetricData>( oDefinition.sName, dValue, oDefinition.eDataType,
+                                                              oTime, oDefinition.sMetricType, 0,
+                                                              sInstanceType, sInstanceName ) );
+            if( bReferenced )
+                m_mapValues[oDefinition.sName].insert( sInstanceName, SValue{ dValue, sInstanceType } );
+        };
+
+        double dValue = 0;
+        if( oDefinition.nBoundReference < 0 )
+        {
+            if( Execute( oDefinition, QString(), dValue ) )
+                fnAppend( QString(), QString(), dValue );
+            continue;
+        }
+
+        auto itBound = m_mapValues.find( oDefinition.aReferences[oDefinition.nBoundReference].sMetricName );
+        if( itBound == m_mapValues.end() )
+            continue;
+
+        // copy, the map may grow while iterating
+        InstanceValues const mapInstances = itBound.value();
+        for( auto it = mapInstances.begin(); it != mapInstances.end(); ++it )
+        {
+            if( Execute( oDefinition, it.key(), dValue ) )
+                fnAppend( it->sInstanceType, it.key(), dValue );
+        }
+    }
+}
+
+bool CDerivedMetricsEvaluator::Execute( SDefinition const& oDefinition, QString const& sInstanceName, double& dResult )
+{
+    m_aStack.clear();
+    for( SToken const& oToken : oDefinition.aProgram )
+    {
+        switch( oToken.eOperation )
+        {
+        case EOperation::Number:
+            m_aStack.push_back( oToken.dValue );
+            break;
+        case EOperation::Reference:
+            {
+                SReference const& oReference = oDefinition.aReferences[oToken.nReference];
+                auto itMetric = m_mapValues.find( oReference.sMetricName );
+                if( itMetric == m_mapValues.end() )
+                    return false;
+                auto itInstance = itMetric->find( oReference.bFixedInstance? oReference.sInstanceName : sInstanceName );
+                if( itInstance == itMetric->end() )
+                    return false;
+                m_aStack.push_back( itInstance->dValue );
+            }
+            break;
+        case EOperation::Negate:
+            m_aStack.back() = -m_aStack.back();
+            break;
+        default:
+            {
+                double dRight = m_aStack.back();
+                m_aStack.pop_back();
+                double& dLeft = m_aStack.back();
+                switch( oToken.eOperation )
+                {
+                case EOperation::Add:      dLeft += dRight; break;
+                case EOperation::Subtract: dLeft -= dRight; break;
+                case EOperation::Multiply: dLeft *= dRight; break;
+                default:
+                    if( dRight == 0 )
+                        return false;
+                    dLeft /= dRight;
+                    break;
+                }
+            }
+            break;
+        }
+    }
+
+    Q_ASSERT( m_aStack.size() == 1 );
+    dResult = m_aStack.back();
+    return std::isfinite( dResult );
+}
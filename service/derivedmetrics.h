@@ -0,0 +1,111 @@
+#ifndef DERIVEDMETRICS_H
+#define DERIVEDMETRICS_H
+
+//
+//  Includes
+//
+#include "metricdata.h"
+#include "configuration.h"
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QVector>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CDerivedMetricsEvaluator
+///
+/// Calculates metrics from the values already collected in the current tick, e.g.
+///
+///     disk_total_bytes = disk_free_bytes*100/(100-disk_busy_space), Counter
+///
+/// Formulas support + - * / unary minus, parentheses, numbers and references to
+/// other metrics. A plain reference binds to the instance being calculated, so the
+/// formula above gives a value per drive; "metric{instance}" binds to a fixed
+/// instance. Derived metrics may reference each other, they are evaluated once per
+/// tick in dependency order. Formulas are compiled to postfix form on load.
+///
+class CDerivedMetricsEvaluator
+{
+public:
+    CDerivedMetricsEvaluator();
+
+public:
+    //
+    //	Main Interface
+    //
+    // Value format: "expression[, data_type[, metric_type]]". Invalid entries are
+    // logged and skipped. Entries with existing names replace them
+    void Load( CConfigSection const& oSection );
+    void AddDefinition( QString const& sName,
+                        QString const& sExpression,
+                        EMetricDataType eDataType = EMetricDataType::None,
+                        QString const& sMetricType = "SYSTEM" );
+    bool IsEmpty() const;
+
+    // Appends derived metrics to the list
+    void Evaluate( MetricDataList& lstMetrics );
+
+private:
+    enum class EOperation
+    {
+        Number,
+        Reference,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Negate
+    };
+
+    struct SToken
+    {
+        EOperation eOperation;
+        double     dValue;          // Number
+        int        nReference;      // Reference, index in SDefinition::aReferences
+    };
+
+    struct SReference
+    {
+        QString sMetricName;
+        QString sInstanceName;
+        bool    bFixedInstance;
+    };
+
+    struct SDefinition
+    {
+        QString              sName;
+        QString              sExpression;
+        EMetricDataType      eDataType;
+        QString              sMetricType;
+        QVector<SToken>      aProgram;
+        QVector<SReference>  aReferences;
+        int                  nBoundReference;   // first reference without fixed instance, -1 if none
+    };
+
+    struct SValue
+    {
+        double  dValue;
+        QString sInstanceType;
+    };
+    // instance name to value
+    using InstanceValues = QHash<QString, SValue>;
+
+    static void Compile( SDefinition& oDefinition );
+    void        SortDefinitions();
+    bool        Execute( SDefinition const& oDefinition, QString const& sInstanceName, double& dResult );
+
+private:
+    //
+    //	Content
+    //
+    QVector<SDefinition>           m_aDefinitions;     // in evaluation order
+    QSet<QString>                  m_setReferenced;
+    QHash<QString, InstanceValues> m_mapValues;         // values of the current tick
+    std::vector<double>            m_aStack;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // DERIVEDMETRICS_H
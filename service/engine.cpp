@@ -1,18 +1,25 @@
 #include "engine.h"
 #include "commonexceptions.h"
 #include "upload/sendcontroller.h"
+#include "thresholdevaluator.h"
+#include "tickclock.h"
 
 #include <QDebug>
 #include <QElapsedTimer>
+#include <algorithm>
 #include <iostream>
 
 CEngine::CEngine(QObject *pParent)
     : Base(pParent),
       m_pTimer( nullptr ),
-      m_nLastMetricsCount(0)
+      m_pDerivedDeadband( std::make_shared<CDeadbandFilter>() ),
+      m_nLastMetricsCount(0),
+      m_nDetailsMsecs(0)
 {
     // setup windows performance data provider
     m_pDataProvider = std::make_shared<CWinPerformanceDataProvider>();
+    // setup bulk data collector for objects with many instances
+    m_pBulkCollector = std::make_shared<CBulkPerfDataCollector>( std::make_shared<CRegistryPerfDataBlockSource>() );
 
     // setup timer
     m_pTimer = new QTimer(this);
@@ -34,6 +41,7 @@ void CEngine::Start()
     LOG_INFO( sSep );
 
     m_pDataProvider->UpdateCounters();
+    UpdateBulkPerfData();
     onTimerTik();
     m_pTimer->start();
     // async start
@@ -57,6 +65,7 @@ void CEngine::AddChecker(IMetricsCategoryCheckerSPtr pChecker)
         {
             // give data provider
             pChecker->SetPerformanceDataProvider( m_pDataProvider );
+            pChecker->SetBulkPerfDataCollector( m_pBulkCollector );
             // Initialize
             pChecker->Initialize();
             m_setCheckers.insert(pChecker);
@@ -102,6 +111,13 @@ int CEngine::GetLastMetricsCount() const
     return m_nLastMetricsCount;
 }
 
+void CEngine::RequestInstanceDetails(int nSeconds)
+{
+    m_nDetailsMsecs = qint64( std::max( nSeconds, 0 ) ) * 1000;
+    m_oDetailsTimer.start();
+    LOG_INFO( QString( "Instance details requested for %1 sec" ).arg( nSeconds ) );
+}
+
 bool CEngine::IsStarted()
 {
     if(m_pTimer && m_pTimer->isActive() )
@@ -109,6 +125,20 @@ bool CEngine::IsStarted()
     return false;
 }
 
+CDerivedMetricsEvaluator &CEngine::DerivedMetrics()
+{
+    return m_oDerivedMetrics;
+}
+
+CMetricsAggregator &CEngine::MetricsAggregator()
+{
+    return m_oAggregator;
+}
+
+CDeadbandFilter &CEngine::DerivedDeadband()
+{
+    return *m_pDerivedDeadband;
+}
 
 void CEngine::SetUpdateInterval(int nMsecs)
 {
@@ -129,6 +159,23 @@ void CEngine::onTimerTik()
     qDebug() << " ";
 }
 
+void CEngine::UpdateBulkPerfData()
+{
+    Q_ASSERT(m_pBulkCollector);
+    if( !m_pBulkCollector->HasRegisteredObjects() )
+        return;
+
+    try
+    {
+        m_pBulkCollector->Update();
+    }
+    catch( std::exception const& oExc )
+    {
+        // checkers using bulk data report nothing this time
+        LOG_ERROR( std::string("Failed to read performance data block: ") + oExc.what() );
+    }
+}
+
 void CEngine::CollectMetrics()
 {
     if( m_setCheckers.empty() )
@@ -143,6 +190,9 @@ void CEngine::CollectMetrics()
     // Update Win Performance conters values
     Q_ASSERT(m_pDataProvider);
     m_pDataProvider->UpdateCounters();
+    UpdateBulkPerfData();
+    // all points of this tick get the time of the sample
+    CTickClock::Instance().BeginTick();
 
     MetricDataList lstAllCollectedMetrics;
     for( IMetricsCategoryCheckerSPtr const& pChecker : m_setCheckers )
@@ -155,6 +205,55 @@ void CEngine::CollectMetrics()
         lstAllCollectedMetrics.append( lstCurrentMetricList );
     }
 
+    // formulas over the values collected above
+    int nCollectedCount = lstAllCollectedMetrics.size();
+    m_oDerivedMetrics.Evaluate( lstAllCollectedMetrics );
+    if( m_pDerivedDeadband->IsEnabled() )
+        for( int i = nCollectedCount; i < lstAllCollectedMetrics.size(); ++i )
+            lstAllCollectedMetrics[i]->SetDeadband( m_pDerivedDeadband );
+    // change-only with the settings of each section, over the samples or, with
+    // aggregation, over the window points, so heartbeats count windows
+    bool bAggregated = m_oAggregator.IsEnabled();
+    if( !bAggregated )
+        CDeadbandFilter::ApplyAssigned( lstAllCollectedMetrics );
+    // high/severe states of all series in one pass
+    CThresholdEvaluator::Instance().Evaluate( lstAllCollectedMetrics );
+
+    // instance series covered by roll-ups are sent on request or with their alerts,
+    // values within the deadband are sent with alerts only
+    bool bDetailsRequested = m_oDetailsTimer.isValid() && m_oDetailsTimer.elapsed() < m_nDetailsMsecs;
+    auto itSkipped = std::remove_if( lstAllCollectedMetrics.begin(), lstAllCollectedMetrics.end(),
+                                     [bDetailsRequested]( MetricDataSPtr const& pMetric )
+                                     {
+                                         bool bSkip = pMetric->IsUnchanged() || (pMetric->IsRollupDetail() && !bDetailsRequested);
+                                         return bSkip && !pMetric->HasSeverityDescriptor();
+                                     } );
+    lstAllCollectedMetrics.erase( itSkipped, lstAllCollectedMetrics.end() );
+
+    // samples are sent as aggregated points once per window
+    if( bAggregated )
+    {
+        MetricDataList lstAlerts = m_oAggregator.AddSamples( lstAllCollectedMetrics );
+        if( !m_oAggregator.IsWindowComplete() )
+        {
+            // state changes are not held back until the end of the window
+            if( !lstAlerts.isEmpty() )
+                emit sigMetricsCollected( lstAlerts );
+            if( m_nLastMetricsCount == 0 )
+                m_nLastMetricsCount = lstAllCollectedMetrics.size();
+            return;
+        }
+        lstAllCollectedMetrics = m_oAggregator.Flush();
+
+        CDeadbandFilter::ApplyAssigned( lstAllCollectedMetrics );
+        itSkipped = std::remove_if( lstAllCollectedMetrics.begin(), lstAllCollectedMetrics.end(),
+                                    []( MetricDataSPtr const& pMetric )
+                                    {
+                                        return pMetric->IsUnchanged() && !pMetric->HasSeverityDescriptor();
+                                    } );
+        lstAllCollectedMetrics.erase( itSkipped, lstAllCollectedMetrics.end() );
+    }
+
     qint64 nElapsedOnDataCollection =  oTimer.elapsed();
     LOG_INFO( QString( "Metrics collected. Count: %1, Duration: %2 msec").arg(lstAllCollectedMetrics.size()).arg( nElapsedOnDataCollection) );
 
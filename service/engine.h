@@ -4,9 +4,14 @@
 #include "imetricscategorychecker.h"
 #include "message.h"
 #include "winperformancedataprovider.h"
+#include "bulkperfdatacollector.h"
+#include "derivedmetrics.h"
+#include "metricsaggregator.h"
+#include "deadbandfilter.h"
 // Qt
 #include <QObject>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <set>
 
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -35,9 +40,15 @@ public slots:
     void RemoveAllCheckers();
 
     int  GetLastMetricsCount()  const;
+    // Sends instance series summarized by roll-ups for the given period
+    void RequestInstanceDetails( int nSeconds );
 
 public:
     bool IsStarted();
+    CDerivedMetricsEvaluator& DerivedMetrics();
+    CMetricsAggregator&       MetricsAggregator();
+    // change-only reporting of derived metrics
+    CDeadbandFilter&          DerivedDeadband();
 
 signals:
     void sigMetricsCollected( MetricDataList const& lstAllMetrics );
@@ -48,13 +59,20 @@ private slots:
 
 private:
     void CollectMetrics();
+    void UpdateBulkPerfData();
 
 private:
     // Content
     QTimer*                                m_pTimer;
     std::set<IMetricsCategoryCheckerSPtr>  m_setCheckers;
     WinPerformanceDataProviderSPtr         m_pDataProvider;
+    BulkPerfDataCollectorSPtr              m_pBulkCollector;
+    CDerivedMetricsEvaluator               m_oDerivedMetrics;
+    CMetricsAggregator                     m_oAggregator;
+    DeadbandFilterSPtr                     m_pDerivedDeadband;
     int                                    m_nLastMetricsCount;
+    QElapsedTimer                          m_oDetailsTimer;
+    qint64                                 m_nDetailsMsecs;
 };
 ////////////////////////////////////////////////////////////////////////////////////////
 
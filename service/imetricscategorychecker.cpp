@@ -15,6 +15,11 @@ void IMetricsCategoryChecker::SetPerformanceDataProvider(WinPerformanceDataProvi
     m_pDataProvider = pDataProvider;
 }
 
+void IMetricsCategoryChecker::SetBulkPerfDataCollector(BulkPerfDataCollectorSPtr pCollector)
+{
+    m_pBulkCollector = pCollector;
+}
+
 void IMetricsCategoryChecker::Initialize()
 {
     // nothing to do
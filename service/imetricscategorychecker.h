@@ -5,6 +5,7 @@
 #include "metricdata.h"
 #include "configurationmanager.h"
 #include "winperformancedataprovider.h"
+#include "bulkperfdatacollector.h"
 #include "macros.h"
 #include "logger.h"
 
@@ -29,6 +30,7 @@ public:
 
     virtual void SetConfigSection( CConfigSection const& oConfig );
             void SetPerformanceDataProvider( WinPerformanceDataProviderSPtr pDataProvider );
+            void SetBulkPerfDataCollector( BulkPerfDataCollectorSPtr pCollector );
 
 protected:
     // accessors
@@ -38,10 +40,13 @@ protected:
     inline WinPerformanceDataProviderSPtr  PerfDataProvider();
     inline WinPerformanceDataProviderConstSPtr PerfDataProvider() const;
 
+    inline BulkPerfDataCollectorSPtr BulkPerfDataCollector() const;
+
 private:
     // Content
     CConfigSection m_oConfigSection;
     WinPerformanceDataProviderSPtr m_pDataProvider;
+    BulkPerfDataCollectorSPtr      m_pBulkCollector;
 };
 using IMetricsCategoryCheckerSPtr = std::shared_ptr<IMetricsCategoryChecker>;
 ////////////////////////////////////////////////////////////////////////////////////////
@@ -54,6 +59,8 @@ const CConfigSection &IMetricsCategoryChecker::ConfigSection()const { return m_o
 
 WinPerformanceDataProviderSPtr      IMetricsCategoryChecker::PerfDataProvider()       { return m_pDataProvider; }
 WinPerformanceDataProviderConstSPtr IMetricsCategoryChecker::PerfDataProvider() const { return m_pDataProvider; }
+
+BulkPerfDataCollectorSPtr IMetricsCategoryChecker::BulkPerfDataCollector() const { return m_pBulkCollector; }
 ////////////////////////////////////////////////////////////////////////////////////////
 
 #endif // IMETRICSCATEGORYCHECKER_H
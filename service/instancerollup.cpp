@@ -0,0 +1,211 @@
+#include "instancerollup.h"
+#include "commonexceptions.h"
+
+#include <cmath>
+#include <limits>
+
+namespace
+{
+// independent accumulators, the compiler keeps them in one vector register
+const int c_nLanes = 4;
+}
+
+CInstanceRollup::CInstanceRollup()
+    : m_nRollups( 0 ),
+      m_dAbove( std::numeric_limits<double>::quiet_NaN() ),
+      m_eDetails( EDetails::OnAlert )
+{
+}
+
+void CInstanceRollup::Configure( CConfigSection oConfig )
+{
+    QStringList lstRollups = oConfig.Value<QStringList>( "rollup", QStringList() );
+    int nRollups = 0;
+    for( QString sName : lstRollups )
+    {
+        sName = sName.trimmed().toLower();
+        if( sName == "min" )
+            nRollups |= Min;
+        else if( sName == "max" )
+            nRollups |= Max;
+        else if( sName == "mean" )
+            nRollups |= Mean;
+        else if( sName == "stddev" )
+            nRollups |= StdDev;
+        else if( sName == "above" )
+            nRollups |= Above;
+        else if( !sName.isEmpty() )
+            throw CInvalidConfigValueException( "rollup = " + lstRollups.join(", ") );
+    }
+    m_nRollups = nRollups;
+
+    m_dAbove = oConfig.Value<double>( "rollup_above", std::numeric_limits<double>::quiet_NaN() );
+
+    QString sDetails = oConfig.Value<QString>( "rollup_details", "on_alert" ).trimmed().toLower();
+    if( sDetails == "on_alert" )
+        m_eDetails = EDetails::OnAlert;
+    else if( sDetails == "always" )
+        m_eDetails = EDetails::Always;
+    else if( sDetails == "never" )
+        m_eDetails = EDetails::Never;
+    else
+        throw CInvalidConfigValueException( "rollup_details = " + sDetails );
+
+    m_mapGroups.clear();
+    m_aGroups.clear();
+}
+
+bool CInstanceRollup::IsEnabled() const
+{
+    return m_nRollups != 0;
+}
+
+void CInstanceRollup::Apply( MetricDataList& lstMetrics )
+{
+    if( !IsEnabled() )
+        return;
+
+    for( SGroup& oGroup : m_aGroups )
+    {
+        oGroup.pFirst = nullptr;
+        oGroup.aValues.clear();
+        oGroup.lstInstances.clear();
+    }
+
+    // gather values of each metric into contiguous arrays
+    for( MetricDataSPtr const& pMetric : lstMetrics )
+    {
+        Q_ASSERT(pMetric);
+        QString sInstanceName = pMetric->GetInstanceName();
+        if( sInstanceName.isEmpty() || sInstanceName.compare( "_Total", Qt::CaseInsensitive ) == 0 )
+            continue;
+
+        bool bNumeric = false;
+        double dValue = pMetric->GetValue().toDouble( &bNumeric );
+        if( !bNumeric )
+            continue;
+
+        auto it = m_mapGroups.find( pMetric->GetName() );
+        if( it == m_mapGroups.end() )
+        {
+            it = m_mapGroups.insert( pMetric->GetName(), int(m_aGroups.size()) );
+            m_aGroups.push_back( SGroup() );
+            m_aGroups.back().sMetricName = pMetric->GetName();
+        }
+
+        SGroup& oGroup = m_aGroups[it.value()];
+        if( !oGroup.pFirst )
+            oGroup.pFirst = pMetric;
+        oGroup.aValues.push_back( dValue );
+        oGroup.lstInstances.append( pMetric );
+    }
+
+    for( SGroup const& oGroup : m_aGroups )
+    {
+        if( oGroup.aValues.empty() )
+            continue;
+
+        SStats oStats = Compute( oGroup.aValues.data(), oGroup.aValues.size(), m_dAbove );
+
+        bool bSendDetails = m_eDetails == EDetails::Always
+                         || (m_eDetails == EDetails::OnAlert && oStats.nAbove > 0);
+        if( !bSendDetails )
+            for( MetricDataSPtr const& pInstance : oGroup.lstInstances )
+                pInstance->SetRollupDetail( true );
+
+        EMetricDataType eDataType = oGroup.pFirst->GetDataType();
+        if( m_nRollups & Min )
+            AppendRollup( lstMetrics, oGroup, "_min", oStats.dMin, eDataType );
+        if( m_nRollups & Max )
+            AppendRollup( lstMetrics, oGroup, "_max", oStats.dMax, eDataType );
+        if( m_nRollups & Mean )
+            AppendRollup( lstMetrics, oGroup, "_mean", oStats.dMean, eDataType );
+        if( m_nRollups & StdDev )
+            AppendRollup( lstMetrics, oGroup, "_stddev", oStats.dStdDev, eDataType );
+        if( (m_nRollups & Above) && !std::isnan( m_dAbove ) )
+            AppendRollup( lstMetrics, oGroup, "_above", oStats.nAbove, EMetricDataType::Counter );
+    }
+}
+
+CInstanceRollup::SStats CInstanceRollup::Compute( double const* pValues, size_t nCount, double dAbove )
+{
+    Q_ASSERT( nCount > 0 );
+
+    double aMin[c_nLanes];
+    double aMax[c_nLanes];
+    double aSum[c_nLanes];
+    int    aAbove[c_nLanes];
+    for( int k = 0; k < c_nLanes; ++k )
+    {
+        aMin[k]   = pValues[0];
+        aMax[k]   = pValues[0];
+        aSum[k]   = 0;
+        aAbove[k] = 0;
+    }
+
+    // branch free body, NaN threshold never counts
+    size_t i = 0;
+    for( ; i + c_nLanes <= nCount; i += c_nLanes )
+    {
+        for( int k = 0; k < c_nLanes; ++k )
+        {
+            double dValue = pValues[i + k];
+            aMin[k]    = dValue < aMin[k]? dValue : aMin[k];
+            aMax[k]    = dValue > aMax[k]? dValue : aMax[k];
+            aSum[k]   += dValue;
+            aAbove[k] += dValue > dAbove;
+        }
+    }
+    for( ; i < nCount; ++i )
+    {
+        double dValue = pValues[i];
+        aMin[0]    = dValue < aMin[0]? dValue : aMin[0];
+        aMax[0]    = dValue > aMax[0]? dValue : aMax[0];
+        aSum[0]   += dValue;
+        aAbove[0] += dValue > dAbove;
+    }
+
+    SStats oStats{ aMin[0], aMax[0], 0, 0, 0 };
+    double dSum = 0;
+    for( int k = 0; k < c_nLanes; ++k )
+    {
+        oStats.dMin    = aMin[k] < oStats.dMin? aMin[k] : oStats.dMin;
+        oStats.dMax    = aMax[k] > oStats.dMax? aMax[k] : oStats.dMax;
+        oStats.nAbove += aAbove[k];
+        dSum          += aSum[k];
+    }
+    oStats.dMean = dSum / double(nCount);
+
+    // second pass over deviations is stable for large values with small spread
+    double aSquares[c_nLanes] = { 0, 0, 0, 0 };
+    for( i = 0; i + c_nLanes <= nCount; i += c_nLanes )
+    {
+        for( int k = 0; k < c_nLanes; ++k )
+        {
+            double dDelta = pValues[i + k] - oStats.dMean;
+            aSquares[k] += dDelta * dDelta;
+        }
+    }
+    for( ; i < nCount; ++i )
+    {
+        double dDelta = pValues[i] - oStats.dMean;
+        aSquares[0] += dDelta * dDelta;
+    }
+    oStats.dStdDev = std::sqrt( (aSquares[0] + aSquares[1] + aSquares[2] + aSquares[3]) / double(nCount) );
+
+    return oStats;
+}
+
+void CInstanceRollup::AppendRollup( MetricDataList& lstMetrics, SGroup const& oGroup, QString const& sSuffix,
+                                    double dValue, EMetricDataType eDataType ) const
+{
+    CMetricData const& oFirst = *oGroup.pFirst;
+    // e.g. cpu_load_core_max, the series has no instance tag
+    QString sName = oGroup.sMetricName + "_" + oFirst.GetInstanceType().toLower() + sSuffix;
+    lstMetrics.append( std::make_shared<CMetricData>( sName,
+                                                      dValue,
+                                                      eDataType,
+                                                      oFirst.GetTime(),
+                                                      oFirst.GetMetricType(),
+                                                      oFirst.GetReaction() ) );
+}
@@ -0,0 +1,100 @@
+#ifndef INSTANCEROLLUP_H
+#define INSTANCEROLLUP_H
+
+//
+//  Includes
+//
+#include "metricdata.h"
+#include "configuration.h"
+
+#include <QHash>
+#include <QString>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CInstanceRollup
+///
+/// Summarizes per-instance series of a checker (cores, drives, interfaces) into a
+/// few series per metric: <metric>_<instance type>_min, _max, _mean, _stddev and
+/// _above (count of instances above rollup_above). _Total is not part of the
+/// group and is sent as before.
+///
+/// Instance series are marked as roll-up details, CEngine sends them only on
+/// demand, with their alerts, or for groups having instances above the threshold.
+///
+/// Configured from the checker section:
+///     rollup         = min, max, mean, stddev, above
+///     rollup_above   = 80
+///     rollup_details = on_alert | always | never
+///
+class CInstanceRollup
+{
+public:
+    enum ERollup
+    {
+        Min    = 0x01,
+        Max    = 0x02,
+        Mean   = 0x04,
+        StdDev = 0x08,
+        Above  = 0x10
+    };
+
+    enum class EDetails
+    {
+        Never,
+        OnAlert,
+        Always
+    };
+
+public:
+    CInstanceRollup();
+
+public:
+    //
+    //	Main Interface
+    //
+    // Throws CInvalidConfigValueException
+    void Configure( CConfigSection oConfig );
+    bool IsEnabled() const;
+
+    // Appends roll-up series and marks instance series as details
+    void Apply( MetricDataList& lstMetrics );
+
+private:
+    struct SGroup
+    {
+        QString             sMetricName;
+        MetricDataSPtr      pFirst;
+        std::vector<double> aValues;
+        MetricDataList      lstInstances;
+    };
+
+    struct SStats
+    {
+        double dMin;
+        double dMax;
+        double dMean;
+        double dStdDev;
+        int    nAbove;
+    };
+
+    static SStats Compute( double const* pValues, size_t nCount, double dAbove );
+    void AppendRollup( MetricDataList& lstMetrics, SGroup const& oGroup, QString const& sSuffix,
+                       double dValue, EMetricDataType eDataType ) const;
+
+private:
+    //
+    //	Content
+    //
+    int      m_nRollups;
+    double   m_dAbove;          // NaN if not configured
+    EDetails m_eDetails;
+
+    // reused between checks to avoid allocations per tick
+    QHash<QString, int> m_mapGroups;
+    std::vector<SGroup> m_aGroups;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // INSTANCEROLLUP_H
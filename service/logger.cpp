@@ -1,11 +1,10 @@
 #include "logger.h"
 
 #include <iostream>
-
-#include <chrono>  // chrono::system_clock
-#include <ctime>   // localtime
-#include <sstream> // stringstream
-#include <iomanip> // put_time
+#include <exception> // set_terminate
+#include <cstdlib>   // abort
+#include <cstdint>   // intptr_t
+#include <array>
 
 #include <configurationmanager.h>
 #include <QDir>
@@ -13,18 +12,142 @@
 #include <QDate>
 #include <QDebug>
 #include <QFile>
-#include <QTextStream>
+#include <QSaveFile>
+#include <QSettings>
+#include <QThread>
+
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+#endif
+
+namespace
+{
+// power of two
+const size_t c_nRingSize = 8192;
+// a crashing or exiting thread waits at most this long for the writer
+const int    c_nFlushLockMsecs = 1000;
+const char   c_szCompressedSuffix[] = ".gz";
+
+quint32 crc32( QByteArray const& aData )
+{
+    static const std::array<quint32, 256> s_aTable = []()
+    {
+        std::array<quint32, 256> aTable;
+        for( quint32 i = 0; i < 256; ++i )
+        {
+            quint32 c = i;
+            for( int k = 0; k < 8; ++k )
+                c = ( c & 1 )? 0xEDB88320u ^ ( c >> 1 ) : c >> 1;
+            aTable[i] = c;
+        }
+        return aTable;
+    }();
+
+    quint32 nCrc = 0xFFFFFFFFu;
+    for( char ch : aData )
+        nCrc = s_aTable[( nCrc ^ quint8(ch) ) & 0xFF] ^ ( nCrc >> 8 );
+    return nCrc ^ 0xFFFFFFFFu;
+}
 
-std::string currentTime()
+void appendLE32( QByteArray& aBuffer, quint32 nValue )
 {
-    auto now = std::chrono::system_clock::now();
-    auto in_time_t = std::chrono::system_clock::to_time_t( now );
-    
-    std::stringstream ss;
-    ss << std::put_time( std::localtime( &in_time_t ), "%Y-%m-%d %X" );
-    return ss.str();
+    for( int i = 0; i < 4; ++i )
+        aBuffer += char( ( nValue >> ( 8 * i ) ) & 0xFF );
 }
 
+// writes sPath.gz and removes sPath
+bool gzipFile( QString const& sPath, QString& sError )
+{
+    QFile oInput( sPath );
+    if( !oInput.open( QIODevice::ReadOnly ) )
+    {
+        sError = oInput.errorString();
+        return false;
+    }
+    QByteArray aData = oInput.readAll();
+    oInput.close();
+
+    // qCompress gives 4 bytes of size and a zlib stream: 2 bytes header, deflate data, 4 bytes adler32
+    QByteArray aDeflate( "\x03\x00", 2 );
+    if( !aData.isEmpty() )
+    {
+        QByteArray aZlib = qCompress( aData );
+        if( aZlib.size() < 10 )
+        {
+            sError = "compression failed";
+            return false;
+        }
+        aDeflate = aZlib.mid( 6, aZlib.size() - 10 );
+    }
+
+    QByteArray aGzip( "\x1f\x8b\x08\x00\x00\x00\x00\x00\x00\xff", 10 );
+    aGzip.reserve( aGzip.size() + aDeflate.size() + 8 );
+    aGzip += aDeflate;
+    appendLE32( aGzip, crc32( aData ) );
+    appendLE32( aGzip, quint32( aData.size() ) );
+
+    QSaveFile oOutput( sPath + c_szCompressedSuffix );
+    if( !oOutput.open( QIODevice::WriteOnly ) || oOutput.write( aGzip ) != aGzip.size() || !oOutput.commit() )
+    {
+        sError = oOutput.errorString();
+        return false;
+    }
+
+    // pruned while it was compressed
+    if( !QFile::remove( sPath ) )
+        QFile::remove( sPath + c_szCompressedSuffix );
+    return true;
+}
+
+std::terminate_handler s_pfnPreviousTerminate = nullptr;
+
+void onTerminate()
+{
+    Logger::getInstance().flush();
+    if( s_pfnPreviousTerminate )
+        s_pfnPreviousTerminate();
+    std::abort();
+}
+
+#ifdef Q_OS_WIN
+LPTOP_LEVEL_EXCEPTION_FILTER s_pfnPreviousFilter = nullptr;
+
+LONG WINAPI onUnhandledException( EXCEPTION_POINTERS* pExceptionInfo )
+{
+    Logger::getInstance().flush();
+    return s_pfnPreviousFilter? s_pfnPreviousFilter( pExceptionInfo ) : EXCEPTION_CONTINUE_SEARCH;
+}
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CLogThread
+///
+/// Runs a loop of the logger: the writer or the compressor
+///
+class CLogThread : public QThread
+{
+public:
+    using Loop = void (Logger::*)();
+
+    CLogThread( Logger* pLogger, Loop pfnLoop )
+        : m_pLogger( pLogger ),
+          m_pfnLoop( pfnLoop )
+    {}
+
+protected:
+    void run() override
+    {
+        ( m_pLogger->*m_pfnLoop )();
+    }
+
+private:
+    Logger* m_pLogger;
+    Loop    m_pfnLoop;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
 Logger& Logger::getInstance()
 {
     static Logger logger;
@@ -33,13 +156,43 @@ Logger& Logger::getInstance()
 
 Logger::~Logger()
 {
-    ConfMgr.GetRegistrySettings().setValue("logs_file_open_datetime", _logs_file_open_datetime);
+    _bStopping = true;
+    _wake_writer();
+    _writer->wait();
+    delete _writer;
+    flush();
+
+    {
+        QMutexLocker oLocker( &_compress_mutex );
+        _compress_condition.wakeAll();
+    }
+    // files left uncompressed are queued again at the next start
+    _compressor->wait();
+    delete _compressor;
 }
 
 Logger::Logger()
-    : _nLogRotateSeconds(3600),
+    : _logs_file_open_msecs(0),
+      _logs_file_size(0),
+      _nLogRotateSeconds(3600),
+      _nLogRotateBytes(0),
       _nBackupFileCount(24),
-      _bDebugLoggingEnabled(false)
+      _bCompressRotated(true),
+      _bDebugLoggingEnabled(false),
+      _ring(new _cell[c_nRingSize]),
+      _ring_mask(c_nRingSize - 1),
+      _enqueue_pos(0),
+      _dequeue_pos(0),
+      _dropped_count(0),
+      _bReady(false),
+      _bBlockOnOverflow(false),
+      _flush_level(int(LogType::Warning)),
+      _writer(nullptr),
+      _bStopping(false),
+      _bFlushRequested(false),
+      _flush_interval_msecs(1000),
+      _time_cache_secs(-1),
+      _compressor(nullptr)
 {
     if(  !ConfMgr.GetRegistrySettings().contains( "logs_file_open_datetime" ) )
     {
@@ -47,6 +200,15 @@ Logger::Logger()
     }
 
     _logs_file_open_datetime = ConfMgr.GetRegistrySettings().value( "logs_file_open_datetime" ).toDateTime();
+
+    for( size_t i = 0; i < c_nRingSize; ++i )
+        _ring[i].sequence.store( i, std::memory_order_relaxed );
+
+    _writer = new CLogThread( this, &Logger::_writer_loop );
+    _writer->start( QThread::LowPriority );
+    _compressor = new CLogThread( this, &Logger::_compressor_loop );
+    _compressor->start( QThread::LowestPriority );
+    _install_crash_handlers();
 }
 
 void Logger::error(const std::string &prefix, std::string msg)
@@ -67,9 +229,16 @@ void Logger::debug(const std::string &prefix, std::string msg)
 
 void Logger::setLogRotateSeconds(qint64 nSeconds)
 {
+    QMutexLocker oLocker( &m_oMutex );
     _nLogRotateSeconds = nSeconds;
 }
 
+void Logger::setLogRotateBytes(qint64 nBytes)
+{
+    QMutexLocker oLocker( &m_oMutex );
+    _nLogRotateBytes = nBytes;
+}
+
 void Logger::warning(const std::string &prefix, std::string msg)
 {
     _log<LogType::Warning>(prefix,   "Warning: " + msg );
@@ -78,12 +247,23 @@ void Logger::warning(const std::string &prefix, std::string msg)
 
 void Logger::setBackupFileCount(int nCount)
 {
+    QMutexLocker oLocker( &m_oMutex );
     _nBackupFileCount = nCount;
+    // the list is there once the folder is set
+    if( _bReady )
+        _prune_backup_files();
+}
+
+void Logger::setCompressRotatedLogs(bool bCompress)
+{
+    QMutexLocker oLocker( &m_oMutex );
+    _bCompressRotated = bCompress;
 }
 
 void Logger::setLogsFolderPath(const QString &sFolderPath)
 {
     Q_ASSERT( !sFolderPath.isEmpty() );
+    QMutexLocker oLocker( &m_oMutex );
     _logs_folder_path = sFolderPath;
 
 
@@ -94,25 +274,46 @@ void Logger::setLogsFolderPath(const QString &sFolderPath)
         logs_dir.mkpath(_logs_folder_path);
     }
 
+    // the only directory listing, rotation keeps the list
     _init_log_file(_logs_file_open_datetime);
-    /*
-    QDateTime current_datetime = QDateTime::currentDateTime();
-    qint64 nActualSecondsLeft = _logs_file_open_datetime.secsTo( current_datetime );
-    if ( nActualSecondsLeft >= _nLogRotateSeconds )
-    {
-        _init_log_file( current_datetime );
-    }
-    else
-    {
+    _scan_backup_files();
+    _prune_backup_files();
+    _bReady = true;
+}
 
-    }*/
+void Logger::SetDebugLoggingEnabled(bool bEnabled)
+{
+    _bDebugLoggingEnabled = bEnabled;
+}
 
+bool Logger::setOverflowPolicy(const QString &sPolicy)
+{
+    if( sPolicy.compare( "drop", Qt::CaseInsensitive ) == 0 )
+        _bBlockOnOverflow = false;
+    else if( sPolicy.compare( "block", Qt::CaseInsensitive ) == 0 )
+        _bBlockOnOverflow = true;
+    else
+        return false;
+    return true;
+}
 
+bool Logger::setFlushLevel(const QString &sLevel)
+{
+    static const char* const s_aLevels[] = { "error", "warning", "info", "debug" };
+    for( int i = 0; i < 4; ++i )
+    {
+        if( sLevel.compare( s_aLevels[i], Qt::CaseInsensitive ) == 0 )
+        {
+            _flush_level = i;
+            return true;
+        }
+    }
+    return false;
 }
 
-void Logger::SetDebugLoggingEnabled(bool bEnabled)
+void Logger::setFlushIntervalMsecs(int nMsecs)
 {
-    _bDebugLoggingEnabled = bEnabled;
+    _flush_interval_msecs = qMax( nMsecs, 10 );
 }
 
 QString Logger::GetLogDirPath() const
@@ -123,29 +324,200 @@ QString Logger::GetLogDirPath() const
     return logs_dir.absolutePath();
 }
 
+void Logger::flush()
+{
+    // the writer may hold the lock forever if it is the crashing thread
+    if( !m_oMutex.tryLock( c_nFlushLockMsecs ) )
+        return;
+    _write_pending();
+    m_oMutex.unlock();
+}
+
 template<Logger::LogType type>
 void Logger::_log(const std::string& prefix, const std::string& msg)
 {
-    if( !_prepare_logs_file() )
+    // not initialized yet
+    if( !_bReady )
+        return;
+
+    std::string text;
+    if( prefix.empty() )
+        text = msg;
+    else
+    {
+        text = prefix;
+        if( text.size() < 70 )
+            text.append( 70 - text.size(), '-' );
+        text += msg;
+    }
+
+    if( !_enqueue( type, std::move( text ) ) )
+        return;
+
+    if( int(type) <= _flush_level )
+        _wake_writer();
+}
+
+bool Logger::_enqueue(LogType type, std::string&& text)
+{
+    qint64 time_msecs = QDateTime::currentMSecsSinceEpoch();
+
+    size_t pos = _enqueue_pos.load( std::memory_order_relaxed );
+    _cell* cell = nullptr;
+    while( true )
+    {
+        cell = &_ring[pos & _ring_mask];
+        size_t sequence = cell->sequence.load( std::memory_order_acquire );
+        intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+        if( diff == 0 )
+        {
+            // the slot is free, claim it
+            if( _enqueue_pos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+                break;
+        }
+        else if( diff < 0 )
+        {
+            // full
+            if( !_bBlockOnOverflow || _bStopping )
+            {
+                ++_dropped_count;
+                return false;
+            }
+            _wake_writer();
+            QThread::yieldCurrentThread();
+            pos = _enqueue_pos.load( std::memory_order_relaxed );
+        }
+        else
+        {
+            pos = _enqueue_pos.load( std::memory_order_relaxed );
+        }
+    }
+
+    cell->record.type       = type;
+    cell->record.time_msecs = time_msecs;
+    cell->record.text       = std::move( text );
+    cell->sequence.store( pos + 1, std::memory_order_release );
+    return true;
+}
+
+bool Logger::_dequeue(_record &record)
+{
+    _cell* cell = &_ring[_dequeue_pos & _ring_mask];
+    if( cell->sequence.load( std::memory_order_acquire ) != _dequeue_pos + 1 )
+        return false;
+
+    record = std::move( cell->record );
+    cell->sequence.store( _dequeue_pos + _ring_mask + 1, std::memory_order_release );
+    ++_dequeue_pos;
+    return true;
+}
+
+void Logger::_wake_writer()
+{
+    // one lock per flush, not per record; the writer checks the flag under the
+    // lock before it waits, so the wake-up is not lost
+    if( _bFlushRequested.exchange( true ) )
         return;
+    QMutexLocker oLocker( &_wake_mutex );
+    _wake_condition.wakeOne();
+}
+
+void Logger::_writer_loop()
+{
+    while( !_bStopping )
+    {
+        _wake_mutex.lock();
+        if( !_bFlushRequested && !_bStopping )
+            _wake_condition.wait( &_wake_mutex, static_cast<unsigned long>( _flush_interval_msecs.load() ) );
+        _bFlushRequested = false;
+        _wake_mutex.unlock();
+
+        QMutexLocker oLocker( &m_oMutex );
+        _write_pending();
+    }
+}
+
+void Logger::_compressor_loop()
+{
+    while( true )
+    {
+        QString sFilePath;
+        {
+            QMutexLocker oLocker( &_compress_mutex );
+            while( _compress_queue.isEmpty() && !_bStopping )
+                _compress_condition.wait( &_compress_mutex );
+            if( _bStopping )
+                return;
+            sFilePath = _compress_queue.takeFirst();
+        }
+
+        QString sError;
+        if( !gzipFile( sFilePath, sError ) )
+            warning( "", "Failed to compress log file " + sFilePath.toStdString() + ": " + sError.toStdString() );
+    }
+}
+
+void Logger::_write_pending()
+{
+    // records are taken also when logging is disabled, the ring must not stay full
+    bool bWrite = _prepare_logs_file( QDateTime::currentMSecsSinceEpoch() ) && _logs_file.isOpen();
+
+    _batch.resize( 0 );
+    // console echo costs a conversion and a write per line, for debugging only
+    bool bEcho = _bDebugLoggingEnabled;
+    auto append_line = [this, bEcho]( qint64 time_msecs, char const* text, size_t size )
+    {
+        // local time text changes once per second
+        qint64 time_secs = time_msecs / 1000;
+        if( time_secs != _time_cache_secs )
+        {
+            _time_cache_secs = time_secs;
+            _time_cache_text = QDateTime::fromMSecsSinceEpoch( time_msecs ).toString( "yyyy-MM-dd HH:mm:ss" ).toLatin1();
+        }
+
+        int line_begin = _batch.size();
+        _batch += '[';
+        _batch += _time_cache_text;
+        _batch += "] ";
+        _batch.append( text, int(size) );
+        if( bEcho )
+            qDebug() << QString::fromUtf8( _batch.constData() + line_begin, _batch.size() - line_begin );
+        _batch += '\n';
+    };
+
+    qint64 dropped_count = _dropped_count.exchange( 0 );
+    if( dropped_count > 0 )
+    {
+        std::string text = "Warning: " + std::to_string( dropped_count ) + " log records dropped, the log queue was full";
+        append_line( QDateTime::currentMSecsSinceEpoch(), text.data(), text.size() );
+    }
 
-    std::string log = "[" + currentTime() + "] ";
-    std::stringstream ss;
-    ss << log << std::left << std::setfill('-')
-       << (prefix.empty()? std::setw( 0 ): std::setw( 70 ) )<< prefix
-       << std::setw( 0 ) << msg << std::endl;
+    _record record;
+    while( _dequeue( record ) )
+    {
+        if( bWrite )
+            append_line( record.time_msecs, record.text.data(), record.text.size() );
+    }
 
-    QMutexLocker oLocker(&m_oMutex);
-    _logs_stream << ss.str().c_str();
-    _logs_stream.flush();
+    if( !bWrite || _batch.isEmpty() )
+        return;
+
+    _logs_file.write( _batch );
+    _logs_file.flush();
+    _logs_file_size += _batch.size();
+}
 
-    log += ( prefix + " = " + msg);
-    qDebug() << QString::fromStdString( log );
+void Logger::_install_crash_handlers()
+{
+    s_pfnPreviousTerminate = std::set_terminate( onTerminate );
+#ifdef Q_OS_WIN
+    s_pfnPreviousFilter = SetUnhandledExceptionFilter( onUnhandledException );
+#endif
 }
 
-bool Logger::_prepare_logs_file()
+bool Logger::_prepare_logs_file( qint64 now_msecs )
 {
-    if( _nLogRotateSeconds <= 0 || _nBackupFileCount <= 0 )
+    if( ( _nLogRotateSeconds <= 0 && _nLogRotateBytes <= 0 ) || _nBackupFileCount <= 0 )
         // logging disabled
         return false;
 
@@ -155,49 +527,104 @@ bool Logger::_prepare_logs_file()
         return false;
     }
 
-    const auto current_datetime = QDateTime::currentDateTime();
-    qint64 nActualSecondsLeft = _logs_file_open_datetime.secsTo( current_datetime );
-
-    if ( nActualSecondsLeft >= _nLogRotateSeconds )
+    if( ( _nLogRotateSeconds > 0 && now_msecs - _logs_file_open_msecs >= _nLogRotateSeconds * 1000 ) ||
+        ( _nLogRotateBytes > 0 && _logs_file_size >= _nLogRotateBytes ) )
     {
-        _init_log_file( current_datetime );
+        _rotate_log_file( now_msecs );
     }
 
     return true;
 }
 
-void Logger::_init_log_file(const QDateTime &oLogFileDateTime)
+void Logger::_init_log_file(const QDateTime &oLogFileDateTime, bool bRotate)
 {
-    QMutexLocker oLocker( &m_oMutex );
+    QString sFilePath = _logs_folder_path + QDir::separator() + oLogFileDateTime.toString("dd-MM-yyyy_HH-mm-ss");
+    QString sUniquePath = sFilePath;
+    // size rotation may start several files within a second, the file of the last
+    // run is appended unless it was rotated already
+    for( int i = 1; ( bRotate && QFile::exists( sUniquePath + ".txt" ) ) || QFile::exists( sUniquePath + ".txt" + c_szCompressedSuffix ); ++i )
+        sUniquePath = sFilePath + "_" + QString::number( i );
 
-    const auto filename = oLogFileDateTime.toString("dd-MM-yyyy_HH-mm-ss") + ".txt";
     if (_logs_file.isOpen())
     {
         _logs_file.close();
     }
 
-    _logs_file.setFileName(_logs_folder_path + QDir::separator() + filename);
+    _logs_file.setFileName(sUniquePath + ".txt");
 
     if (_logs_file.open(QIODevice::Text | QIODevice::WriteOnly | QIODevice::Append))
     {
         _logs_file_open_datetime = oLogFileDateTime;
-        _logs_stream.setDevice(& _logs_file);
+        _logs_file_open_msecs = oLogFileDateTime.toMSecsSinceEpoch();
+        _logs_file_size = _logs_file.size();
+
+        // kept at once, the next run appends to this file also after a crash;
+        // own QSettings object, this runs on the writer thread
+        QSettings& oRegistrySettings = ConfMgr.GetRegistrySettings();
+        QSettings( oRegistrySettings.organizationName(), oRegistrySettings.applicationName() )
+            .setValue( "logs_file_open_datetime", _logs_file_open_datetime );
     }
+}
 
+void Logger::_rotate_log_file( qint64 now_msecs )
+{
+    QString sRotatedPath = _logs_file.fileName();
+    _init_log_file( QDateTime::fromMSecsSinceEpoch( now_msecs ), true );
+    if( sRotatedPath.isEmpty() || sRotatedPath == _logs_file.fileName() )
+        return;
+
+    _backup_files.append( sRotatedPath );
+    if( _bCompressRotated )
+        _queue_compression( sRotatedPath );
+    _prune_backup_files();
+}
+
+void Logger::_scan_backup_files()
+{
+    _backup_files.clear();
 
-    // check backuped file count
     QDir oLogsDir( _logs_folder_path );
-    QFileInfoList lstLogFileInfos = oLogsDir.entryInfoList( QStringList() << "*.txt" );
-    if( lstLogFileInfos.size() > _nBackupFileCount )
+    QFileInfoList lstLogFileInfos = oLogsDir.entryInfoList( QStringList() << "*.txt" << QString( "*.txt" ) + c_szCompressedSuffix,
+                                                            QDir::Files, QDir::Time | QDir::Reversed );
+    QString sCurrentPath = QFileInfo( _logs_file.fileName() ).absoluteFilePath();
+    for( QFileInfo const& oFileInfo : lstLogFileInfos )
     {
-        // remove oldest file
-        QFileInfoList::iterator oIt = std::min_element( lstLogFileInfos.begin(), lstLogFileInfos.end(),
-                                                        [](QFileInfo const& a, QFileInfo const& b ) { return a.created() < b.created(); } );
-        QString sOldestFilePath = (*oIt).absoluteFilePath();
-        QFile oOldestFile( sOldestFilePath );
-        bool bOK = oOldestFile.remove();
-        Q_ASSERT(bOK);
-        Q_UNUSED(bOK);
+        QString sFilePath = oFileInfo.absoluteFilePath();
+        bool bCompressed = sFilePath.endsWith( c_szCompressedSuffix );
+        if( bCompressed )
+            sFilePath.chop( int( sizeof(c_szCompressedSuffix) ) - 1 );
+
+        if( sFilePath == sCurrentPath || _backup_files.contains( sFilePath ) )
+            continue;
+
+        _backup_files.append( sFilePath );
+        // left by an earlier run
+        if( !bCompressed && _bCompressRotated )
+            _queue_compression( sFilePath );
+    }
+}
+
+void Logger::_prune_backup_files()
+{
+    // no backups means logging is disabled, not that the old files go
+    if( _nBackupFileCount <= 0 )
+        return;
 
+    while( _backup_files.size() > _nBackupFileCount )
+    {
+        QString sFilePath = _backup_files.takeFirst();
+        {
+            QMutexLocker oLocker( &_compress_mutex );
+            _compress_queue.removeAll( sFilePath );
+        }
+        QFile::remove( sFilePath );
+        QFile::remove( sFilePath + c_szCompressedSuffix );
     }
 }
+
+void Logger::_queue_compression( QString const& sFilePath )
+{
+    QMutexLocker oLocker( &_compress_mutex );
+    _compress_queue.append( sFilePath );
+    _compress_condition.wakeOne();
+}
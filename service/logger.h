@@ -4,11 +4,31 @@
 #include <string>
 #include <fstream>
 #include <iomanip>
+#include <atomic>
+#include <memory>
 #include <QDate>
 #include <QFile>
 #include <QTextStream>
 #include <QMutex>
+#include <QStringList>
+#include <QWaitCondition>
 
+class CLogThread;
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class Logger
+///
+/// Log calls only put the record into a lock-free ring buffer (multiple producers,
+/// one consumer), the writer thread takes the records in batches and writes and
+/// flushes them every flush interval, or at once for records at the flush level.
+/// When the ring is full records are dropped and counted, or with the block policy
+/// the caller waits for space. The rest is written at exit and on a crash.
+///
+/// The file is rotated by age and/or size, checked against counters once per batch.
+/// Rotated files are gzipped by a background thread and kept in a list, the oldest
+/// ones over the backup count are removed without listing the log directory.
+///
 class Logger
 {
 public:
@@ -19,14 +39,26 @@ public:
     void warning( const std::string &prefix, std::string msg );
     void info( const std::string &prefix, std::string msg );
     void debug( const std::string &prefix, std::string msg );
-    
+
     void setLogRotateSeconds( qint64 nSeconds );
+    void setLogRotateBytes( qint64 nBytes );
     void setBackupFileCount( int nCount );
+    void setCompressRotatedLogs( bool bCompress );
     void setLogsFolderPath( QString const& sFolderPath );
     void SetDebugLoggingEnabled( bool bEnabled );
+    // "drop" or "block", false for unknown policy
+    bool setOverflowPolicy( QString const& sPolicy );
+    // records of this level or more severe are flushed at once: "error", "warning", "info", "debug"
+    bool setFlushLevel( QString const& sLevel );
+    void setFlushIntervalMsecs( int nMsecs );
     QString GetLogDirPath() const;
 
+    // writes the queued records, also called on a crash
+    void flush();
+
 private:
+    friend class CLogThread;
+
     enum class LogType
     {
         Error,
@@ -35,6 +67,20 @@ private:
         Debug
     };
 
+    struct _record
+    {
+        LogType     type;
+        qint64      time_msecs;
+        std::string text;
+    };
+
+    // ring slot, the sequence tells whose turn it is
+    struct _cell
+    {
+        std::atomic<size_t> sequence;
+        _record             record;
+    };
+
     Logger();
     Logger( const Logger& )            = delete; // Copy construct
     Logger( Logger&& )                 = delete; // Move construct
@@ -44,19 +90,65 @@ private:
     template<LogType type>
     void _log(const std::string &prefix, const std::string&msg );
 
-    bool _prepare_logs_file();
-    void _init_log_file( QDateTime const& oLogFileDateTime );
+    bool _enqueue( LogType type, std::string&& text );
+    bool _dequeue( _record& record );
+    void _wake_writer();
+    void _writer_loop();
+    void _compressor_loop();
+    // with m_oMutex held
+    void _write_pending();
+    void _install_crash_handlers();
+
+    bool _prepare_logs_file( qint64 now_msecs );
+    // bRotate: new file name, not used by an earlier file; a compressed file is never reopened
+    void _init_log_file( QDateTime const& oLogFileDateTime, bool bRotate = false );
+    void _rotate_log_file( qint64 now_msecs );
+    void _scan_backup_files();
+    void _prune_backup_files();
+    void _queue_compression( QString const& sFilePath );
 
     // members
     QFile		_logs_file;
-    QTextStream _logs_stream;
     QDateTime   _logs_file_open_datetime;
+    qint64      _logs_file_open_msecs;
+    qint64      _logs_file_size;        // counted, not queried
     qint64      _nLogRotateSeconds;
+    qint64      _nLogRotateBytes;
     int         _nBackupFileCount;
+    bool        _bCompressRotated;
+    QStringList _backup_files;          // rotated files without .gz, oldest first
     QString     _logs_folder_path;
-    bool        _bDebugLoggingEnabled;
-    QMutex      m_oMutex;
+    std::atomic<bool> _bDebugLoggingEnabled;
+    QMutex      m_oMutex;               // file and settings, held by the writer
+
+    // queue
+    std::unique_ptr<_cell[]> _ring;
+    size_t              _ring_mask;
+    std::atomic<size_t> _enqueue_pos;
+    size_t              _dequeue_pos;   // consumer side, under m_oMutex
+    std::atomic<qint64> _dropped_count;
+    std::atomic<bool>   _bReady;        // log folder set
+    std::atomic<bool>   _bBlockOnOverflow;
+    std::atomic<int>    _flush_level;
+
+    // writer
+    CLogThread*         _writer;
+    QMutex              _wake_mutex;
+    QWaitCondition      _wake_condition;
+    std::atomic<bool>   _bStopping;
+    std::atomic<bool>   _bFlushRequested;
+    std::atomic<int>    _flush_interval_msecs;
+    QByteArray          _batch;         // reused write buffer
+    qint64              _time_cache_secs;
+    QByteArray          _time_cache_text;
+
+    // compressor
+    CLogThread*         _compressor;
+    QMutex              _compress_mutex;
+    QWaitCondition      _compress_condition;
+    QStringList         _compress_queue;
 };
+////////////////////////////////////////////////////////////////////////////////////////
 
 #define __FILENAME__ (strrchr(__FILE__, '\\') ? strrchr(__FILE__, '\\') + 1 : __FILE__)
 #define __PREFIX__ std::string( std::string( __FILENAME__ ) + "(" + std::string( __FUNCTION__ ) + ")" )
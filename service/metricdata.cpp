@@ -2,7 +2,10 @@
 
 CMetricData::CMetricData()
     : m_eDataType( EMetricDataType::None ),
-      m_nReaction{0}
+      m_nReaction{0},
+      m_nThresholdSeries( -1 ),
+      m_bRollupDetail( false ),
+      m_bUnchanged( false )
 {}
 
 CMetricData::CMetricData(const QString &sName,
@@ -13,7 +16,10 @@ CMetricData::CMetricData(const QString &sName,
                          int nReaction,
                          QString const& sInstanceType,
                          QString const& sInstanceName )
-    : m_nReaction{0}
+    : m_nReaction{0},
+      m_nThresholdSeries( -1 ),
+      m_bRollupDetail( false ),
+      m_bUnchanged( false )
 {
     SetName( sName );
     SetValue( vtValue );
@@ -22,13 +28,14 @@ CMetricData::CMetricData(const QString &sName,
     SetMetricType( sMetricType );
     SetReaction( nReaction );
     SetInstanceType( sInstanceType );
-    SetInstanceType( sInstanceName );
+    SetInstanceName( sInstanceName );
 }
 
 MetricSeverityDescriptorSPtr CMetricData::SetSeverityDescriptor(const QString &sMetricName, EMetricDataSeverity eSeverity, double dAlertDurationHint, const QString &sMessage)
 {
+    // the alert gets the time of the point
     auto pDescriptor = std::make_shared<CMetricSeverityDescriptor>(sMetricName,
-                                                                   QDateTime::currentDateTime(),
+                                                                   m_oTime.isValid()? m_oTime : QDateTime::currentDateTimeUtc(),
                                                                    eSeverity,
                                                                    dAlertDurationHint,
                                                                    sMessage,
@@ -39,6 +46,14 @@ MetricSeverityDescriptorSPtr CMetricData::SetSeverityDescriptor(const QString &s
     return pDescriptor;
 }
 
+QString CMetricData::GetSeriesKey() const
+{
+    QString sKey = m_sName + QChar('\x1f') + m_sInstanceType + QChar('\x1f') + m_sInstanceName;
+    for( auto const& oTag : m_lstTags )
+        sKey += QChar('\x1f') + oTag.first + QChar('=') + oTag.second;
+    return sKey;
+}
+
 
 QString ToString( EMetricDataType eType )
 {
@@ -2,7 +2,9 @@
 #define CMETRICDATA_H
 
 #include <QDateTime>
+#include <QPair>
 #include <QVariant>
+#include <QVector>
 #include <memory>
 
 
@@ -76,8 +78,14 @@ private:
 };
 
 using MetricSeverityDescriptorSPtr = std::shared_ptr<CMetricSeverityDescriptor>;
+using MetricSeverityDescriptorList = QList<MetricSeverityDescriptorSPtr>;
 ////////////////////////////////////////////////////////////////////////////////////////
 
+using MetricTagList = QVector<QPair<QString, QString>>;
+
+class CDeadbandFilter;
+using DeadbandFilterSPtr = std::shared_ptr<CDeadbandFilter>;
+
 ////////////////////////////////////////////////////////////////////////////////////////
 ///
 /// class CMetricData
@@ -123,6 +131,13 @@ public:
     inline void SetInstanceName(QString const& sInstanceName);
     inline QString GetInstanceName() const;
 
+    // extra tags given by scripts
+    inline void AddTag(QString const& sName, QString const& sValue);
+    inline MetricTagList const& GetTags() const;
+
+    // identity of the series: name, instance and tags
+    QString GetSeriesKey() const;
+
     inline bool HasSeverityDescriptor() const;
     inline void SetSeverityDescriptor( MetricSeverityDescriptorSPtr pDescriptor );
     MetricSeverityDescriptorSPtr SetSeverityDescriptor( QString const& sMetricName,
@@ -133,6 +148,22 @@ public:
 
     inline bool IsNull() const;
 
+    // Index of the series in CThresholdEvaluator, -1 if metric has no thresholds
+    inline void SetThresholdSeries( int nSeries );
+    inline int  GetThresholdSeries() const;
+
+    // Instance series summarized by CInstanceRollup, sent only on demand or with alerts
+    inline void SetRollupDetail( bool bDetail );
+    inline bool IsRollupDetail() const;
+
+    // Value within the deadband of the last reported one, see CDeadbandFilter
+    inline void SetUnchanged( bool bUnchanged );
+    inline bool IsUnchanged() const;
+
+    // Change-only settings of the section which reported the metric, null if not filtered
+    inline void SetDeadband( DeadbandFilterSPtr pDeadband );
+    inline DeadbandFilterSPtr const& GetDeadband() const;
+
 private:
     // Content
     QString         m_sName;
@@ -143,8 +174,13 @@ private:
     int             m_nReaction;
     QString         m_sInstanceType;
     QString         m_sInstanceName;
+    MetricTagList   m_lstTags;
 
     MetricSeverityDescriptorSPtr m_pSeverityDescriptor;
+    int             m_nThresholdSeries;
+    bool            m_bRollupDetail;
+    bool            m_bUnchanged;
+    DeadbandFilterSPtr m_pDeadband;
 };
 using MetricDataSPtr = std::shared_ptr<CMetricData>;
 using MetricDataList = QList<MetricDataSPtr>;
@@ -194,9 +230,19 @@ inline void CMetricData::SetInstanceType(const QString &sType) {  m_sInstanceTyp
 inline QString CMetricData::GetInstanceType() const { return m_sInstanceType; }
 inline void CMetricData::SetInstanceName(const QString &sInstanceName) { m_sInstanceName = sInstanceName; }
 inline QString CMetricData::GetInstanceName() const { return m_sInstanceName; }
+inline void CMetricData::AddTag(const QString &sName, const QString &sValue) { m_lstTags.append( qMakePair( sName, sValue ) ); }
+inline MetricTagList const& CMetricData::GetTags() const { return m_lstTags; }
 inline bool CMetricData::HasSeverityDescriptor() const { return m_pSeverityDescriptor != nullptr; }
 inline void CMetricData::SetSeverityDescriptor(MetricSeverityDescriptorSPtr pDescriptor) { m_pSeverityDescriptor = pDescriptor; }
 inline MetricSeverityDescriptorSPtr CMetricData::GetSeverityDescriptor() const { return m_pSeverityDescriptor; }
 inline bool CMetricData::IsNull() const { return m_sName.isNull(); }
+inline void CMetricData::SetThresholdSeries(int nSeries) { m_nThresholdSeries = nSeries; }
+inline int CMetricData::GetThresholdSeries() const { return m_nThresholdSeries; }
+inline void CMetricData::SetRollupDetail(bool bDetail) { m_bRollupDetail = bDetail; }
+inline bool CMetricData::IsRollupDetail() const { return m_bRollupDetail; }
+inline void CMetricData::SetUnchanged(bool bUnchanged) { m_bUnchanged = bUnchanged; }
+inline bool CMetricData::IsUnchanged() const { return m_bUnchanged; }
+inline void CMetricData::SetDeadband(DeadbandFilterSPtr pDeadband) { m_pDeadband = pDeadband; }
+inline DeadbandFilterSPtr const& CMetricData::GetDeadband() const { return m_pDeadband; }
 
 #endif // CMETRICDATA_H
@@ -0,0 +1,227 @@
+#include "metricsaggregator.h"
+#include "commonexceptions.h"
+
+#include <algorithm>
+
+CMetricsAggregator::CMetricsAggregator()
+    : m_nWindow( 1 ),
+      m_nSamples( 0 ),
+      m_nAggregates( Avg | Min | Max )
+{
+}
+
+void CMetricsAggregator::SetWindow( int nSamplesPerPoint )
+{
+    m_nWindow  = std::max( nSamplesPerPoint, 1 );
+    m_nSamples = 0;
+    m_mapSeries.clear();
+    m_aAccumulators.clear();
+}
+
+int CMetricsAggregator::GetWindow() const
+{
+    return m_nWindow;
+}
+
+bool CMetricsAggregator::IsEnabled() const
+{
+    return m_nWindow > 1;
+}
+
+void CMetricsAggregator::SetAggregates( QStringList const& lstAggregates )
+{
+    int nAggregates = 0;
+    for( QString sName : lstAggregates )
+    {
+        sName = sName.trimmed().toLower();
+        if( sName == "avg" )
+            nAggregates |= Avg;
+        else if( sName == "min" )
+            nAggregates |= Min;
+        else if( sName == "max" )
+            nAggregates |= Max;
+        else if( sName == "last" )
+            nAggregates |= Last;
+        else if( sName == "count" )
+            nAggregates |= Count;
+        else if( !sName.isEmpty() )
+            throw CInvalidConfigValueException( "aggregates = " + lstAggregates.join(", ") );
+    }
+
+    m_nAggregates = nAggregates != 0? nAggregates : Avg;
+}
+
+void CMetricsAggregator::SetQuantiles( QStringList const& lstMetricPatterns, QStringList const& lstPercents )
+{
+    m_lstQuantileMetrics.clear();
+    for( QString const& sPattern : lstMetricPatterns )
+        if( !sPattern.trimmed().isEmpty() )
+            m_lstQuantileMetrics.append( QRegExp( sPattern.trimmed(), Qt::CaseInsensitive, QRegExp::Wildcard ) );
+
+    m_lstQuantiles.clear();
+    for( QString const& sPercent : lstPercents )
+    {
+        bool bOk = false;
+        double dPercent = sPercent.trimmed().toDouble( &bOk );
+        if( !bOk || dPercent <= 0 || dPercent >= 100 )
+            throw CInvalidConfigValueException( "quantiles = " + lstPercents.join(", ") );
+        m_lstQuantiles.append( dPercent / 100 );
+    }
+
+    // existing series pick up the patterns when recreated
+    m_mapSeries.clear();
+    m_aAccumulators.clear();
+}
+
+bool CMetricsAggregator::HasQuantiles( QString const& sMetricName ) const
+{
+    if( m_lstQuantiles.isEmpty() )
+        return false;
+    for( QRegExp const& oPattern : m_lstQuantileMetrics )
+        if( oPattern.exactMatch( sMetricName ) )
+            return true;
+    return false;
+}
+
+MetricDataList CMetricsAggregator::AddSamples( MetricDataList const& lstMetrics )
+{
+    // the window point is emitted on the tick of its last sample
+    bool bLastSample = m_nSamples + 1 >= m_nWindow;
+    MetricDataList lstAlerts;
+    for( MetricDataSPtr const& pMetric : lstMetrics )
+    {
+        Q_ASSERT(pMetric);
+        QString sKey = MakeKey( *pMetric );
+        auto it = m_mapSeries.find( sKey );
+        if( it == m_mapSeries.end() )
+        {
+            it = m_mapSeries.insert( sKey, int(m_aAccumulators.size()) );
+            m_aAccumulators.push_back( SAccumulator{ 0, 0, 0, 0, nullptr, nullptr, nullptr } );
+            // patterns are matched once per series, not per sample
+            if( HasQuantiles( pMetric->GetName() ) )
+                m_aAccumulators.back().pSketch = std::make_shared<CDDSketch>();
+        }
+
+        SAccumulator& oAcc = m_aAccumulators[it.value()];
+        oAcc.pLast = pMetric;
+        if( pMetric->HasSeverityDescriptor() )
+        {
+            if( bLastSample )
+                oAcc.pDescriptor = pMetric->GetSeverityDescriptor();
+            else
+                lstAlerts.append( pMetric );
+        }
+
+        bool bNumeric = false;
+        double dValue = pMetric->GetValue().toDouble( &bNumeric );
+        if( !bNumeric )
+            continue;
+
+        if( oAcc.nCount == 0 )
+        {
+            oAcc.dMin = oAcc.dMax = dValue;
+            oAcc.dSum = 0;
+        }
+        oAcc.dMin  = std::min( oAcc.dMin, dValue );
+        oAcc.dMax  = std::max( oAcc.dMax, dValue );
+        oAcc.dSum += dValue;
+        ++oAcc.nCount;
+        if( oAcc.pSketch )
+            oAcc.pSketch->Add( dValue );
+    }
+
+    ++m_nSamples;
+    return lstAlerts;
+}
+
+bool CMetricsAggregator::IsWindowComplete() const
+{
+    return m_nSamples >= m_nWindow;
+}
+
+MetricDataList CMetricsAggregator::Flush()
+{
+    MetricDataList lstResult;
+    int nIdleSeries = 0;
+    for( SAccumulator& oAcc : m_aAccumulators )
+    {
+        if( !oAcc.pLast )
+        {
+            // no samples in this window
+            ++nIdleSeries;
+            continue;
+        }
+
+        CMetricData const& oLast = *oAcc.pLast;
+        if( oAcc.nCount == 0 )
+        {
+            lstResult.append( oAcc.pLast );
+        }
+        else
+        {
+            // the series keeps its name, with the average or the last value
+            MetricDataSPtr pPoint = std::make_shared<CMetricData>( oLast );
+            // deadband marks of the samples do not apply to the window
+            pPoint->SetUnchanged( false );
+            if( m_nAggregates & Avg )
+                pPoint->SetValue( oAcc.dSum / oAcc.nCount );
+            pPoint->SetSeverityDescriptor( oAcc.pDescriptor );
+            lstResult.append( pPoint );
+
+            if( m_nAggregates & Min )
+                AppendAggregate( lstResult, oLast, "_min", oAcc.dMin, oLast.GetDataType() );
+            if( m_nAggregates & Max )
+                AppendAggregate( lstResult, oLast, "_max", oAcc.dMax, oLast.GetDataType() );
+            if( (m_nAggregates & Last) && (m_nAggregates & Avg) )
+                AppendAggregate( lstResult, oLast, "_last", oLast.GetValue().toDouble(), oLast.GetDataType() );
+            if( m_nAggregates & Count )
+                AppendAggregate( lstResult, oLast, "_count", oAcc.nCount, EMetricDataType::Counter );
+
+            if( oAcc.pSketch && !oAcc.pSketch->IsEmpty() )
+            {
+                for( double dQuantile : m_lstQuantiles )
+                    AppendAggregate( lstResult, oLast, "_p" + QString::number( dQuantile * 100 ),
+                                     oAcc.pSketch->GetQuantile( dQuantile ), oLast.GetDataType() );
+                if( !(m_nAggregates & Max) )
+                    AppendAggregate( lstResult, oLast, "_max", oAcc.pSketch->GetMax(), oLast.GetDataType() );
+            }
+        }
+
+        std::shared_ptr<CDDSketch> pSketch = std::move( oAcc.pSketch );
+        if( pSketch )
+            pSketch->Clear();
+        oAcc = SAccumulator{ 0, 0, 0, 0, nullptr, nullptr, std::move( pSketch ) };
+    }
+
+    // drop accumulators of disappeared series, e.g. processes leaving the top list
+    if( nIdleSeries * 2 > int(m_aAccumulators.size()) )
+    {
+        m_mapSeries.clear();
+        m_aAccumulators.clear();
+    }
+
+    m_nSamples = 0;
+    return lstResult;
+}
+
+QString CMetricsAggregator::MakeKey( CMetricData const& oMetric )
+{
+    return oMetric.GetSeriesKey();
+}
+
+void CMetricsAggregator::AppendAggregate( MetricDataList& lstResult, CMetricData const& oLast,
+                                          QString const& sSuffix, double dValue, EMetricDataType eDataType ) const
+{
+    MetricDataSPtr pPoint = std::make_shared<CMetricData>( oLast.GetName() + sSuffix,
+                                                           dValue,
+                                                           eDataType,
+                                                           oLast.GetTime(),
+                                                           oLast.GetMetricType(),
+                                                           oLast.GetReaction(),
+                                                           oLast.GetInstanceType(),
+                                                           oLast.GetInstanceName() );
+    for( auto const& oTag : oLast.GetTags() )
+        pPoint->AddTag( oTag.first, oTag.second );
+    pPoint->SetDeadband( oLast.GetDeadband() );
+    lstResult.append( pPoint );
+}
@@ -0,0 +1,107 @@
+#ifndef METRICSAGGREGATOR_H
+#define METRICSAGGREGATOR_H
+
+//
+//  Includes
+//
+#include "metricdata.h"
+#include "ddsketch.h"
+
+#include <QHash>
+#include <QRegExp>
+#include <QString>
+#include <QStringList>
+#include <memory>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CMetricsAggregator
+///
+/// Accumulates metrics sampled every tick and emits one point per series for every
+/// window of N samples. The series itself gets the average (or the last value if
+/// "avg" is not enabled), other enabled aggregates are emitted as series with
+/// _min, _max, _last and _count suffixes. Each series keeps a constant size
+/// accumulator, so adding a sample is O(1).
+///
+/// Samples carrying a severity descriptor (state change) are returned by AddSamples
+/// to be sent on their own tick, the change on the last tick of the window goes
+/// with the emitted point. So every state change is sent, and without delay.
+///
+/// Emitted points keep the deadband filter of their samples (see CMetricData::SetDeadband),
+/// so change-only settings of each section apply to the window points.
+///
+/// Series matching the quantile patterns also keep a DDSketch and emit _p50, _p90,
+/// _p99 (configured quantiles) and _max, so the tail of latency style counters is
+/// not hidden by the average. The sketch has fixed size and is cleared each window.
+///
+class CMetricsAggregator
+{
+public:
+    enum EAggregate
+    {
+        Avg   = 0x01,
+        Min   = 0x02,
+        Max   = 0x04,
+        Last  = 0x08,
+        Count = 0x10
+    };
+
+public:
+    CMetricsAggregator();
+
+public:
+    //
+    //	Main Interface
+    //
+    // nSamplesPerPoint <= 1 disables aggregation
+    void SetWindow( int nSamplesPerPoint );
+    int  GetWindow() const;
+    bool IsEnabled() const;
+    // Names: avg, min, max, last, count. Throws CInvalidConfigValueException
+    void SetAggregates( QStringList const& lstAggregates );
+    // Wildcard patterns of metric names and percents, e.g. "*_latency" and 50, 90, 99.
+    // Throws CInvalidConfigValueException
+    void SetQuantiles( QStringList const& lstMetricPatterns, QStringList const& lstPercents );
+
+    // Returns the samples with severity descriptors to send at once
+    MetricDataList AddSamples( MetricDataList const& lstMetrics );
+    bool IsWindowComplete() const;
+    // Returns aggregated points and starts a new window
+    MetricDataList Flush();
+
+private:
+    struct SAccumulator
+    {
+        double         dMin;
+        double         dMax;
+        double         dSum;
+        int            nCount;
+        MetricDataSPtr pLast;       // last sample, non numeric values are passed as is
+        MetricSeverityDescriptorSPtr pDescriptor;   // of the last sample only
+        std::shared_ptr<CDDSketch>   pSketch;       // null if no quantiles for the series
+    };
+
+    bool HasQuantiles( QString const& sMetricName ) const;
+
+    static QString MakeKey( CMetricData const& oMetric );
+    void AppendAggregate( MetricDataList& lstResult, CMetricData const& oLast,
+                          QString const& sSuffix, double dValue, EMetricDataType eDataType ) const;
+
+private:
+    //
+    //	Content
+    //
+    int  m_nWindow;
+    int  m_nSamples;
+    int  m_nAggregates;
+
+    QHash<QString, int>       m_mapSeries;      // series key to accumulator index
+    std::vector<SAccumulator> m_aAccumulators;
+
+    QList<QRegExp>            m_lstQuantileMetrics;
+    QList<double>             m_lstQuantiles;   // in [0, 1]
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // METRICSAGGREGATOR_H
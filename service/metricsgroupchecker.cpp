@@ -4,7 +4,8 @@
 #undef GetMessage
 
 CMetricsGroupChecker::CMetricsGroupChecker(QObject* pParent)
-    : Base( pParent )
+    : Base( pParent ),
+      m_pDeadband( std::make_shared<CDeadbandFilter>() )
 {
 }
 
@@ -50,9 +51,31 @@ MetricDataList CMetricsGroupChecker::CheckMetrics()
         }
     }
 
+    // per core/drive/interface series are summarized if "rollup" is configured
+    m_oRollup.Apply( lstMetrics );
+    // unchanged values are not sent if "change_only" is configured, CEngine applies
+    // the filter to the samples or to the aggregated points
+    if( m_pDeadband->IsEnabled() )
+        for( MetricDataSPtr const& pMetric : lstMetrics )
+            pMetric->SetDeadband( m_pDeadband );
+
     return lstMetrics;
 }
 
+void CMetricsGroupChecker::SetConfigSection(const CConfigSection &oConfig)
+{
+    Base::SetConfigSection( oConfig );
+    m_oRollup.Configure( oConfig );
+
+    // SelfConfig values are defaults for all sections
+    CConfiguraion&  oMain    = ConfMgr.GetMainConfiguration();
+    CConfigSection& oSection = ConfigSection();
+    m_pDeadband->SetSettings( oSection.Value<bool>(   "change_only",      oMain.Value<bool>(   "SelfConfig/change_only",      false ) ),
+                              oSection.Value<double>( "deadband",         oMain.Value<double>( "SelfConfig/deadband",         0 ) ),
+                              oSection.Value<double>( "deadband_percent", oMain.Value<double>( "SelfConfig/deadband_percent", 0 ) ),
+                              oSection.Value<int>(    "heartbeat_ticks",  oMain.Value<int>(    "SelfConfig/heartbeat_ticks",  10 ) ) );
+}
+
 void CMetricsGroupChecker::AddMetricChecker(IMetricCheckerSPtr pMetricChecker)
 {
     Q_ASSERT(pMetricChecker);
@@ -3,6 +3,8 @@
 
 #include "imetricscategorychecker.h"
 #include "imetricchecker.h"
+#include "instancerollup.h"
+#include "deadbandfilter.h"
 
 using MetricCheckersList = QList<IMetricCheckerSPtr>;
 
@@ -21,6 +23,7 @@ public:
 public:
     // IMetricsCategoryChecker interface
     MetricDataList CheckMetrics() override;
+    void SetConfigSection( CConfigSection const& oConfig ) override;
 
     // Own Interface
     void AddMetricChecker( IMetricCheckerSPtr pMetricChecker );
@@ -31,6 +34,8 @@ private:
     //  Content
     //
     MetricCheckersList m_lstMetricCheckers;
+    CInstanceRollup    m_oRollup;
+    DeadbandFilterSPtr m_pDeadband;
 };
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -9,6 +9,9 @@
 #include "agentinitializer.h"
 #include "configurationmanager.h"
 #include "performancecounterinfodumper.h"
+#include "perfcountercatalog.h"
+#include "upload/uploadstatistics.h"
+#include <QElapsedTimer>
 
 COEAgentControlServer::COEAgentControlServer(QObject* pParent )
     : Base(pParent)
@@ -18,6 +21,15 @@ COEAgentControlServer::COEAgentControlServer(QObject* pParent )
     connect( this, &COEAgentControlServer::newConnection,
              this, &COEAgentControlServer::onNewConnection );
 
+    // dump runs in the dumper thread, notifications are queued back
+    CPerformanceCounterInfoDumper& oDumper = CPerformanceCounterInfoDumper::Instance();
+    connect( &oDumper, &CPerformanceCounterInfoDumper::sigDumpProgress,
+             this, &COEAgentControlServer::onCountersDumpProgress );
+    connect( &oDumper, &CPerformanceCounterInfoDumper::sigDumpFinished,
+             this, &COEAgentControlServer::onCountersDumpFinished );
+    connect( &oDumper, &CPerformanceCounterInfoDumper::sigDumpFailed,
+             this, &COEAgentControlServer::onCountersDumpFailed );
+
 //    connect( &CServiceController::Instance(), &CServiceController::sigStarted,
 //             this, [this]()
 //    {
@@ -320,6 +332,7 @@ bool COEAgentControlServer::SendStatus(QLocalSocket *pRequestedClientSock, QStri
         oConfInfo["conf_dir"] = sConfigsDirPath;
         oConfInfo["log_dir"] = sLogsDirPath;
         oConfInfo["price_info"] = CServiceController::Instance().GetPriceInfo();
+        oConfInfo["upload_stats"] = CUploadStatistics::Instance().GetSummary();
 
         CMessage oNotification(eEvent);
         oNotification.SetConfigInfo( oConfInfo );
@@ -347,23 +360,26 @@ bool COEAgentControlServer::SendStatus(QLocalSocket *pRequestedClientSock, QStri
     }
 }
 
-bool COEAgentControlServer::DumpAvailablePerformanceCounters(QLocalSocket *pRequestedClientSock, const QString &sCommand)
+bool COEAgentControlServer::DumpAvailablePerformanceCounters(QLocalSocket *pRequestedClientSock,
+                                                             const QString &sCommand,
+                                                             EPerfCountersDumpMode eMode)
 {
     // Start
     try
     {
-        LOG_INFO("Control SERVER: DumpAvailableCounters started");
-
-        CServiceController::Instance().DumpPerformanceCountersInfo();
-
-        QString sDumpFilePath = CPerformanceCounterInfoDumper::Instance().GetDumpFilePath();
-        QString sInfo = QString("Dump file path: %1").arg( sDumpFilePath );
-        NotifyToClient( pRequestedClientSock, CMessage( ENotificationEvent::CountersInfoDumped,
-                                                        sCommand,
-                                                        "Available performance counters info dumped",
-                                                        sInfo));
+        CPerformanceCounterInfoDumper& oDumper = CPerformanceCounterInfoDumper::Instance();
+        if( oDumper.StartDumpCountersInfo( eMode ) )
+        {
+            LOG_INFO("Control SERVER: DumpAvailableCounters started");
+            m_sDumpCommand = sCommand;
+        }
+        else
+        {
+            // join the running dump
+            LOG_INFO("Control SERVER: DumpAvailableCounters is already running");
+        }
 
-        LOG_INFO("Control SERVER: DumpAvailableCounters succedded!")
+        m_lstDumpRequesters.append( pRequestedClientSock );
         return true;
     }
     catch(std::exception const& oExc)
@@ -385,6 +401,115 @@ bool COEAgentControlServer::DumpAvailablePerformanceCounters(QLocalSocket *pRequ
     }
 }
 
+bool COEAgentControlServer::QueryPerformanceCounters(QLocalSocket *pRequestedClientSock,
+                                                     const QJsonObject &oQuery,
+                                                     const QString &sCommand)
+{
+    // "pattern": "SQLServer:*Latch*", optional "field": "path" (default), "help" or "instance",
+    // "limit": max returned matches, "rebuild": true to refresh the catalog
+    try
+    {
+        CPerfCounterCatalog& oCatalog = CPerfCounterCatalog::Instance();
+
+        bool bCatalogReady = !oCatalog.IsEmpty();
+        if( !bCatalogReady || oQuery.value( "rebuild" ).toBool() )
+            oCatalog.StartRebuild();
+
+        CPerfCounterCatalog::EQueryField eField = CPerfCounterCatalog::EQueryField::Path;
+        QString sField = oQuery.value( "field" ).toString();
+        if( sField.compare( "help", Qt::CaseInsensitive ) == 0 )
+            eField = CPerfCounterCatalog::EQueryField::Help;
+        else if( sField.compare( "instance", Qt::CaseInsensitive ) == 0 )
+            eField = CPerfCounterCatalog::EQueryField::Instance;
+        int nLimit = oQuery.value( "limit" ).toInt( 1000 );
+
+        QElapsedTimer oTimer;
+        oTimer.start();
+        CPerfCounterCatalog::SQueryResult oResult = oCatalog.Query( oQuery.value( "pattern" ).toString(), eField, nLimit );
+
+        CConfigInfo oResultInfo;
+        oResultInfo["matches"]       = oResult.lstMatches;
+        oResultInfo["total_matches"] = oResult.nTotalMatches;
+        oResultInfo["elapsed_ms"]    = oTimer.elapsed();
+        oResultInfo["catalog_ready"] = bCatalogReady;
+
+        CMessage oNotification( ENotificationEvent::CountersQueryResult, sCommand );
+        oNotification.SetConfigInfo( oResultInfo );
+        NotifyToClient( pRequestedClientSock, oNotification );
+        return true;
+    }
+    catch(std::exception const& oExc)
+    {
+        NotifyToClient( pRequestedClientSock, CMessage("Failed to query performance counters!",
+                                                       oExc.what(),
+                                                       EMessageType::Error,
+                                                       sCommand ) );
+        LOG_ERROR("Control SERVER: QueryPerformanceCounters Failed!: " + std::string(oExc.what()));
+        return false;
+    }
+}
+
+bool COEAgentControlServer::SendInstanceDetails(QLocalSocket *pRequestedClientSock,
+                                                int nSeconds,
+                                                const QString &sCommand)
+{
+    if( !CServiceController::Instance().RequestInstanceDetails( nSeconds ) )
+    {
+        NotifyToClient( pRequestedClientSock, CMessage( ENotificationEvent::AgentStopped, sCommand, "OddEye Agent is not running" ) );
+        return false;
+    }
+
+    NotifyToClient( pRequestedClientSock, CMessage( "Instance details requested",
+                                                    QString( "Per instance series are sent for %1 sec" ).arg( nSeconds ),
+                                                    EMessageType::Information,
+                                                    sCommand ) );
+    return true;
+}
+
+void COEAgentControlServer::onCountersDumpProgress(int nDone, int nTotal, const QString &sObjectName)
+{
+    CConfigInfo oProgressInfo;
+    oProgressInfo["dump_progress_done"]   = nDone;
+    oProgressInfo["dump_progress_total"]  = nTotal;
+    oProgressInfo["dump_progress_object"] = sObjectName;
+
+    CMessage oNotification( ENotificationEvent::CountersDumpProgress, m_sDumpCommand );
+    oNotification.SetConfigInfo( oProgressInfo );
+
+    for( QPointer<QLocalSocket> const& pClientSock : m_lstDumpRequesters )
+        NotifyToClient( pClientSock, oNotification );
+}
+
+void COEAgentControlServer::onCountersDumpFinished(const QString &sDumpFilePath, int nRewrittenObjects, int nTotalObjects)
+{
+    QString sInfo = QString("Dump file path: %1\n"
+                            "Updated objects: %2 of %3").arg( sDumpFilePath ).arg( nRewrittenObjects ).arg( nTotalObjects );
+    CMessage oNotification( ENotificationEvent::CountersInfoDumped,
+                            m_sDumpCommand,
+                            "Available performance counters info dumped",
+                            sInfo );
+
+    for( QPointer<QLocalSocket> const& pClientSock : m_lstDumpRequesters )
+        NotifyToClient( pClientSock, oNotification );
+    m_lstDumpRequesters.clear();
+
+    LOG_INFO("Control SERVER: DumpAvailableCounters succedded!")
+}
+
+void COEAgentControlServer::onCountersDumpFailed(const QString &sError)
+{
+    CMessage oNotification( "Failed to dump available performance counters!",
+                            sError,
+                            EMessageType::Error,
+                            m_sDumpCommand );
+
+    for( QPointer<QLocalSocket> const& pClientSock : m_lstDumpRequesters )
+        NotifyToClient( pClientSock, oNotification );
+    m_lstDumpRequesters.clear();
+
+    LOG_ERROR("Control SERVER: DumpAvailablePerformanceCounters Failed!: " + sError.toStdString());
+}
+
 void COEAgentControlServer::ProcessCommandJson(const QJsonObject &oCommand,
                                                QLocalSocket* pSenderSock)
 {
@@ -410,7 +535,20 @@ void COEAgentControlServer::ProcessCommandJson(const QJsonObject &oCommand,
     }
     else if( sCommand.compare( "dump_perf_counters", Qt::CaseInsensitive ) == 0  )
     {
-        // Restart
-        DumpAvailablePerformanceCounters(pSenderSock, sCommand);
+        // optional "mode": "full" (default) or "incremental"
+        EPerfCountersDumpMode eMode = EPerfCountersDumpMode::Full;
+        if( oCommand.value( "mode" ).toString().compare( "incremental", Qt::CaseInsensitive ) == 0 )
+            eMode = EPerfCountersDumpMode::Incremental;
+
+        DumpAvailablePerformanceCounters(pSenderSock, sCommand, eMode);
+    }
+    else if( sCommand.compare( "query_perf_counters", Qt::CaseInsensitive ) == 0  )
+    {
+        QueryPerformanceCounters(pSenderSock, oCommand, sCommand);
+    }
+    else if( sCommand.compare( "send_instance_details", Qt::CaseInsensitive ) == 0  )
+    {
+        // "seconds": how long instance series summarized by roll-ups are sent
+        SendInstanceDetails(pSenderSock, oCommand.value( "seconds" ).toInt( 600 ), sCommand);
     }
 }
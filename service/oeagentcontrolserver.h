@@ -2,7 +2,9 @@
 #define OEAGENTCONTROLSERVER_H
 
 #include <QLocalServer>
+#include <QPointer>
 #include "message.h"
+#include "performancecounterinfodumper.h"
 
 class COEAgentControlServer : public QLocalServer
 {
@@ -24,13 +26,22 @@ public:
     bool StopAgent( QLocalSocket* pRequestedClientSock, QString const& sCommand = QString() );
     bool RestartAgent( QLocalSocket* pRequestedClientSock, QString const& sCommand = QString() );
     bool SendStatus( QLocalSocket* pRequestedClientSock, QString const& sCommand = QString() );
-    bool DumpAvailablePerformanceCounters( QLocalSocket* pRequestedClientSock, QString const& sCommand = QString() );
+    bool DumpAvailablePerformanceCounters( QLocalSocket* pRequestedClientSock, QString const& sCommand = QString(),
+                                           EPerfCountersDumpMode eMode = EPerfCountersDumpMode::Full );
+    bool QueryPerformanceCounters( QLocalSocket* pRequestedClientSock, QJsonObject const& oQuery,
+                                   QString const& sCommand = QString() );
+    bool SendInstanceDetails( QLocalSocket* pRequestedClientSock, int nSeconds,
+                              QString const& sCommand = QString() );
 
 private slots:
     void onNewConnection();
     void onReadyRead();
     void onSocketAboutToClose();
 
+    void onCountersDumpProgress( int nDone, int nTotal, QString const& sObjectName );
+    void onCountersDumpFinished( QString const& sDumpFilePath, int nRewrittenObjects, int nTotalObjects );
+    void onCountersDumpFailed( QString const& sError );
+
 private:
     void ProcessCommandJson(QJsonObject const& oCommand, QLocalSocket* pSenderSock );
     void NotifyToAllClients( CMessage const& oMsg );
@@ -39,6 +50,9 @@ private:
 private:
     // content
     QList<QLocalSocket*> m_lstClientSockets;
+    // clients waiting for the running counters dump
+    QList<QPointer<QLocalSocket>> m_lstDumpRequesters;
+    QString                       m_sDumpCommand;
 };
 
 #endif // OEAGENTCONTROLSERVER_H
@@ -0,0 +1,457 @@
+#include "perfcountercatalog.h"
+#include "performancecountersinfoprovider.h"
+#include "winperformancemetricschecker.h"
+#include "logger.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QSaveFile>
+#include <QSet>
+#include <algorithm>
+
+namespace
+{
+const qint32 c_nStorageMagic   = 0x4F45434C;   // "OECL"
+const qint32 c_nStorageVersion = 1;
+
+template <typename TEntry>
+bool LessByKey( TEntry const& oLeft, TEntry const& oRight )
+{
+    return oLeft.sKey < oRight.sKey;
+}
+}
+
+
+CPerfCounterCatalog::CPerfCounterCatalog()
+    : m_bLoaded( false ),
+      m_pWorkerThread( nullptr ),
+      m_bRebuildRunning( false )
+{
+}
+
+CPerfCounterCatalog &CPerfCounterCatalog::Instance()
+{
+    static CPerfCounterCatalog oInst;
+    return oInst;
+}
+
+CPerfCounterCatalog::~CPerfCounterCatalog()
+{
+    if( m_pWorkerThread )
+    {
+        m_pWorkerThread->quit();
+        m_pWorkerThread->wait();
+        delete m_pWorkerThread;
+    }
+}
+
+void CPerfCounterCatalog::SetStorageFilePath( QString const& sFilePath )
+{
+    QWriteLocker oLocker( &m_oLock );
+    m_sStorageFilePath = sFilePath;
+}
+
+bool CPerfCounterCatalog::StartRebuild()
+{
+    bool bExpected = false;
+    if( !m_bRebuildRunning.compare_exchange_strong( bExpected, true ) )
+        return false;
+
+    if( !m_pWorkerThread )
+    {
+        m_pWorkerThread = new QThread();
+        moveToThread( m_pWorkerThread );
+        bool bOK = connect( this, &CPerfCounterCatalog::sigStartRebuild,
+                            this, &CPerfCounterCatalog::onStartRebuild, Qt::QueuedConnection );
+        Q_ASSERT(bOK);
+        Q_UNUSED(bOK);
+        m_pWorkerThread->start( QThread::LowPriority );
+    }
+
+    emit sigStartRebuild();
+    return true;
+}
+
+bool CPerfCounterCatalog::IsRebuildRunning() const
+{
+    return m_bRebuildRunning;
+}
+
+bool CPerfCounterCatalog::IsEmpty() const
+{
+    LoadIfNeeded();
+    QReadLocker oLocker( &m_oLock );
+    return m_mapObjects.isEmpty();
+}
+
+void CPerfCounterCatalog::onStartRebuild()
+{
+    try
+    {
+        Rebuild();
+    }
+    catch( std::exception const& oExc )
+    {
+        LOG_ERROR( std::string("Performance counters catalog rebuild failed: ") + oExc.what() );
+        emit sigRebuildFailed( oExc.what() );
+    }
+    catch( ... )
+    {
+        LOG_ERROR( "Performance counters catalog rebuild failed: Unknown exception" );
+        emit sigRebuildFailed( "Unknown exception" );
+    }
+    m_bRebuildRunning = false;
+}
+
+void CPerfCounterCatalog::Rebuild()
+{
+    LoadIfNeeded();
+
+    QHash<QString, SObject> mapNewObjects;
+    QVector<SIndexEntry>    aNewEntries;
+    QSet<QString>           setChanged;
+
+    CPerformanceCountersInfoProvider::EnumerateCountersInfo(
+                [&]( SPerformanceObjectInfo const& oInfo, int nIndex, int nCount )
+    {
+        Q_UNUSED( nIndex );
+        Q_UNUSED( nCount );
+
+        QByteArray aSignature = CPerformanceCountersInfoProvider::MakeSignature( oInfo, false );
+
+        SObject oObject;
+        {
+            QReadLocker oLocker( &m_oLock );
+            oObject = m_mapObjects.value( oInfo.sName );
+        }
+
+        if( oObject.aSignature == aSignature && !aSignature.isEmpty() )
+        {
+            // counters are the same, index entries are kept
+            oObject.lstInstances = oInfo.lstInstances;
+        }
+        else
+        {
+            oObject = MakeObject( oInfo, aSignature );
+            AppendIndexEntries( oObject, aNewEntries );
+            setChanged.insert( oObject.sName );
+        }
+
+        mapNewObjects.insert( oObject.sName, oObject );
+    } );
+
+    std::sort( aNewEntries.begin(), aNewEntries.end(), LessByKey<SIndexEntry> );
+
+    int nIndexSize = 0;
+    {
+        QWriteLocker oLocker( &m_oLock );
+
+        // objects which disappeared
+        for( auto it = m_mapObjects.begin(); it != m_mapObjects.end(); ++it )
+            if( !mapNewObjects.contains( it.key() ) )
+                setChanged.insert( it.key() );
+
+        // drop entries of changed objects and merge in the new ones
+        QVector<SIndexEntry> aIndex;
+        aIndex.reserve( m_aIndex.size() + aNewEntries.size() );
+        auto itNew = aNewEntries.begin();
+        for( SIndexEntry const& oEntry : m_aIndex )
+        {
+            if( setChanged.contains( oEntry.sObject ) )
+                continue;
+            while( itNew != aNewEntries.end() && LessByKey( *itNew, oEntry ) )
+                aIndex.append( *itNew++ );
+            aIndex.append( oEntry );
+        }
+        while( itNew != aNewEntries.end() )
+            aIndex.append( *itNew++ );
+
+        m_aIndex = aIndex;
+        m_aInstanceIndex = MakeInstanceIndex( mapNewObjects );
+        m_mapObjects = mapNewObjects;
+        nIndexSize = m_aIndex.size();
+    }
+
+    Save();
+
+    int nChanged = setChanged.size();
+    LOG_INFO( QString( "Performance counters catalog rebuilt. Objects: %1, changed: %2, counters: %3" )
+              .arg( mapNewObjects.size() ).arg( nChanged ).arg( nIndexSize ) );
+    emit sigRebuildFinished( nChanged, mapNewObjects.size() );
+}
+
+CPerfCounterCatalog::SObject CPerfCounterCatalog::MakeObject( SPerformanceObjectInfo const& oInfo, QByteArray const& aSignature )
+{
+    SObject oObject;
+    oObject.sName        = oInfo.sName;
+    oObject.sDescription = oInfo.sDescription;
+    oObject.aSignature   = aSignature;
+    oObject.lstInstances = oInfo.lstInstances;
+
+    oObject.aCounters.reserve( oInfo.lstCounters.size() );
+    for( SCounterInfo const& oCounterInfo : oInfo.lstCounters )
+    {
+        SCounter oCounter;
+        oCounter.sName        = oCounterInfo.sPath;
+        oCounter.sDescription = oCounterInfo.sDescription;
+        // same form as in the counters dump
+        oCounter.sMetricName  = CWinPerformanceMetricsChecker::MakeMetricNameFromCounterPath(
+                    QString("\\\\%1\\\\%2").arg( oInfo.sName, oCounterInfo.sPath ) );
+        oObject.aCounters.append( oCounter );
+    }
+
+    return oObject;
+}
+
+void CPerfCounterCatalog::AppendIndexEntries( SObject const& oObject, QVector<SIndexEntry>& aEntries )
+{
+    for( int i = 0; i < oObject.aCounters.size(); ++i )
+    {
+        SIndexEntry oEntry;
+        oEntry.sKey     = (oObject.sName + "\\" + oObject.aCounters[i].sName).toLower();
+        oEntry.sObject  = oObject.sName;
+        oEntry.nItem    = i;
+        aEntries.append( oEntry );
+    }
+}
+
+QVector<CPerfCounterCatalog::SIndexEntry> CPerfCounterCatalog::MakeInstanceIndex( QHash<QString, SObject> const& mapObjects )
+{
+    QVector<SIndexEntry> aIndex;
+    for( SObject const& oObject : mapObjects )
+    {
+        for( int i = 0; i < oObject.lstInstances.size(); ++i )
+        {
+            SIndexEntry oEntry;
+            oEntry.sKey    = oObject.lstInstances[i].toLower();
+            oEntry.sObject = oObject.sName;
+            oEntry.nItem   = i;
+            aIndex.append( oEntry );
+        }
+    }
+
+    std::sort( aIndex.begin(), aIndex.end(), LessByKey<SIndexEntry> );
+    return aIndex;
+}
+
+CPerfCounterCatalog::SQueryResult CPerfCounterCatalog::Query( QString const& sPattern, EQueryField eField, int nLimit ) const
+{
+    LoadIfNeeded();
+
+    SQueryResult oResult;
+    QString sLowerPattern = sPattern.trimmed().toLower();
+
+    QReadLocker oLocker( &m_oLock );
+
+    auto fnAddMatch = [&]( SIndexEntry const& oEntry )
+    {
+        auto itObject = m_mapObjects.constFind( oEntry.sObject );
+        if( itObject == m_mapObjects.constEnd() )
+            return;
+
+        if( oResult.nTotalMatches < nLimit )
+            oResult.lstMatches.append( eField == EQueryField::Instance?
+                                           MakeInstanceMatch( *itObject, oEntry.nItem ) :
+                                           MakeMatch( *itObject, oEntry.nItem ) );
+        ++oResult.nTotalMatches;
+    };
+
+    if( eField == EQueryField::Help )
+    {
+        for( SIndexEntry const& oEntry : m_aIndex )
+        {
+            auto itObject = m_mapObjects.constFind( oEntry.sObject );
+            if( itObject == m_mapObjects.constEnd() )
+                continue;
+            if( itObject->aCounters[oEntry.nItem].sDescription.contains( sLowerPattern, Qt::CaseInsensitive )
+                    || itObject->sDescription.contains( sLowerPattern, Qt::CaseInsensitive ) )
+                fnAddMatch( oEntry );
+        }
+        return oResult;
+    }
+
+    ScanIndex( eField == EQueryField::Instance? m_aInstanceIndex : m_aIndex, sLowerPattern, fnAddMatch );
+    return oResult;
+}
+
+void CPerfCounterCatalog::ScanIndex( QVector<SIndexEntry> const& aIndex, QString const& sLowerPattern,
+                                     std::function<void( SIndexEntry const& )> const& fnMatch )
+{
+    // literal prefix narrows the scanned range
+    int nWildcard = sLowerPattern.indexOf( QRegExp( "[*?]" ) );
+    QString sPrefix = nWildcard < 0? sLowerPattern : sLowerPattern.left( nWildcard );
+
+    // longest literal fragment filters entries before glob matching
+    QString sFragment;
+    for( QString const& sPart : sLowerPattern.split( QRegExp( "[*?]" ), QString::SkipEmptyParts ) )
+        if( sPart.size() > sFragment.size() )
+            sFragment = sPart;
+
+    SIndexEntry oProbe;
+    oProbe.sKey = sPrefix;
+    auto it = std::lower_bound( aIndex.constBegin(), aIndex.constEnd(), oProbe, LessByKey<SIndexEntry> );
+    for( ; it != aIndex.constEnd() && it->sKey.startsWith( sPrefix ); ++it )
+    {
+        if( nWildcard >= 0 )
+        {
+            if( !it->sKey.contains( sFragment ) )
+                continue;
+            if( !MatchGlob( it->sKey.constData(), it->sKey.size(), sLowerPattern.constData(), sLowerPattern.size() ) )
+                continue;
+        }
+
+        fnMatch( *it );
+    }
+}
+
+bool CPerfCounterCatalog::MatchGlob( QChar const* pText, int nTextLength, QChar const* pPattern, int nPatternLength )
+{
+    int nText = 0, nPattern = 0;
+    int nStar = -1, nStarText = 0;
+
+    while( nText < nTextLength )
+    {
+        if( nPattern < nPatternLength && (pPattern[nPattern] == '?' || pPattern[nPattern] == pText[nText]) )
+        {
+            ++nText;
+            ++nPattern;
+        }
+        else if( nPattern < nPatternLength && pPattern[nPattern] == '*' )
+        {
+            nStar = nPattern++;
+            nStarText = nText;
+        }
+        else if( nStar >= 0 )
+        {
+            // let the last star consume one more character
+            nPattern = nStar + 1;
+            nText = ++nStarText;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    while( nPattern < nPatternLength && pPattern[nPattern] == '*' )
+        ++nPattern;
+
+    return nPattern == nPatternLength;
+}
+
+QVariantMap CPerfCounterCatalog::MakeMatch( SObject const& oObject, int nCounter )
+{
+    SCounter const& oCounter = oObject.aCounters[nCounter];
+
+    QString sPath = oObject.lstInstances.isEmpty()?
+                QString("\\%1\\%2").arg( oObject.sName, oCounter.sName ) :
+                QString("\\%1(*)\\%2").arg( oObject.sName, oCounter.sName );
+
+    QVariantMap oMatch;
+    oMatch["object"]      = oObject.sName;
+    oMatch["counter"]     = oCounter.sName;
+    oMatch["path"]        = sPath;
+    oMatch["metric"]      = oCounter.sMetricName;
+    oMatch["description"] = oCounter.sDescription;
+    oMatch["instances"]   = oObject.lstInstances.size();
+    oMatch["config_line"] = QString("%1 = %2").arg( oCounter.sMetricName, sPath );
+    return oMatch;
+}
+
+QVariantMap CPerfCounterCatalog::MakeInstanceMatch( SObject const& oObject, int nInstance )
+{
+    QString const& sInstance = oObject.lstInstances[nInstance];
+    QString sPath = QString("\\%1(%2)\\*").arg( oObject.sName, sInstance );
+
+    QVariantMap oMatch;
+    oMatch["object"]      = oObject.sName;
+    oMatch["instance"]    = sInstance;
+    oMatch["path"]        = sPath;
+    oMatch["counters"]    = oObject.aCounters.size();
+    oMatch["config_line"] = QString("%1 (%2 counters)").arg( sPath ).arg( oObject.aCounters.size() );
+    return oMatch;
+}
+
+void CPerfCounterCatalog::LoadIfNeeded() const
+{
+    QWriteLocker oLocker( &m_oLock );
+    if( m_bLoaded )
+        return;
+    m_bLoaded = true;
+
+    QFile oFile( m_sStorageFilePath );
+    if( m_sStorageFilePath.isEmpty() || !oFile.open( QFile::ReadOnly ) )
+        return;
+
+    QDataStream in( &oFile );
+    qint32 nMagic = 0, nVersion = 0, nObjectCount = 0;
+    in >> nMagic >> nVersion >> nObjectCount;
+    if( nMagic != c_nStorageMagic || nVersion != c_nStorageVersion )
+    {
+        LOG_WARNING( "Ignoring incompatible performance counters catalog file: " + m_sStorageFilePath.toStdString() );
+        return;
+    }
+
+    QHash<QString, SObject> mapObjects;
+    QVector<SIndexEntry> aIndex;
+    for( qint32 i = 0; i < nObjectCount && in.status() == QDataStream::Ok; ++i )
+    {
+        SObject oObject;
+        qint32 nCounterCount = 0;
+        in >> oObject.sName >> oObject.sDescription >> oObject.aSignature >> oObject.lstInstances >> nCounterCount;
+        for( qint32 j = 0; j < nCounterCount && in.status() == QDataStream::Ok; ++j )
+        {
+            SCounter oCounter;
+            in >> oCounter.sName >> oCounter.sDescription >> oCounter.sMetricName;
+            oObject.aCounters.append( oCounter );
+        }
+
+        AppendIndexEntries( oObject, aIndex );
+        mapObjects.insert( oObject.sName, oObject );
+    }
+
+    if( in.status() != QDataStream::Ok )
+    {
+        LOG_WARNING( "Ignoring corrupted performance counters catalog file: " + m_sStorageFilePath.toStdString() );
+        return;
+    }
+
+    std::sort( aIndex.begin(), aIndex.end(), LessByKey<SIndexEntry> );
+    m_aInstanceIndex = MakeInstanceIndex( mapObjects );
+    m_mapObjects = mapObjects;
+    m_aIndex = aIndex;
+}
+
+void CPerfCounterCatalog::Save()
+{
+    QReadLocker oLocker( &m_oLock );
+    if( m_sStorageFilePath.isEmpty() )
+        return;
+
+    QDir().mkpath( QFileInfo( m_sStorageFilePath ).absolutePath() );
+
+    // write to temporary file and replace, so readers never see a partial file
+    QSaveFile oFile( m_sStorageFilePath );
+    if( !oFile.open( QFile::WriteOnly ) )
+    {
+        LOG_WARNING( "Failed to save performance counters catalog: " + m_sStorageFilePath.toStdString() );
+        return;
+    }
+
+    QDataStream out( &oFile );
+    out << c_nStorageMagic << c_nStorageVersion << qint32( m_mapObjects.size() );
+    for( auto it = m_mapObjects.constBegin(); it != m_mapObjects.constEnd(); ++it )
+    {
+        SObject const& oObject = *it;
+        out << oObject.sName << oObject.sDescription << oObject.aSignature << oObject.lstInstances
+            << qint32( oObject.aCounters.size() );
+        for( SCounter const& oCounter : oObject.aCounters )
+            out << oCounter.sName << oCounter.sDescription << oCounter.sMetricName;
+    }
+
+    if( !oFile.commit() )
+        LOG_WARNING( "Failed to save performance counters catalog: " + m_sStorageFilePath.toStdString() );
+}
@@ -0,0 +1,126 @@
+#ifndef PERFCOUNTERCATALOG_H
+#define PERFCOUNTERCATALOG_H
+
+//
+//  Includes
+//
+#include <QHash>
+#include <QObject>
+#include <QReadWriteLock>
+#include <QStringList>
+#include <QThread>
+#include <QVariantList>
+#include <QVariantMap>
+#include <QVector>
+#include <atomic>
+#include <functional>
+
+struct SPerformanceObjectInfo;
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CPerfCounterCatalog
+///
+/// In-memory index of available performance objects, counters, instances and help
+/// texts. Counter paths ("Object\Counter") are kept in a lower case sorted index,
+/// so prefix queries are a binary search and glob queries ('*', '?') scan only the
+/// range of their literal prefix. Instance names have an index of their own, it is
+/// rebuilt every time as instances come and go. Rebuild runs in a worker thread
+/// and replaces only the counter entries of objects whose signature changed. The
+/// catalog is persisted to a file and loaded from it on first use.
+///
+class CPerfCounterCatalog : public QObject
+{
+    Q_OBJECT
+    using Base = QObject;
+
+    CPerfCounterCatalog();
+public:
+    static CPerfCounterCatalog& Instance();
+    ~CPerfCounterCatalog();
+
+public:
+    enum class EQueryField
+    {
+        Path,           // "Object\Counter"
+        Help,           // counter or object help text, substring match
+        Instance        // instance name, one match per object and instance
+    };
+
+    struct SQueryResult
+    {
+        QVariantList lstMatches;
+        int          nTotalMatches = 0;
+    };
+
+    void SetStorageFilePath( QString const& sFilePath );
+
+    // Starts rebuild in the worker thread, returns false if already running
+    bool StartRebuild();
+    bool IsRebuildRunning() const;
+    bool IsEmpty() const;
+
+    // Case-insensitive. Path and instance patterns without wildcards are prefix queries
+    SQueryResult Query( QString const& sPattern, EQueryField eField = EQueryField::Path, int nLimit = 1000 ) const;
+
+signals:
+    void sigStartRebuild();
+    void sigRebuildFinished( int nChangedObjects, int nTotalObjects );
+    void sigRebuildFailed( QString const& sError );
+
+private slots:
+    void onStartRebuild();
+
+private:
+    struct SCounter
+    {
+        QString sName;
+        QString sDescription;
+        QString sMetricName;
+    };
+
+    struct SObject
+    {
+        QString           sName;
+        QString           sDescription;
+        QByteArray        aSignature;  // of counters, instances do not affect the index
+        QVector<SCounter> aCounters;
+        QStringList       lstInstances;
+    };
+
+    struct SIndexEntry
+    {
+        QString sKey;       // lower case "object\counter" or instance name
+        QString sObject;
+        int     nItem;      // counter or instance position in the object
+    };
+
+    void Rebuild();
+    void LoadIfNeeded() const;
+    void Save();
+
+    static SObject MakeObject( SPerformanceObjectInfo const& oInfo, QByteArray const& aSignature );
+    static void    AppendIndexEntries( SObject const& oObject, QVector<SIndexEntry>& aEntries );
+    static QVector<SIndexEntry> MakeInstanceIndex( QHash<QString, SObject> const& mapObjects );
+    // calls fnMatch for entries matching the lower case path or instance pattern
+    static void    ScanIndex( QVector<SIndexEntry> const& aIndex, QString const& sLowerPattern,
+                              std::function<void( SIndexEntry const& )> const& fnMatch );
+    static bool    MatchGlob( QChar const* pText, int nTextLength, QChar const* pPattern, int nPatternLength );
+    static QVariantMap MakeMatch( SObject const& oObject, int nCounter );
+    static QVariantMap MakeInstanceMatch( SObject const& oObject, int nInstance );
+
+private:
+    // Content, loaded from the storage file on first use
+    QString                         m_sStorageFilePath;
+    mutable QHash<QString, SObject> m_mapObjects;
+    mutable QVector<SIndexEntry>    m_aIndex;
+    mutable QVector<SIndexEntry>    m_aInstanceIndex;
+    mutable QReadWriteLock          m_oLock;
+    mutable bool                    m_bLoaded;
+
+    QThread*          m_pWorkerThread;
+    std::atomic<bool> m_bRebuildRunning;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // PERFCOUNTERCATALOG_H
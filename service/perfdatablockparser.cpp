@@ -0,0 +1,494 @@
+#include "perfdatablockparser.h"
+#include "commonexceptions.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+//
+//  Layout of winperf.h structures (byte offsets, identical for 32 and 64 bit builds)
+//
+namespace
+{
+// PERF_DATA_BLOCK
+const uint32_t c_nDataBlockSignature        = 0;
+const uint32_t c_nDataBlockTotalByteLength  = 20;
+const uint32_t c_nDataBlockHeaderLength     = 24;
+const uint32_t c_nDataBlockNumObjectTypes   = 28;
+const uint32_t c_nDataBlockPerfTime         = 56;
+const uint32_t c_nDataBlockPerfFreq         = 64;
+const uint32_t c_nDataBlockPerfTime100nSec  = 72;
+const uint32_t c_nDataBlockMinSize          = 88;
+
+// PERF_OBJECT_TYPE
+const uint32_t c_nObjectTotalByteLength     = 0;
+const uint32_t c_nObjectDefinitionLength    = 4;
+const uint32_t c_nObjectHeaderLength        = 8;
+const uint32_t c_nObjectNameTitleIndex      = 12;
+const uint32_t c_nObjectHelpTitleIndex      = 20;
+const uint32_t c_nObjectDetailLevel         = 28;
+const uint32_t c_nObjectNumCounters         = 32;
+const uint32_t c_nObjectDefaultCounter      = 36;
+const uint32_t c_nObjectNumInstances        = 40;
+const uint32_t c_nObjectCodePage            = 44;
+const uint32_t c_nObjectPerfTime            = 48;
+const uint32_t c_nObjectPerfFreq            = 56;
+const uint32_t c_nObjectMinSize             = 64;
+
+// PERF_COUNTER_DEFINITION
+const uint32_t c_nCounterByteLength         = 0;
+const uint32_t c_nCounterNameTitleIndex     = 4;
+const uint32_t c_nCounterHelpTitleIndex     = 12;
+const uint32_t c_nCounterDefaultScale       = 20;
+const uint32_t c_nCounterDetailLevel        = 24;
+const uint32_t c_nCounterCounterType        = 28;
+const uint32_t c_nCounterCounterSize        = 32;
+const uint32_t c_nCounterCounterOffset      = 36;
+const uint32_t c_nCounterMinSize            = 40;
+
+// PERF_INSTANCE_DEFINITION
+const uint32_t c_nInstanceByteLength        = 0;
+const uint32_t c_nInstanceParentObjectIndex = 4;
+const uint32_t c_nInstanceParentInstance    = 8;
+const uint32_t c_nInstanceUniqueID          = 12;
+const uint32_t c_nInstanceNameOffset        = 16;
+const uint32_t c_nInstanceNameLength        = 20;
+const uint32_t c_nInstanceMinSize           = 24;
+
+// PERF_COUNTER_BLOCK
+const uint32_t c_nCounterBlockMinSize       = 4;
+
+// name table indexes above this are rejected, real tables stay far below it
+const uint32_t c_nMaxNameIndex              = 0x100000;
+
+const int32_t  c_nPerfNoInstances           = -1;
+
+template <typename T>
+inline T ReadField( uint8_t const* pBase, uint32_t nOffset )
+{
+    T tValue;
+    std::memcpy( &tValue, pBase + nOffset, sizeof(T) );
+    return tValue;
+}
+
+// remove terminating zeros of instance name
+SPerfNameView MakeNameView( uint8_t const* pData, uint32_t nBytes, uint32_t nCodePage )
+{
+    SPerfNameView oView;
+    oView.pData     = pData;
+    oView.nCodePage = nCodePage;
+
+    if( nCodePage == 0 )
+    {
+        nBytes &= ~1u;
+        while( nBytes >= 2 && pData[nBytes - 1] == 0 && pData[nBytes - 2] == 0 )
+            nBytes -= 2;
+    }
+    else
+    {
+        while( nBytes >= 1 && pData[nBytes - 1] == 0 )
+            --nBytes;
+    }
+
+    oView.nBytes = nBytes;
+    return oView;
+}
+
+inline char16_t ToLowerAscii( char16_t ch )
+{
+    return (ch >= u'A' && ch <= u'Z')? char16_t( ch + (u'a' - u'A') ) : ch;
+}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+//
+//  class CPerfDataArena
+//
+CPerfDataArena::CPerfDataArena( size_t nChunkSize )
+    : m_nChunkSize( nChunkSize ),
+      m_nChunkOffset( 0 ),
+      m_nBytesAllocated( 0 )
+{
+    assert( nChunkSize > 0 );
+}
+
+void* CPerfDataArena::Allocate( size_t nSize, size_t nAlignment )
+{
+    assert( nAlignment > 0 && (nAlignment & (nAlignment - 1)) == 0 );
+
+    if( !m_aChunks.empty() )
+    {
+        SChunk& oChunk = m_aChunks.back();
+        size_t nAligned = (m_nChunkOffset + nAlignment - 1) & ~(nAlignment - 1);
+        if( nAligned + nSize <= oChunk.nSize )
+        {
+            m_nChunkOffset = nAligned + nSize;
+            m_nBytesAllocated += nSize;
+            return oChunk.pData.get() + nAligned;
+        }
+    }
+
+    // chunk memory comes from new[] so it is aligned for any fundamental type
+    AddChunk( nSize + nAlignment );
+    SChunk& oChunk = m_aChunks.back();
+    m_nChunkOffset = nSize;
+    m_nBytesAllocated += nSize;
+    return oChunk.pData.get();
+}
+
+void CPerfDataArena::Reset()
+{
+    if( m_aChunks.size() > 1 )
+    {
+        // replace with single chunk to fit the same content next time
+        size_t nTotalSize = 0;
+        for( SChunk const& oChunk : m_aChunks )
+            nTotalSize += oChunk.nSize;
+
+        m_aChunks.clear();
+        AddChunk( nTotalSize );
+    }
+
+    m_nChunkOffset = 0;
+    m_nBytesAllocated = 0;
+}
+
+size_t CPerfDataArena::GetBytesAllocated() const
+{
+    return m_nBytesAllocated;
+}
+
+void CPerfDataArena::AddChunk( size_t nMinSize )
+{
+    SChunk oChunk;
+    oChunk.nSize = std::max( nMinSize, m_nChunkSize );
+    oChunk.pData.reset( new char[oChunk.nSize] );
+    m_aChunks.push_back( std::move( oChunk ) );
+    m_nChunkOffset = 0;
+}
+////////////////////////////////////////////////////////////////////////////////////////
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Views
+//
+SPerfCounterDefinition const* SPerfObject::FindCounter( uint32_t nCounterNameIndex ) const
+{
+    for( uint32_t i = 0; i < nCounterCount; ++i )
+        if( pCounters[i].nNameIndex == nCounterNameIndex )
+            return &pCounters[i];
+    return nullptr;
+}
+
+SPerfObject const* SPerfDataSnapshot::FindObject( uint32_t nObjectNameIndex ) const
+{
+    for( uint32_t i = 0; i < nObjectCount; ++i )
+        if( pObjects[i].nNameIndex == nObjectNameIndex )
+            return &pObjects[i];
+    return nullptr;
+}
+
+SPerfInstance const* SPerfDataSnapshot::FindParentInstance( SPerfInstance const& oInstance ) const
+{
+    if( oInstance.nParentObjectIndex == 0 )
+        return nullptr;
+
+    SPerfObject const* pParentObject = FindObject( oInstance.nParentObjectIndex );
+    if( !pParentObject || oInstance.nParentInstance >= pParentObject->nInstanceCount )
+        return nullptr;
+
+    return &pParentObject->pInstances[oInstance.nParentInstance];
+}
+////////////////////////////////////////////////////////////////////////////////////////
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+//
+//  class CPerfDataBlockParser
+//
+CPerfDataBlockParser::CPerfDataBlockParser( CPerfDataArena& oArena )
+    : m_oArena( oArena )
+{
+}
+
+SPerfDataSnapshot CPerfDataBlockParser::Parse( void const* pData, size_t nSize )
+{
+    uint8_t const* pBlock = static_cast<uint8_t const*>( pData );
+    if( !pBlock || nSize < c_nDataBlockMinSize )
+        throw CPerfDataParseException( "data block is too small" );
+
+    static char16_t const c_aSignature[4] = { u'P', u'E', u'R', u'F' };
+    if( std::memcmp( pBlock + c_nDataBlockSignature, c_aSignature, sizeof(c_aSignature) ) != 0 )
+        throw CPerfDataParseException( "invalid data block signature" );
+
+    uint32_t nTotalLength  = ReadField<uint32_t>( pBlock, c_nDataBlockTotalByteLength );
+    uint32_t nHeaderLength = ReadField<uint32_t>( pBlock, c_nDataBlockHeaderLength );
+    uint32_t nObjectCount  = ReadField<uint32_t>( pBlock, c_nDataBlockNumObjectTypes );
+
+    if( nTotalLength > nSize )
+        throw CPerfDataParseException( "data block is truncated" );
+    if( nHeaderLength < c_nDataBlockMinSize || nHeaderLength > nTotalLength )
+        throw CPerfDataParseException( "invalid data block header length" );
+    // each object takes at least its header
+    if( nObjectCount > (nTotalLength - nHeaderLength) / c_nObjectMinSize )
+        throw CPerfDataParseException( "invalid object count" );
+
+    SPerfDataSnapshot oSnapshot;
+    oSnapshot.nPerfTime        = ReadField<int64_t>( pBlock, c_nDataBlockPerfTime );
+    oSnapshot.nPerfFreq        = ReadField<int64_t>( pBlock, c_nDataBlockPerfFreq );
+    oSnapshot.nPerfTime100nSec = ReadField<int64_t>( pBlock, c_nDataBlockPerfTime100nSec );
+
+    SPerfObject* pObjects = m_oArena.AllocateArray<SPerfObject>( nObjectCount );
+
+    uint32_t nOffset = nHeaderLength;
+    uint32_t nParsed = 0;
+    for( ; nParsed < nObjectCount && nOffset < nTotalLength; ++nParsed )
+    {
+        if( nTotalLength - nOffset < c_nObjectMinSize )
+            throw CPerfDataParseException( "object header is out of bounds" );
+
+        uint32_t nObjectLength = ReadField<uint32_t>( pBlock + nOffset, c_nObjectTotalByteLength );
+        if( nObjectLength < c_nObjectMinSize || nObjectLength > nTotalLength - nOffset )
+            throw CPerfDataParseException( "invalid object length" );
+
+        ParseObject( pBlock + nOffset, nObjectLength, pObjects[nParsed] );
+        nOffset += nObjectLength;
+    }
+
+    oSnapshot.pObjects     = pObjects;
+    oSnapshot.nObjectCount = nParsed;
+    return oSnapshot;
+}
+
+void CPerfDataBlockParser::ParseObject( uint8_t const* pObject, uint32_t nObjectLength, SPerfObject& oResult )
+{
+    uint32_t nDefinitionLength = ReadField<uint32_t>( pObject, c_nObjectDefinitionLength );
+    uint32_t nHeaderLength     = ReadField<uint32_t>( pObject, c_nObjectHeaderLength );
+    uint32_t nCounterCount     = ReadField<uint32_t>( pObject, c_nObjectNumCounters );
+    int32_t  nInstanceCount    = ReadField<int32_t>(  pObject, c_nObjectNumInstances );
+
+    if( nHeaderLength < c_nObjectMinSize || nHeaderLength > nDefinitionLength || nDefinitionLength > nObjectLength )
+        throw CPerfDataParseException( "invalid object definition length" );
+    if( nCounterCount > (nDefinitionLength - nHeaderLength) / c_nCounterMinSize )
+        throw CPerfDataParseException( "invalid counter count" );
+
+    oResult.nNameIndex      = ReadField<uint32_t>( pObject, c_nObjectNameTitleIndex );
+    oResult.nHelpIndex      = ReadField<uint32_t>( pObject, c_nObjectHelpTitleIndex );
+    oResult.nDetailLevel    = ReadField<uint32_t>( pObject, c_nObjectDetailLevel );
+    oResult.nDefaultCounter = ReadField<int32_t>(  pObject, c_nObjectDefaultCounter );
+    oResult.nCodePage       = ReadField<uint32_t>( pObject, c_nObjectCodePage );
+    oResult.nPerfTime       = ReadField<int64_t>(  pObject, c_nObjectPerfTime );
+    oResult.nPerfFreq       = ReadField<int64_t>(  pObject, c_nObjectPerfFreq );
+
+    //
+    //  Counter definitions
+    //
+    SPerfCounterDefinition* pCounters = m_oArena.AllocateArray<SPerfCounterDefinition>( nCounterCount );
+    uint32_t nOffset = nHeaderLength;
+    for( uint32_t i = 0; i < nCounterCount; ++i )
+    {
+        if( nDefinitionLength - nOffset < c_nCounterMinSize )
+            throw CPerfDataParseException( "counter definition is out of bounds" );
+
+        uint8_t const* pCounter = pObject + nOffset;
+        uint32_t nCounterLength = ReadField<uint32_t>( pCounter, c_nCounterByteLength );
+        if( nCounterLength < c_nCounterMinSize || nCounterLength > nDefinitionLength - nOffset )
+            throw CPerfDataParseException( "invalid counter definition length" );
+
+        SPerfCounterDefinition& oCounter = pCounters[i];
+        oCounter.nNameIndex    = ReadField<uint32_t>( pCounter, c_nCounterNameTitleIndex );
+        oCounter.nHelpIndex    = ReadField<uint32_t>( pCounter, c_nCounterHelpTitleIndex );
+        oCounter.nDefaultScale = ReadField<int32_t>(  pCounter, c_nCounterDefaultScale );
+        oCounter.nDetailLevel  = ReadField<uint32_t>( pCounter, c_nCounterDetailLevel );
+        oCounter.nCounterType  = ReadField<uint32_t>( pCounter, c_nCounterCounterType );
+        oCounter.nSize         = ReadField<uint32_t>( pCounter, c_nCounterCounterSize );
+        oCounter.nOffset       = ReadField<uint32_t>( pCounter, c_nCounterCounterOffset );
+
+        nOffset += nCounterLength;
+    }
+    oResult.pCounters     = pCounters;
+    oResult.nCounterCount = nCounterCount;
+
+    //
+    //  Instances and counter data
+    //
+    oResult.bHasInstances      = nInstanceCount != c_nPerfNoInstances;
+    oResult.pInstances         = nullptr;
+    oResult.nInstanceCount     = 0;
+    oResult.pCounterData       = nullptr;
+    oResult.nCounterDataLength = 0;
+
+    nOffset = nDefinitionLength;
+    if( !oResult.bHasInstances )
+    {
+        if( nObjectLength - nOffset < c_nCounterBlockMinSize )
+            throw CPerfDataParseException( "counter block is out of bounds" );
+
+        uint32_t nBlockLength = ReadField<uint32_t>( pObject + nOffset, 0 );
+        if( nBlockLength < c_nCounterBlockMinSize || nBlockLength > nObjectLength - nOffset )
+            throw CPerfDataParseException( "invalid counter block length" );
+
+        oResult.pCounterData       = pObject + nOffset;
+        oResult.nCounterDataLength = nBlockLength;
+        return;
+    }
+
+    if( nInstanceCount < 0
+            || uint32_t(nInstanceCount) > (nObjectLength - nDefinitionLength) / (c_nInstanceMinSize + c_nCounterBlockMinSize) )
+        throw CPerfDataParseException( "invalid instance count" );
+
+    SPerfInstance* pInstances = m_oArena.AllocateArray<SPerfInstance>( uint32_t(nInstanceCount) );
+    for( int32_t i = 0; i < nInstanceCount; ++i )
+    {
+        if( nObjectLength - nOffset < c_nInstanceMinSize )
+            throw CPerfDataParseException( "instance definition is out of bounds" );
+
+        uint8_t const* pInstance = pObject + nOffset;
+        uint32_t nInstanceLength = ReadField<uint32_t>( pInstance, c_nInstanceByteLength );
+        if( nInstanceLength < c_nInstanceMinSize || nInstanceLength > nObjectLength - nOffset - c_nCounterBlockMinSize )
+            throw CPerfDataParseException( "invalid instance definition length" );
+
+        uint32_t nNameOffset = ReadField<uint32_t>( pInstance, c_nInstanceNameOffset );
+        uint32_t nNameLength = ReadField<uint32_t>( pInstance, c_nInstanceNameLength );
+        if( nNameOffset > nInstanceLength || nNameLength > nInstanceLength - nNameOffset )
+            throw CPerfDataParseException( "instance name is out of bounds" );
+
+        SPerfInstance& oInstance = pInstances[i];
+        oInstance.oName              = MakeNameView( pInstance + nNameOffset, nNameLength, oResult.nCodePage );
+        oInstance.nParentObjectIndex = ReadField<uint32_t>( pInstance, c_nInstanceParentObjectIndex );
+        oInstance.nParentInstance    = ReadField<uint32_t>( pInstance, c_nInstanceParentInstance );
+        oInstance.nUniqueId          = ReadField<int32_t>(  pInstance, c_nInstanceUniqueID );
+
+        nOffset += nInstanceLength;
+        uint32_t nBlockLength = ReadField<uint32_t>( pObject + nOffset, 0 );
+        if( nBlockLength < c_nCounterBlockMinSize || nBlockLength > nObjectLength - nOffset )
+            throw CPerfDataParseException( "invalid instance counter block length" );
+
+        oInstance.pCounterData       = pObject + nOffset;
+        oInstance.nCounterDataLength = nBlockLength;
+        nOffset += nBlockLength;
+    }
+
+    oResult.pInstances     = pInstances;
+    oResult.nInstanceCount = uint32_t(nInstanceCount);
+}
+
+bool CPerfDataBlockParser::ReadCounterValue( SPerfCounterDefinition const& oCounter,
+                                             uint8_t const* pCounterData,
+                                             uint32_t nCounterDataLength,
+                                             uint64_t& nValue )
+{
+    if( !pCounterData || oCounter.nOffset > nCounterDataLength
+            || oCounter.nSize > nCounterDataLength - oCounter.nOffset )
+        return false;
+
+    if( oCounter.nSize == sizeof(uint32_t) )
+    {
+        nValue = ReadField<uint32_t>( pCounterData, oCounter.nOffset );
+        return true;
+    }
+
+    if( oCounter.nSize == sizeof(uint64_t) )
+    {
+        nValue = ReadField<uint64_t>( pCounterData, oCounter.nOffset );
+        return true;
+    }
+
+    // zero length and variable length counters carry no numeric value
+    return false;
+}
+
+bool CPerfDataBlockParser::IsBaseCounter( uint32_t nCounterType )
+{
+    // PERF_TYPE_COUNTER | PERF_COUNTER_BASE
+    return (nCounterType & 0x00000C00) == 0x00000400
+        && (nCounterType & 0x00070000) == 0x00030000;
+}
+////////////////////////////////////////////////////////////////////////////////////////
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+//
+//  class CPerfNameTable
+//
+void CPerfNameTable::Load( void const* pData, size_t nSize )
+{
+    Clear();
+
+    uint8_t const* pBytes = static_cast<uint8_t const*>( pData );
+    size_t nCharCount = nSize / sizeof(char16_t);
+
+    // reads next zero terminated string, returns false at the end of MULTI_SZ
+    size_t nPos = 0;
+    auto fnNextString = [&]( size_t& nStart, size_t& nLength ) -> bool
+    {
+        nStart = nPos;
+        while( nPos < nCharCount && ReadField<char16_t>( pBytes, uint32_t(nPos * 2) ) != 0 )
+            ++nPos;
+        nLength = nPos - nStart;
+        if( nPos < nCharCount )
+            ++nPos; // skip terminator
+        return nLength > 0;
+    };
+
+    size_t nIndexStart, nIndexLength, nTextStart, nTextLength;
+    while( fnNextString( nIndexStart, nIndexLength ) )
+    {
+        if( !fnNextString( nTextStart, nTextLength ) )
+            break;
+
+        uint32_t nIndex = 0;
+        bool bIsNumber = nIndexLength <= 9;
+        for( size_t i = 0; bIsNumber && i < nIndexLength; ++i )
+        {
+            char16_t ch = ReadField<char16_t>( pBytes, uint32_t((nIndexStart + i) * 2) );
+            bIsNumber = ch >= u'0' && ch <= u'9';
+            nIndex = nIndex * 10 + uint32_t(ch - u'0');
+        }
+        if( !bIsNumber || nIndex > c_nMaxNameIndex )
+            continue;
+
+        if( nIndex >= m_aNames.size() )
+            m_aNames.resize( nIndex + 1 );
+
+        m_aNames[nIndex] = MakeNameView( pBytes + nTextStart * 2, uint32_t(nTextLength * 2), 0 );
+    }
+}
+
+void CPerfNameTable::Clear()
+{
+    m_aNames.clear();
+}
+
+SPerfNameView CPerfNameTable::Get( uint32_t nIndex ) const
+{
+    if( nIndex < m_aNames.size() )
+        return m_aNames[nIndex];
+    return SPerfNameView();
+}
+
+uint32_t CPerfNameTable::FindIndex( char16_t const* szName, uint32_t nLength ) const
+{
+    for( uint32_t nIndex = 0; nIndex < m_aNames.size(); ++nIndex )
+    {
+        SPerfNameView const& oName = m_aNames[nIndex];
+        if( oName.GetLength() != nLength )
+            continue;
+
+        bool bEqual = true;
+        for( uint32_t i = 0; bEqual && i < nLength; ++i )
+            bEqual = ToLowerAscii( ReadField<char16_t>( oName.pData, i * 2 ) ) == ToLowerAscii( szName[i] );
+
+        if( bEqual )
+            return nIndex;
+    }
+    return 0;
+}
+
+uint32_t CPerfNameTable::GetMaxIndex() const
+{
+    return m_aNames.empty()? 0 : uint32_t( m_aNames.size() - 1 );
+}
+////////////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,240 @@
+#ifndef PERFDATABLOCKPARSER_H
+#define PERFDATABLOCKPARSER_H
+
+//
+//  Includes
+//
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+//
+//  NOTE: This unit does not depend on <windows.h>. The PERF_* structures are read
+//  by their documented (winperf.h) field offsets, so captured HKEY_PERFORMANCE_DATA
+//  blocks can be parsed on any platform.
+//
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CPerfDataArena
+///
+/// Monotonic allocator for parsed performance data. Memory is handed out from
+/// chunks and released all at once by Reset() or destruction.
+///
+class CPerfDataArena
+{
+public:
+    explicit CPerfDataArena( size_t nChunkSize = 64 * 1024 );
+    CPerfDataArena( CPerfDataArena const& ) = delete;
+    CPerfDataArena& operator=( CPerfDataArena const& ) = delete;
+
+public:
+    void*  Allocate( size_t nSize, size_t nAlignment = alignof(std::max_align_t) );
+    template <typename T>
+    T*     AllocateArray( size_t nCount );
+
+    // Drops all allocations. Keeps one chunk large enough for the previous content
+    void   Reset();
+    size_t GetBytesAllocated() const;
+
+private:
+    void AddChunk( size_t nMinSize );
+
+private:
+    struct SChunk
+    {
+        std::unique_ptr<char[]> pData;
+        size_t                  nSize;
+    };
+
+    // Content
+    std::vector<SChunk> m_aChunks;
+    size_t              m_nChunkSize;
+    size_t              m_nChunkOffset;
+    size_t              m_nBytesAllocated;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// Zero-copy views over a parsed PERF_DATA_BLOCK
+///
+/// All pointers refer either to the source buffer or to the arena used for parsing,
+/// so both must outlive the views.
+///
+
+// Instance or counter name. Not null terminated
+struct SPerfNameView
+{
+    uint8_t const* pData     = nullptr;
+    uint32_t       nBytes    = 0;
+    uint32_t       nCodePage = 0;   // 0 - UTF-16LE, otherwise multi-byte string in this code page
+
+    inline bool     IsEmpty() const;
+    inline bool     IsUnicode() const;
+    inline uint32_t GetLength() const;  // in characters for UTF-16, in bytes otherwise
+    inline bool     operator==( SPerfNameView const& oOther ) const;
+    inline bool     operator!=( SPerfNameView const& oOther ) const;
+};
+
+struct SPerfCounterDefinition
+{
+    uint32_t nNameIndex;
+    uint32_t nHelpIndex;
+    int32_t  nDefaultScale;
+    uint32_t nDetailLevel;
+    uint32_t nCounterType;
+    uint32_t nSize;
+    uint32_t nOffset;
+};
+
+struct SPerfInstance
+{
+    SPerfNameView  oName;
+    uint32_t       nParentObjectIndex;
+    uint32_t       nParentInstance;
+    int32_t        nUniqueId;
+    uint8_t const* pCounterData;        // PERF_COUNTER_BLOCK of the instance
+    uint32_t       nCounterDataLength;
+};
+
+struct SPerfObject
+{
+    uint32_t nNameIndex;
+    uint32_t nHelpIndex;
+    uint32_t nDetailLevel;
+    uint32_t nCodePage;
+    int32_t  nDefaultCounter;
+    int64_t  nPerfTime;
+    int64_t  nPerfFreq;
+
+    SPerfCounterDefinition const* pCounters;
+    uint32_t                      nCounterCount;
+
+    // false for single instance objects (NumInstances == PERF_NO_INSTANCES)
+    bool                 bHasInstances;
+    SPerfInstance const* pInstances;
+    uint32_t             nInstanceCount;
+
+    // PERF_COUNTER_BLOCK of single instance objects
+    uint8_t const* pCounterData;
+    uint32_t       nCounterDataLength;
+
+    SPerfCounterDefinition const* FindCounter( uint32_t nCounterNameIndex ) const;
+};
+
+struct SPerfDataSnapshot
+{
+    int64_t nPerfTime        = 0;
+    int64_t nPerfFreq        = 0;
+    int64_t nPerfTime100nSec = 0;
+
+    SPerfObject const* pObjects     = nullptr;
+    uint32_t           nObjectCount = 0;
+
+    SPerfObject const*   FindObject( uint32_t nObjectNameIndex ) const;
+    // Returns NULL if instance has no parent or parent is not found in the snapshot
+    SPerfInstance const* FindParentInstance( SPerfInstance const& oInstance ) const;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CPerfDataBlockParser
+///
+/// Parses PERF_DATA_BLOCK returned by HKEY_PERFORMANCE_DATA queries. Every structure
+/// is bounds checked against the buffer size, CPerfDataParseException is thrown on
+/// malformed data. The parser keeps no state besides the arena it allocates from,
+/// so separate parser/arena pairs may run concurrently.
+///
+class CPerfDataBlockParser
+{
+public:
+    explicit CPerfDataBlockParser( CPerfDataArena& oArena );
+
+public:
+    SPerfDataSnapshot Parse( void const* pData, size_t nSize );
+
+    // Reads raw counter value from counter block. Returns false if out of bounds
+    static bool ReadCounterValue( SPerfCounterDefinition const& oCounter,
+                                  uint8_t const* pCounterData,
+                                  uint32_t nCounterDataLength,
+                                  uint64_t& nValue );
+    static bool IsBaseCounter( uint32_t nCounterType );
+
+private:
+    void ParseObject( uint8_t const* pObject, uint32_t nObjectLength, SPerfObject& oResult );
+
+private:
+    CPerfDataArena& m_oArena;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CPerfNameTable
+///
+/// Index to text table over MULTI_SZ value of HKEY_PERFORMANCE_TEXT/NLSTEXT
+/// ("Counter" or "Help"). Keeps views into the source buffer. Entries with
+/// an implausibly large index are skipped, the table is a dense array.
+///
+class CPerfNameTable
+{
+public:
+    CPerfNameTable() = default;
+
+public:
+    void Load( void const* pData, size_t nSize );
+    void Clear();
+
+    SPerfNameView Get( uint32_t nIndex ) const;
+    // Case-insensitive (ASCII) lookup. Returns 0 if not found
+    uint32_t FindIndex( char16_t const* szName, uint32_t nLength ) const;
+    uint32_t GetMaxIndex() const;
+
+private:
+    std::vector<SPerfNameView> m_aNames;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// Inline Implementations
+///
+////////////////////////////////////////////////////////////////////////////////////////
+template <typename T>
+T* CPerfDataArena::AllocateArray( size_t nCount )
+{
+    static_assert( std::is_trivially_destructible<T>::value, "Arena does not run destructors" );
+    if( nCount == 0 )
+        return nullptr;
+    T* pArray = static_cast<T*>( Allocate( sizeof(T) * nCount, alignof(T) ) );
+    for( size_t i = 0; i < nCount; ++i )
+        new (pArray + i) T();
+    return pArray;
+}
+
+inline bool     SPerfNameView::IsEmpty() const   { return nBytes == 0; }
+inline bool     SPerfNameView::IsUnicode() const { return nCodePage == 0; }
+inline uint32_t SPerfNameView::GetLength() const { return IsUnicode()? nBytes / 2 : nBytes; }
+
+inline bool SPerfNameView::operator==( SPerfNameView const& oOther ) const
+{
+    if( nBytes != oOther.nBytes || nCodePage != oOther.nCodePage )
+        return false;
+    for( uint32_t i = 0; i < nBytes; ++i )
+        if( pData[i] != oOther.pData[i] )
+            return false;
+    return true;
+}
+
+inline bool SPerfNameView::operator!=( SPerfNameView const& oOther ) const { return !(*this == oOther); }
+
+#endif // PERFDATABLOCKPARSER_H
@@ -0,0 +1,93 @@
+#include "perfdatablocksource.h"
+#include "performancecountersinfoprovider.h"
+#include "exception.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+namespace
+{
+const char* const c_szCounterNamesFile  = "counter_names.bin";
+const char* const c_szDataBlockPrefix   = "perf_data_";
+const char* const c_szDataBlockSuffix   = ".bin";
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+//
+//  class CRegistryPerfDataBlockSource
+//
+void CRegistryPerfDataBlockSource::ReadDataBlock( QString const& sObjectIndexes, QByteArray& aBuffer )
+{
+    CPerformanceCountersInfoProvider::ReadPerformanceData( sObjectIndexes, aBuffer );
+}
+
+QByteArray CRegistryPerfDataBlockSource::ReadCounterNames()
+{
+    return CPerformanceCountersInfoProvider::ReadPerformanceText( "Counter", false );
+}
+////////////////////////////////////////////////////////////////////////////////////////
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+//
+//  class CRecordedPerfDataBlockSource
+//
+CRecordedPerfDataBlockSource::CRecordedPerfDataBlockSource( QString const& sDirPath )
+    : m_sDirPath( sDirPath ),
+      m_nNextBlock( 0 )
+{
+    QDir oDir( m_sDirPath );
+    QStringList lstFiles = oDir.entryList( QStringList() << QString( "%1*%2" ).arg( c_szDataBlockPrefix, c_szDataBlockSuffix ),
+                                          QDir::Files, QDir::Name );
+    for( QString const& sFile : lstFiles )
+        m_lstBlockFiles.append( oDir.absoluteFilePath( sFile ) );
+
+    if( m_lstBlockFiles.isEmpty() )
+        throw CException( "No recorded performance data blocks found in " + m_sDirPath );
+}
+
+void CRecordedPerfDataBlockSource::ReadDataBlock( QString const& sObjectIndexes, QByteArray& aBuffer )
+{
+    Q_UNUSED( sObjectIndexes );
+    aBuffer = ReadFile( m_lstBlockFiles[m_nNextBlock] );
+    m_nNextBlock = (m_nNextBlock + 1) % m_lstBlockFiles.size();
+}
+
+QByteArray CRecordedPerfDataBlockSource::ReadCounterNames()
+{
+    return ReadFile( QDir( m_sDirPath ).absoluteFilePath( c_szCounterNamesFile ) );
+}
+
+void CRecordedPerfDataBlockSource::SaveDataBlock( QString const& sDirPath, int nSequenceNumber, QByteArray const& aData )
+{
+    QString sFileName = QString( "%1%2%3" ).arg( c_szDataBlockPrefix )
+                                           .arg( nSequenceNumber, 6, 10, QChar('0') )
+                                           .arg( c_szDataBlockSuffix );
+    WriteFile( QDir( sDirPath ).absoluteFilePath( sFileName ), aData );
+}
+
+void CRecordedPerfDataBlockSource::SaveCounterNames( QString const& sDirPath, QByteArray const& aData )
+{
+    WriteFile( QDir( sDirPath ).absoluteFilePath( c_szCounterNamesFile ), aData );
+}
+
+QByteArray CRecordedPerfDataBlockSource::ReadFile( QString const& sFilePath )
+{
+    QFile oFile( sFilePath );
+    if( !oFile.open( QFile::ReadOnly ) )
+        throw CException( "Failed to open file for reading: " + sFilePath );
+    return oFile.readAll();
+}
+
+void CRecordedPerfDataBlockSource::WriteFile( QString const& sFilePath, QByteArray const& aData )
+{
+    QDir().mkpath( QFileInfo( sFilePath ).absolutePath() );
+
+    QFile oFile( sFilePath );
+    if( !oFile.open( QFile::WriteOnly | QFile::Truncate ) )
+        throw CException( "Failed to open file for writing: " + sFilePath );
+    oFile.write( aData );
+}
+////////////////////////////////////////////////////////////////////////////////////////
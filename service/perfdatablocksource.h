@@ -0,0 +1,86 @@
+#ifndef PERFDATABLOCKSOURCE_H
+#define PERFDATABLOCKSOURCE_H
+
+//
+//  Includes
+//
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <memory>
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// Interface IPerfDataBlockSource
+///
+/// Source of raw PERF_DATA_BLOCKs and English counter name tables
+///
+class IPerfDataBlockSource
+{
+public:
+    virtual ~IPerfDataBlockSource() = default;
+
+public:
+    // Fills buffer with data block for the space separated object indexes.
+    // Buffer capacity is reused between calls
+    virtual void       ReadDataBlock( QString const& sObjectIndexes, QByteArray& aBuffer ) = 0;
+    // MULTI_SZ "index\0name\0..." table of English counter and object names
+    virtual QByteArray ReadCounterNames() = 0;
+};
+
+using PerfDataBlockSourceSPtr = std::shared_ptr<IPerfDataBlockSource>;
+////////////////////////////////////////////////////////////////////////////////////////
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CRegistryPerfDataBlockSource
+///
+/// Reads live data through HKEY_PERFORMANCE_DATA
+///
+class CRegistryPerfDataBlockSource : public IPerfDataBlockSource
+{
+public:
+    CRegistryPerfDataBlockSource() = default;
+
+public:
+    void       ReadDataBlock( QString const& sObjectIndexes, QByteArray& aBuffer ) override;
+    QByteArray ReadCounterNames() override;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CRecordedPerfDataBlockSource
+///
+/// Replays data blocks captured into a directory: counter_names.bin holds the
+/// name table, perf_data_*.bin files are returned one per read in name order,
+/// wrapping around at the end. Requested object indexes are ignored.
+///
+class CRecordedPerfDataBlockSource : public IPerfDataBlockSource
+{
+public:
+    explicit CRecordedPerfDataBlockSource( QString const& sDirPath );
+
+public:
+    void       ReadDataBlock( QString const& sObjectIndexes, QByteArray& aBuffer ) override;
+    QByteArray ReadCounterNames() override;
+
+    // Stores block for later replay
+    static void SaveDataBlock( QString const& sDirPath, int nSequenceNumber, QByteArray const& aData );
+    static void SaveCounterNames( QString const& sDirPath, QByteArray const& aData );
+
+private:
+    static QByteArray ReadFile( QString const& sFilePath );
+    static void       WriteFile( QString const& sFilePath, QByteArray const& aData );
+
+private:
+    // Content
+    QString     m_sDirPath;
+    QStringList m_lstBlockFiles;
+    int         m_nNextBlock;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // PERFDATABLOCKSOURCE_H
@@ -3,12 +3,18 @@
 #include "performancecountersinfoprovider.h"
 #include "winperformancemetricschecker.h"
 
+#include <QCryptographicHash>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QTextStream>
 
 
 CPerformanceCounterInfoDumper::CPerformanceCounterInfoDumper()
+    : m_pWorkerThread( nullptr ),
+      m_bDumpRunning( false )
 {
     AddToFilter( "Process" );
     AddToFilter( "Thread" );
@@ -22,67 +28,222 @@ CPerformanceCounterInfoDumper &CPerformanceCounterInfoDumper::Instance()
     return oInst;
 }
 
-void CPerformanceCounterInfoDumper::DumpCountersInfo()
+CPerformanceCounterInfoDumper::~CPerformanceCounterInfoDumper()
 {
+    if( m_pWorkerThread )
+    {
+        m_pWorkerThread->quit();
+        m_pWorkerThread->wait();
+        delete m_pWorkerThread;
+    }
+}
 
-    PerformanceObjectsInfoList lstCounters = CPerformanceCountersInfoProvider::RetrieveCountersInfo();
-    Q_ASSERT(!m_sDumpFileName.isEmpty());
+bool CPerformanceCounterInfoDumper::StartDumpCountersInfo( EPerfCountersDumpMode eMode )
+{
+    bool bExpected = false;
+    if( !m_bDumpRunning.compare_exchange_strong( bExpected, true ) )
+        return false;
 
-    QFile oFile(m_sDumpFileName);
-    if( !oFile.open(QFile::WriteOnly | QFile::Truncate |QIODevice::Append) )
+    if( !m_pWorkerThread )
     {
-        throw CException("Failed to open file for writing: " + m_sDumpFileName);
+        // created on demand: the instance exists before the application object
+        m_pWorkerThread = new QThread();
+        moveToThread( m_pWorkerThread );
+        bool bOK = connect( this, &CPerformanceCounterInfoDumper::sigStartDump,
+                            this, &CPerformanceCounterInfoDumper::onStartDump, Qt::QueuedConnection );
+        Q_ASSERT(bOK);
+        Q_UNUSED(bOK);
+        m_pWorkerThread->start( QThread::LowPriority );
     }
 
-    QTextStream out(&oFile);
+    emit sigStartDump( static_cast<int>(eMode) );
+    return true;
+}
+
+bool CPerformanceCounterInfoDumper::IsDumpRunning() const
+{
+    return m_bDumpRunning;
+}
+
+void CPerformanceCounterInfoDumper::onStartDump( int nMode )
+{
+    try
+    {
+        DumpCountersInfo( static_cast<EPerfCountersDumpMode>(nMode) );
+    }
+    catch( std::exception const& oExc )
+    {
+        emit sigDumpFailed( oExc.what() );
+    }
+    catch( ... )
+    {
+        emit sigDumpFailed( "Unknown exception" );
+    }
+    m_bDumpRunning = false;
+}
+
+void CPerformanceCounterInfoDumper::DumpCountersInfo( EPerfCountersDumpMode eMode )
+{
+    Q_ASSERT(!m_sDumpFileName.isEmpty());
+
+    if( eMode == EPerfCountersDumpMode::Incremental && m_mapManifest.isEmpty() )
+        LoadManifest();
+
+    QHash<QString, SManifestEntry> mapNewManifest;
+    QStringList lstFragments;
+    int nRewritten = 0;
+    int nLastPercent = -1;
+
+    auto fnFilter = [this]( QString const& sObjectName ) { return !m_setFilter.contains( sObjectName ); };
+
+    CPerformanceCountersInfoProvider::EnumerateCountersInfo(
+                [&]( SPerformanceObjectInfo const& oObject, int nIndex, int nCount )
+    {
+        SManifestEntry oEntry;
+        oEntry.aSignature    = CPerformanceCountersInfoProvider::MakeSignature( oObject );
+        oEntry.sFragmentPath = MakeFragmentPath( oObject.sName );
+
+        auto it = m_mapManifest.find( oObject.sName );
+        bool bUnchanged = eMode == EPerfCountersDumpMode::Incremental
+                && it != m_mapManifest.end()
+                && it->aSignature == oEntry.aSignature
+                && QFile::exists( oEntry.sFragmentPath );
+        if( !bUnchanged )
+        {
+            WriteObjectFragment( oObject, oEntry.sFragmentPath );
+            ++nRewritten;
+        }
+
+        lstFragments.append( oEntry.sFragmentPath );
+        mapNewManifest.insert( oObject.sName, oEntry );
+
+        int nPercent = (nIndex + 1) * 100 / nCount;
+        if( nPercent != nLastPercent )
+        {
+            nLastPercent = nPercent;
+            emit sigDumpProgress( nIndex + 1, nCount, oObject.sName );
+        }
+    }, fnFilter );
+
+    // remove fragments of disappeared objects
+    for( auto it = m_mapManifest.begin(); it != m_mapManifest.end(); ++it )
+        if( !mapNewManifest.contains( it.key() ) )
+            QFile::remove( it->sFragmentPath );
 
-    out << "Metric, Description" << "\r\n\r\n";
+    m_mapManifest = mapNewManifest;
+    AssembleDumpFile( lstFragments );
+    SaveManifest();
 
-    QStringList a = m_setFilter.toList();
+    emit sigDumpFinished( m_sDumpFileName, nRewritten, lstFragments.size() );
+}
 
-    for( int i = 0; i < lstCounters.size(); ++i )
+void CPerformanceCounterInfoDumper::WriteObjectFragment( SPerformanceObjectInfo const& oObject, QString const& sFilePath )
+{
+    QFile oFile( sFilePath );
+    if( !oFile.open( QFile::WriteOnly | QFile::Truncate ) )
     {
-        SPerformanceObjectInfo& oObject = lstCounters[i];
+        throw CException("Failed to open file for writing: " + sFilePath);
+    }
 
-        // Filter
-        if( m_setFilter.contains( oObject.sName ) )
-            continue;
+    QTextStream out(&oFile);
+
+    out << oObject.sName;
+    if(!oObject.sDescription.contains( "not available", Qt::CaseInsensitive ))
+        out << " - " << oObject.sDescription << "\r\n";
+    else
+        out << "\r\n";
+
+    // append counter paths
+    for( SCounterInfo const& oCounter : oObject.lstCounters )
+    {
+        // metric name does not depend on instance
+        QString sCounterPath = QString("\\\\%1\\\\%2").arg( oObject.sName, oCounter.sPath );
+        QString sMetricName = CWinPerformanceMetricsChecker::MakeMetricNameFromCounterPath( sCounterPath );
 
-        out << oObject.sName;
-        if(!oObject.sDescription.contains( "not available", Qt::CaseInsensitive ))
-            out << " - " << oObject.sDescription << "\r\n";
+        if( oObject.lstInstances.isEmpty() )
+        {
+            out << sMetricName << " = " << sCounterPath << "," << oCounter.sDescription << "\r\n";
+        }
         else
-            out << "\r\n";
+        {
+            QString sPathPrefix = QString("\\\\%1(").arg( oObject.sName );
+            QString sPathSuffix = QString(")\\\\%1,%2\r\n").arg( oCounter.sPath, oCounter.sDescription );
+            for( QString const& sInstanceName : oObject.lstInstances )
+                out << sMetricName << " = " << sPathPrefix << sInstanceName << sPathSuffix;
+        }
+    }
+    out << "\r\n";
+}
+
+void CPerformanceCounterInfoDumper::AssembleDumpFile( QStringList const& lstFragments )
+{
+    QFile oFile(m_sDumpFileName);
+    if( !oFile.open(QFile::WriteOnly | QFile::Truncate) )
+    {
+        throw CException("Failed to open file for writing: " + m_sDumpFileName);
+    }
 
-        // append counter paths
+    oFile.write( "Metric, Description\r\n\r\n" );
 
-        for( int j = 0; j < oObject.lstCounters.size(); ++j )
+    QByteArray aChunk;
+    for( QString const& sFragment : lstFragments )
+    {
+        QFile oFragment( sFragment );
+        if( !oFragment.open( QFile::ReadOnly ) )
+            throw CException("Failed to open file for reading: " + sFragment);
+
+        while( !oFragment.atEnd() )
         {
-            if( oObject.lstInstances.isEmpty() )
-            {
-                QString sPath = QString("\\\\%1\\\\%2").arg(oObject.sName).arg(oObject.lstCounters[j].sPath);
-                QString sMetricName = CWinPerformanceMetricsChecker::MakeMetricNameFromCounterPath( sPath );
-                out << sMetricName <<" = " << sPath << "," << oObject.lstCounters[j].sDescription << "\r\n";
-            }
-            else
-            {
-                for( QString sInstanceName : oObject.lstInstances )
-                {
-
-                    QString sPath = QString("\\\\%1(%3)\\\\%2")
-                            .arg(oObject.sName,
-                                 oObject.lstCounters[j].sPath,
-                                 sInstanceName)
-                            ;
-                    QString sMetricName = CWinPerformanceMetricsChecker::MakeMetricNameFromCounterPath( sPath );
-                    out << sMetricName <<" = " << sPath << "," << oObject.lstCounters[j].sDescription << "\r\n";
-                }
-            }
+            aChunk = oFragment.read( 64 * 1024 );
+            oFile.write( aChunk );
         }
-        out << "\r\n";
     }
 }
 
+void CPerformanceCounterInfoDumper::LoadManifest()
+{
+    QFile oFile( m_sManifestFileName );
+    if( !oFile.open( QFile::ReadOnly ) )
+        return;
+
+    QJsonObject oObjects = QJsonDocument::fromJson( oFile.readAll() ).object().value( "objects" ).toObject();
+    for( auto it = oObjects.begin(); it != oObjects.end(); ++it )
+    {
+        QJsonObject oEntryJson = it.value().toObject();
+        SManifestEntry oEntry;
+        oEntry.aSignature    = oEntryJson.value( "signature" ).toString().toLatin1();
+        oEntry.sFragmentPath = QDir( m_sFragmentsDirPath ).absoluteFilePath( oEntryJson.value( "fragment" ).toString() );
+        m_mapManifest.insert( it.key(), oEntry );
+    }
+}
+
+void CPerformanceCounterInfoDumper::SaveManifest()
+{
+    QJsonObject oObjects;
+    for( auto it = m_mapManifest.begin(); it != m_mapManifest.end(); ++it )
+    {
+        QJsonObject oEntryJson;
+        oEntryJson["signature"] = QString::fromLatin1( it->aSignature );
+        oEntryJson["fragment"]  = QFileInfo( it->sFragmentPath ).fileName();
+        oObjects[it.key()] = oEntryJson;
+    }
+
+    QJsonObject oManifest;
+    oManifest["objects"] = oObjects;
+
+    QFile oFile( m_sManifestFileName );
+    if( !oFile.open( QFile::WriteOnly | QFile::Truncate ) )
+        throw CException("Failed to open file for writing: " + m_sManifestFileName);
+    oFile.write( QJsonDocument( oManifest ).toJson( QJsonDocument::Compact ) );
+}
+
+QString CPerformanceCounterInfoDumper::MakeFragmentPath( QString const& sObjectName ) const
+{
+    // object names may contain characters not allowed in file names
+    QByteArray aHash = QCryptographicHash::hash( sObjectName.toUtf8(), QCryptographicHash::Sha1 ).toHex();
+    return QDir( m_sFragmentsDirPath ).absoluteFilePath( QString::fromLatin1( aHash ) + ".csv" );
+}
+
 void CPerformanceCounterInfoDumper::SetDumpDirPath(const QString &sPath)
 {
     Q_ASSERT( !sPath.isEmpty() );
@@ -93,6 +254,10 @@ void CPerformanceCounterInfoDumper::SetDumpDirPath(const QString &sPath)
     }
 
     m_sDumpFileName = oDir.absoluteFilePath( "available_performance_counters.csv" );
+
+    m_sFragmentsDirPath = oDir.absoluteFilePath( "objects" );
+    oDir.mkpath( m_sFragmentsDirPath );
+    m_sManifestFileName = QDir( m_sFragmentsDirPath ).absoluteFilePath( "manifest.json" );
 }
 
 QString CPerformanceCounterInfoDumper::GetDumpFilePath() const
@@ -121,5 +286,3 @@ bool CPerformanceCounterInfoDumper::ContainesOneOf(const QString &sSourceString,
             return true;
     return false;
 }
-
-
@@ -1,29 +1,86 @@
 #ifndef CPERFORMANCECOUNTERINFODUMPER_H
 #define CPERFORMANCECOUNTERINFODUMPER_H
 
+#include <QHash>
+#include <QObject>
 #include <QSet>
 #include <QString>
+#include <QThread>
+#include <atomic>
 
-class CPerformanceCounterInfoDumper
+struct SPerformanceObjectInfo;
+
+enum class EPerfCountersDumpMode
+{
+    Full,           // rewrite everything
+    Incremental     // rewrite objects whose counter or instance set changed since the last dump
+};
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CPerformanceCounterInfoDumper
+///
+/// Writes available performance counters into a CSV file. Every object is kept
+/// in a separate fragment file, the CSV is assembled from the fragments, so the
+/// incremental dump formats only changed objects. Dumps run in a worker thread.
+///
+class CPerformanceCounterInfoDumper : public QObject
 {
+    Q_OBJECT
+    using Base = QObject;
+
     CPerformanceCounterInfoDumper();
 public:
     static CPerformanceCounterInfoDumper& Instance();
+    ~CPerformanceCounterInfoDumper();
 
 public:
-    void DumpCountersInfo();
+    // Synchronous dump in the calling thread
+    void DumpCountersInfo( EPerfCountersDumpMode eMode = EPerfCountersDumpMode::Full );
+    // Starts dump in the worker thread, returns false if a dump is already running
+    bool StartDumpCountersInfo( EPerfCountersDumpMode eMode );
+    bool IsDumpRunning() const;
+
     void SetDumpDirPath(QString const& sPath);
     QString GetDumpFilePath() const;
 
     void AddToFilter(QString sFilter );
 
+signals:
+    void sigStartDump( int nMode );
+    void sigDumpProgress( int nDone, int nTotal, QString const& sObjectName );
+    void sigDumpFinished( QString const& sDumpFilePath, int nRewrittenObjects, int nTotalObjects );
+    void sigDumpFailed( QString const& sError );
+
+private slots:
+    void onStartDump( int nMode );
+
 private:
+    void WriteObjectFragment( SPerformanceObjectInfo const& oObject, QString const& sFilePath );
+    void AssembleDumpFile( QStringList const& lstFragments );
+    void LoadManifest();
+    void SaveManifest();
+    QString MakeFragmentPath( QString const& sObjectName ) const;
+
     bool ContainesOneOf(const QString &sSourceString, const QStringList &lstLexems);
 
 private:
+    struct SManifestEntry
+    {
+        QByteArray aSignature;
+        QString    sFragmentPath;
+    };
+
     // content
     QString m_sDumpFileName;
+    QString m_sFragmentsDirPath;
+    QString m_sManifestFileName;
     QSet<QString> m_setFilter;
+
+    QHash<QString, SManifestEntry> m_mapManifest;
+    QThread*          m_pWorkerThread;
+    std::atomic<bool> m_bDumpRunning;
 };
+////////////////////////////////////////////////////////////////////////////////////////
 
 #endif // CPERFORMANCECOUNTERINFODUMPER_H
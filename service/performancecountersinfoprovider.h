@@ -1,9 +1,12 @@
 #ifndef PERFORMANCECOUNTERSINFOPROVIDES_H
 #define PERFORMANCECOUNTERSINFOPROVIDES_H
 
+#include <QByteArray>
 #include <QString>
 #include <QStringList>
-#include <windows.h>
+#include <functional>
+
+struct SPerfNameView;
 
 struct SCounterInfo
 {
@@ -23,6 +26,11 @@ struct SPerformanceObjectInfo
 
 using PerformanceObjectsInfoList = QList<SPerformanceObjectInfo>;
 
+// Receives objects one by one in name order. nIndex counts filtered out objects too
+using PerformanceObjectInfoHandler = std::function<void( SPerformanceObjectInfo const& oObject, int nIndex, int nCount )>;
+// Returns false for objects which should be skipped
+using PerformanceObjectNameFilter  = std::function<bool( QString const& sObjectName )>;
+
 
 class CPerformanceCountersInfoProvider
 {
@@ -30,9 +38,21 @@ public:
     CPerformanceCountersInfoProvider();
 
     static PerformanceObjectsInfoList RetrieveCountersInfo();
-
-private:
-    static PerformanceObjectsInfoList PrintObjectNames(DWORD dwNumberOfObjects, BOOL fIncludeCounters, BOOL fIncludeInstances);
+    // Streams objects without keeping all of them in memory
+    static void EnumerateCountersInfo( PerformanceObjectInfoHandler fnHandler,
+                                       PerformanceObjectNameFilter fnFilter = PerformanceObjectNameFilter() );
+    // Hash of object counters and instances, changes when any of them changes
+    static QByteArray MakeSignature( SPerformanceObjectInfo const& oObject, bool bIncludeInstances = true );
+
+    // Raw HKEY_PERFORMANCE_DATA value ("Global", "Costly" or space separated object indexes)
+    static QByteArray ReadPerformanceData( QString const& sSource );
+    // Same as above, reuses capacity of the given buffer
+    static void       ReadPerformanceData( QString const& sSource, QByteArray& aBuffer );
+    // MULTI_SZ name table ("Counter" or "Help") of HKEY_PERFORMANCE_NLSTEXT,
+    // or of HKEY_PERFORMANCE_TEXT (English) if bLocalized is false
+    static QByteArray ReadPerformanceText( QString const& sSource, bool bLocalized = true );
+
+    static QString ToString( SPerfNameView const& oName );
 };
 
 #endif // PERFORMANCECOUNTERSINFOPROVIDES_H
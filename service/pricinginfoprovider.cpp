@@ -3,48 +3,77 @@
 #include "./upload/sendcontroller.h"
 #include "logger.h"
 
-#include <QEventLoop>
+#include <QDateTime>
+#include <QFile>
+#include <QJsonDocument>
+#include <QNetworkReply>
 #include <QTimer>
 
+namespace
+{
+const int c_nFetchTimeoutMsecs = 5000;
+// retry of a failed fetch
+const int c_nRetryMsecs = 10 * 60 * 1000;
+}
+
 CPricingInfoProvider::CPricingInfoProvider(QObject *parent) :
     QObject(parent),
     m_nMetricCount(0),
-    m_nUpdateSec(0),
-    m_dLastCalculatedPrice(-1)
+    m_dUpdateSec(0),
+    m_dLastCalculatedPrice(-1),
+    m_nFetchedMSecs(0),
+    m_nCacheTtlSec(24 * 3600),
+    m_pReply(nullptr),
+    m_bTimedOut(false),
+    m_pRefreshTimer(nullptr)
 {
+    m_pRefreshTimer = new QTimer(this);
+    m_pRefreshTimer->setSingleShot(true);
+    connect( m_pRefreshTimer, &QTimer::timeout, this, &CPricingInfoProvider::Refresh );
 }
 
 void CPricingInfoProvider::SetMetricsCount(int nMetricCount)
 {
+    if( m_nMetricCount == nMetricCount )
+        return;
     m_nMetricCount = nMetricCount;
+    Recalculate();
 }
 
-void CPricingInfoProvider::SetUpdatesIntervalSec(int nUpdateSec)
+void CPricingInfoProvider::SetUpdatesIntervalSec(double dUpdateSec)
 {
-    m_nUpdateSec = nUpdateSec;
+    m_dUpdateSec = dUpdateSec;
+    Recalculate();
 }
 
-double CPricingInfoProvider::CalculatePrice()
+void CPricingInfoProvider::SetCacheFilePath(QString const& sFilePath)
 {
-    QJsonObject oPriceJson = RequestPriceingInfo();
-
-    if( !oPriceJson.contains("mp") || !oPriceJson.contains("pf") || !oPriceJson.contains("pp"))
-        throw CPriceInfoFetchFailedException("Invalid info provider");
-
-    double u_p = oPriceJson["mp"].toDouble();
-    double p_f = oPriceJson["pf"].toDouble();
-    double p_p = oPriceJson["pp"].toDouble();
-
-    if(m_nUpdateSec <= 0)
-        throw CPriceInfoFetchFailedException("Update seconds not set");
+    m_sCacheFilePath = sFilePath;
+}
 
-    double dRunsMonth = 60 / m_nUpdateSec * 60 * 24 * 30;
+void CPricingInfoProvider::SetCacheTtlSec(int nTtlSec)
+{
+    // the refresh timer takes int msecs
+    m_nCacheTtlSec = qBound( 60, nTtlSec, 7 * 24 * 3600 );
+}
 
-    double o = (m_nMetricCount * dRunsMonth * u_p);
-    double deq = o + o * p_p / 100 + p_f;
+void CPricingInfoProvider::Refresh()
+{
+    qint64 nAgeMSecs = QDateTime::currentMSecsSinceEpoch() - m_nFetchedMSecs;
+    if( m_oPriceInfo.isEmpty() || nAgeMSecs >= qint64(m_nCacheTtlSec) * 1000 )
+    {
+        if( LoadCache( true ) )
+            nAgeMSecs = QDateTime::currentMSecsSinceEpoch() - m_nFetchedMSecs;
+        else
+        {
+            StartFetch();
+            return;
+        }
+    }
 
-    m_dLastCalculatedPrice = deq;
-    return deq;
+    Recalculate();
+    // fetch again when the info expires
+    m_pRefreshTimer->start( int( qBound( qint64(1000), qint64(m_nCacheTtlSec) * 1000 - nAgeMSecs, qint64(m_nCacheTtlSec) * 1000 ) ) );
 }
 
 double CPricingInfoProvider::GetLastCalculatedPrice() const
@@ -52,56 +81,128 @@ double CPricingInfoProvider::GetLastCalculatedPrice() const
     return m_dLastCalculatedPrice;
 }
 
-QJsonObject CPricingInfoProvider::RequestPriceingInfo()
+void CPricingInfoProvider::StartFetch()
 {
+    if( m_pReply )
+        return;
+
     NetworkAccessManagerSPtr pNetworkManager = CSendController::Instance().GetNetworkAccessManager().lock();
     Q_ASSERT(pNetworkManager);
     if( !pNetworkManager )
     {
         LOG_ERROR("Internal error: Network Access Manager is NULL");
-        throw CPriceInfoFetchFailedException("Network Access Manager is NULL");
+        return;
     }
 
     QUrl oUrl = QUrl("https://app.oddeye.co/OddeyeCoconut/getpayinfo");
     Q_ASSERT( oUrl.isValid() );
-    auto pReply = pNetworkManager->Get(QNetworkRequest( oUrl ) );
-
-    QTimer oTimeoutTimer;
-    oTimeoutTimer.setSingleShot(true);
+    m_bTimedOut = false;
+    QNetworkReply* pReply = pNetworkManager->Get(QNetworkRequest( oUrl ) );
+    m_pReply = pReply;
+    connect( pReply, &QNetworkReply::finished, this, &CPricingInfoProvider::onFetchFinished );
+
+    // the timer is gone with the reply
+    QTimer::singleShot( c_nFetchTimeoutMsecs, pReply,
+    [this, pReply]()
+    {
+        m_bTimedOut = true;
+        pReply->abort();
+    });
+}
 
-    QEventLoop loop;
-    connect(&oTimeoutTimer, SIGNAL(timeout()), &loop, SLOT(quit()));
-    connect(pReply, SIGNAL(finished()), &loop, SLOT(quit()));
-    // start timeout timer
-    oTimeoutTimer.start(5000);
-    // start event loop
-    loop.exec();
+void CPricingInfoProvider::onFetchFinished()
+{
+    QNetworkReply* pReply = m_pReply;
+    if( !pReply )
+        return;
+    m_pReply = nullptr;
+
+    bool bOk = false;
+    if( m_bTimedOut )
+        LOG_ERROR( "Priceing info checking timeout!" );
+    else if( pReply->error() != QNetworkReply::NoError )
+        LOG_ERROR( "Priceing info check failed: " + pReply->errorString().toStdString() );
+    else if( !SetPriceInfo( QJsonDocument::fromJson( pReply->readAll() ).object() ) )
+        LOG_ERROR( "Priceing info check failed: Invalid info provider" );
+    else
+        bOk = true;
+    // the reply is deleted by the network access manager
 
-    if(oTimeoutTimer.isActive())
+    if( bOk )
     {
-        oTimeoutTimer.stop();
-
-        // Handle reply
-        if( pReply->error() == QNetworkReply::NoError )
-        {
-            QByteArray aReply = pReply->readAll();
-            QJsonObject oJsonObj = QJsonDocument::fromJson( aReply ).object();
-            qDebug() << aReply;
-            return oJsonObj;
-        }
-        else
-        {
-            LOG_ERROR( "Priceing info check failed: " + pReply->errorString().toStdString() );
-            throw CPriceInfoFetchFailedException(pReply->errorString());
-        }
+        m_nFetchedMSecs = QDateTime::currentMSecsSinceEpoch();
+        SaveCache();
+        Recalculate();
+        m_pRefreshTimer->start( m_nCacheTtlSec * 1000 );
+        return;
     }
-    else
+
+    // an expired cache is better than nothing
+    if( m_oPriceInfo.isEmpty() && LoadCache( false ) )
+        Recalculate();
+    m_pRefreshTimer->start( c_nRetryMsecs );
+}
+
+bool CPricingInfoProvider::LoadCache( bool bFreshOnly )
+{
+    if( m_sCacheFilePath.isEmpty() )
+        return false;
+
+    QFile oFile( m_sCacheFilePath );
+    if( !oFile.open( QIODevice::ReadOnly ) )
+        return false;
+
+    QJsonObject oCache = QJsonDocument::fromJson( oFile.readAll() ).object();
+    qint64 nFetchedMSecs = static_cast<qint64>( oCache["fetched"].toDouble() );
+    if( bFreshOnly && QDateTime::currentMSecsSinceEpoch() - nFetchedMSecs >= qint64(m_nCacheTtlSec) * 1000 )
+        return false;
+    if( !SetPriceInfo( oCache["info"].toObject() ) )
+        return false;
+
+    m_nFetchedMSecs = nFetchedMSecs;
+    return true;
+}
+
+void CPricingInfoProvider::SaveCache() const
+{
+    if( m_sCacheFilePath.isEmpty() )
+        return;
+
+    QJsonObject oCache;
+    oCache["fetched"] = double( m_nFetchedMSecs );
+    oCache["info"]    = m_oPriceInfo;
+
+    QFile oFile( m_sCacheFilePath );
+    if( !oFile.open( QIODevice::WriteOnly | QIODevice::Truncate ) )
     {
-       // timeout
-       disconnect(pReply, SIGNAL(finished()), &loop, SLOT(quit()));
-       pReply->abort();
-       LOG_ERROR( "Priceing info checking timeout!" );
-       throw CPriceInfoFetchFailedException("Priceing info checking timeout!");
+        LOG_WARNING( "Unable to save pricing info: " + m_sCacheFilePath.toStdString() );
+        return;
     }
+    oFile.write( QJsonDocument( oCache ).toJson( QJsonDocument::Compact ) );
 }
 
+bool CPricingInfoProvider::SetPriceInfo( QJsonObject const& oPriceJson )
+{
+    if( !oPriceJson.contains("mp") || !oPriceJson.contains("pf") || !oPriceJson.contains("pp"))
+        return false;
+
+    m_oPriceInfo = oPriceJson;
+    return true;
+}
+
+void CPricingInfoProvider::Recalculate()
+{
+    if( m_oPriceInfo.isEmpty() || m_dUpdateSec <= 0 )
+        return;
+
+    double u_p = m_oPriceInfo["mp"].toDouble();
+    double p_f = m_oPriceInfo["pf"].toDouble();
+    double p_p = m_oPriceInfo["pp"].toDouble();
+
+    double dRunsMonth = 60 / m_dUpdateSec * 60 * 24 * 30;
+
+    double o = (m_nMetricCount * dRunsMonth * u_p);
+    double deq = o + o * p_p / 100 + p_f;
+
+    m_dLastCalculatedPrice = deq;
+}
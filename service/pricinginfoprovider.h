@@ -4,6 +4,18 @@
 #include <QJsonObject>
 #include <QObject>
 
+class QNetworkReply;
+class QTimer;
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CPricingInfoProvider
+///
+/// Approximate monthly price of the collected metrics. Pricing info is fetched in
+/// background and kept in a cache file for the cache TTL, so agent start does not
+/// wait for the pricing server. The price is recalculated locally when the metric
+/// count or the send interval changes.
+///
 class CPricingInfoProvider : public QObject
 {
     Q_OBJECT
@@ -12,20 +24,38 @@ public:
 
 public:
     void SetMetricsCount(int nMetricCount);
-    void SetUpdatesIntervalSec(int nUpdateSec);
-    double CalculatePrice();
+    void SetUpdatesIntervalSec(double dUpdateSec);
+    void SetCacheFilePath(QString const& sFilePath);
+    void SetCacheTtlSec(int nTtlSec);
+    // uses the cached info if it is fresh, otherwise starts fetching; does not block
+    void Refresh();
+    // -1 while pricing info is not available
     double GetLastCalculatedPrice() const;
 
 private:
-    QJsonObject RequestPriceingInfo();
+    void StartFetch();
+    void onFetchFinished();
+    bool LoadCache( bool bFreshOnly );
+    void SaveCache() const;
+    bool SetPriceInfo( QJsonObject const& oPriceJson );
+    void Recalculate();
+
 signals:
 
 public slots:
 
 private:
-    int m_nMetricCount;
-    int m_nUpdateSec;
-    double m_dLastCalculatedPrice;
+    int         m_nMetricCount;
+    double      m_dUpdateSec;
+    double      m_dLastCalculatedPrice;
+    QJsonObject m_oPriceInfo;
+    qint64      m_nFetchedMSecs;        // time of m_oPriceInfo fetch
+    QString     m_sCacheFilePath;
+    int         m_nCacheTtlSec;
+    QNetworkReply* m_pReply;            // running fetch
+    bool        m_bTimedOut;
+    QTimer*     m_pRefreshTimer;
 };
+////////////////////////////////////////////////////////////////////////////////////////
 
 #endif // CPRICINGINFOPROVIDER_H
@@ -3,6 +3,7 @@
 #include "agentinitializer.h"
 #include "pricinginfoprovider.h"
 #include "performancecounterinfodumper.h"
+#include "perfcountercatalog.h"
 #include "upload/sendcontroller.h"
 
 #include <iostream>
@@ -12,6 +13,8 @@ CServiceController::CServiceController(QObject *pParent)
 {
     QString sDumpDir = ConfMgr.GetAgentDirPath() + "/perf_counters_available/";
     CPerformanceCounterInfoDumper::Instance().SetDumpDirPath( sDumpDir );
+    CPerfCounterCatalog::Instance().SetStorageFilePath( sDumpDir + "catalog.dat" );
+    m_oPriceInfoFetcher.SetCacheFilePath( ConfMgr.GetAgentDirPath() + "/pricing_info.dat" );
 }
 
 CServiceController &CServiceController::Instance()
@@ -29,6 +32,12 @@ void CServiceController::Start()
         {
             m_pEngine.reset( new CEngine() );
             QObject::connect( m_pEngine.get(), &CEngine::sigMetricsCollected, &CSendController::Instance(), &CSendController::SendMetricsData );
+            // price follows the metric count, recalculated without network requests
+            QObject::connect( m_pEngine.get(), &CEngine::sigMetricsCollected, &m_oPriceInfoFetcher,
+            [this]()
+            {
+                m_oPriceInfoFetcher.SetMetricsCount( m_pEngine->GetLastMetricsCount() );
+            });
         }
 
         // Register Loadable Configs
@@ -68,17 +77,16 @@ void CServiceController::Start()
         m_pEngine->Start();
         LOG_INFO( ":::AGENT STARTED:::" );
 
-        // Calculate aproximate price
+        // refresh counters catalog in background, only changed objects are reindexed
+        CPerfCounterCatalog::Instance().StartRebuild();
+
+        // Calculate aproximate price, pricing info is fetched in background
         m_oPriceInfoFetcher.SetMetricsCount( m_pEngine->GetLastMetricsCount() );
-        double dIntervalSec = double( m_pEngine->GetUpdateInterval() ) / 1000.;
+        // points are sent once per aggregation window
+        double dIntervalSec = double( m_pEngine->GetUpdateInterval() ) * m_pEngine->MetricsAggregator().GetWindow() / 1000.;
         m_oPriceInfoFetcher.SetUpdatesIntervalSec( dIntervalSec );
-        try
-        {
-            m_oPriceInfoFetcher.CalculatePrice();
-        } catch(std::exception const& oEx)
-        {
-            LOG_ERROR( std::string("Calculate price failed on agent start: ") + oEx.what() );
-        }
+        m_oPriceInfoFetcher.SetCacheTtlSec( ConfMgr.GetMainConfiguration().Value<int>( "SelfConfig/pricing_cache_hours", 24 ) * 3600 );
+        m_oPriceInfoFetcher.Refresh();
     }
     catch( std::exception& oExc )
     {
@@ -109,23 +117,13 @@ void CServiceController::Stop()
     emit sigStopped();
 }
 
-void CServiceController::DumpPerformanceCountersInfo()
+bool CServiceController::RequestInstanceDetails(int nSeconds)
 {
-    try
-    {
-        CPerformanceCounterInfoDumper::Instance().DumpCountersInfo();
-    }
-    catch( std::exception& oExc )
-    {
-        LOG_ERROR( std::string("Performance Counters Info Dump Failed: ") + oExc.what() );
-        std::cout << "Performance Counters Info Dump Failed: " << oExc.what() << std::endl;
-        // rethrow
-        throw oExc;
-    }
-    catch( ... )
-    {
-        LOG_ERROR( std::string("Performance Counters Info Dump Failed: Unknown Exception") );
-    }
+    if( !IsStarted() )
+        return false;
+
+    m_pEngine->RequestInstanceDetails( nSeconds );
+    return true;
 }
 
 bool CServiceController::IsStarted() const
@@ -30,7 +30,8 @@ public:
     //
     void Start();
     void Stop();
-    void DumpPerformanceCountersInfo();
+    // Returns false if the agent is not running
+    bool RequestInstanceDetails( int nSeconds );
 
     bool IsStarted() const;
     double GetPriceInfo();
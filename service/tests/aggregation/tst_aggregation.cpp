@@ -0,0 +1,194 @@
+#include "metricsaggregator.h"
+#include "deadbandfilter.h"
+// Qt
+#include <QtTest>
+
+//
+//  The steps below follow CEngine::CollectMetrics with sample_period_seconds
+//  shorter than check_period_seconds: a checker gives its deadband filter to the
+//  samples, all samples go into the aggregator, the points returned by Flush()
+//  are filtered by the deadband of their section and unchanged points without
+//  alerts are not sent.
+//
+namespace
+{
+MetricDataSPtr MakeSample( double dValue, DeadbandFilterSPtr pDeadband, QString const& sName = "cpu_load" )
+{
+    MetricDataSPtr pSample = std::make_shared<CMetricData>( sName, dValue, EMetricDataType::Percent,
+                                                            QDateTime::currentDateTimeUtc(), "system" );
+    pSample->SetDeadband( pDeadband );
+    return pSample;
+}
+
+DeadbandFilterSPtr MakeDeadband( double dAbsolute, int nHeartbeatTicks )
+{
+    DeadbandFilterSPtr pDeadband = std::make_shared<CDeadbandFilter>();
+    pDeadband->SetSettings( true, dAbsolute, 0, nHeartbeatTicks );
+    return pDeadband;
+}
+
+MetricDataSPtr FindPoint( MetricDataList const& lstPoints, QString const& sName )
+{
+    for( MetricDataSPtr const& pPoint : lstPoints )
+        if( pPoint->GetName() == sName )
+            return pPoint;
+    return nullptr;
+}
+
+// what CEngine sends of the window points
+MetricDataList SelectSent( MetricDataList lstPoints )
+{
+    CDeadbandFilter::ApplyAssigned( lstPoints );
+    MetricDataList lstSent;
+    for( MetricDataSPtr const& pPoint : lstPoints )
+        if( !pPoint->IsUnchanged() || pPoint->HasSeverityDescriptor() )
+            lstSent.append( pPoint );
+    return lstSent;
+}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CAggregationTest
+///
+class CAggregationTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void ChangeOnlyKeepsAllSamplesInAggregates();
+    void DeadbandAndHeartbeatCountWindows();
+    void AlertsAreSentOnTheirTick();
+    void SectionSettingsApplyToTheirSeries();
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+void CAggregationTest::ChangeOnlyKeepsAllSamplesInAggregates()
+{
+    DeadbandFilterSPtr pCheckerDeadband = MakeDeadband( 1.0, 10 );
+
+    CMetricsAggregator oAggregator;
+    oAggregator.SetAggregates( QStringList() << "avg" << "min" << "max" );
+    oAggregator.SetWindow( 3 );
+
+    // the last two samples are within the deadband of the first one
+    for( double dValue : { 10.0, 10.5, 10.9 } )
+    {
+        QVERIFY( oAggregator.AddSamples( MetricDataList() << MakeSample( dValue, pCheckerDeadband ) ).isEmpty() );
+    }
+    QVERIFY( oAggregator.IsWindowComplete() );
+
+    MetricDataList lstPoints = oAggregator.Flush();
+    MetricDataSPtr pAvg = FindPoint( lstPoints, "cpu_load" );
+    MetricDataSPtr pMin = FindPoint( lstPoints, "cpu_load_min" );
+    MetricDataSPtr pMax = FindPoint( lstPoints, "cpu_load_max" );
+    QVERIFY( pAvg && pMin && pMax );
+    QVERIFY( qFuzzyCompare( pAvg->GetValue().toDouble(), 31.4 / 3 ) );
+    QCOMPARE( pMin->GetValue().toDouble(), 10.0 );
+    QCOMPARE( pMax->GetValue().toDouble(), 10.9 );
+    // window points are filtered with the deadband of the samples
+    QVERIFY( !pAvg->IsUnchanged() );
+    QVERIFY( pAvg->GetDeadband() == pCheckerDeadband );
+    QVERIFY( pMin->GetDeadband() == pCheckerDeadband );
+    QVERIFY( pMax->GetDeadband() == pCheckerDeadband );
+}
+
+void CAggregationTest::DeadbandAndHeartbeatCountWindows()
+{
+    DeadbandFilterSPtr pDeadband = MakeDeadband( 1.0, 3 );
+
+    CMetricsAggregator oAggregator;
+    oAggregator.SetAggregates( QStringList() << "avg" );
+    oAggregator.SetWindow( 2 );
+
+    // window averages 10, 10.2, 10.4, 10.1, 12
+    QList<double> lstSamples = { 9.5, 10.5,  10.0, 10.4,  10.4, 10.4,  10.0, 10.2,  11.0, 13.0 };
+    QList<bool>   lstExpectedSent = { true,   // first point of the series
+                                      false,
+                                      false,
+                                      true,   // heartbeat: 3 windows since the last sent point
+                                      true }; // out of the band
+    QList<bool>   lstSent;
+    for( int i = 0; i < lstSamples.size(); ++i )
+    {
+        oAggregator.AddSamples( MetricDataList() << MakeSample( lstSamples[i], pDeadband ) );
+        if( !oAggregator.IsWindowComplete() )
+            continue;
+
+        MetricDataList lstPoints = oAggregator.Flush();
+        QCOMPARE( lstPoints.size(), 1 );
+        lstSent << !SelectSent( lstPoints ).isEmpty();
+    }
+
+    QCOMPARE( lstSent, lstExpectedSent );
+}
+
+void CAggregationTest::AlertsAreSentOnTheirTick()
+{
+    DeadbandFilterSPtr pDeadband = MakeDeadband( 100.0, 10 );
+
+    CMetricsAggregator oAggregator;
+    oAggregator.SetAggregates( QStringList() << "avg" );
+    oAggregator.SetWindow( 3 );
+
+    // first window sets the reported value
+    for( int i = 0; i < 3; ++i )
+        oAggregator.AddSamples( MetricDataList() << MakeSample( 50, pDeadband ) );
+    QCOMPARE( SelectSent( oAggregator.Flush() ).size(), 1 );
+
+    // high and back to normal within one window
+    MetricDataSPtr pHigh = MakeSample( 95, pDeadband );
+    pHigh->SetSeverityDescriptor( "cpu_load", EMetricDataSeverity::High );
+    MetricDataSPtr pNormal = MakeSample( 50, pDeadband );
+    pNormal->SetSeverityDescriptor( "cpu_load", EMetricDataSeverity::Normal );
+
+    MetricDataList lstAlerts = oAggregator.AddSamples( MetricDataList() << MakeSample( 50, pDeadband ) );
+    QVERIFY( lstAlerts.isEmpty() );
+    lstAlerts = oAggregator.AddSamples( MetricDataList() << pHigh );
+    QCOMPARE( lstAlerts.size(), 1 );
+    QVERIFY( lstAlerts[0]->GetSeverityDescriptor()->GetDataSeverity() == EMetricDataSeverity::High );
+
+    // the change on the last tick goes with the window point, which is sent
+    // although its value is within the deadband
+    lstAlerts = oAggregator.AddSamples( MetricDataList() << pNormal );
+    QVERIFY( lstAlerts.isEmpty() );
+    QVERIFY( oAggregator.IsWindowComplete() );
+
+    MetricDataList lstSent = SelectSent( oAggregator.Flush() );
+    QCOMPARE( lstSent.size(), 1 );
+    QVERIFY( lstSent[0]->IsUnchanged() );
+    QVERIFY( lstSent[0]->HasSeverityDescriptor() );
+    QVERIFY( lstSent[0]->GetSeverityDescriptor()->GetDataSeverity() == EMetricDataSeverity::Normal );
+}
+
+void CAggregationTest::SectionSettingsApplyToTheirSeries()
+{
+    // cpu_load section has change_only, mem_used section overrides it with False
+    DeadbandFilterSPtr pCpuDeadband = MakeDeadband( 1.0, 10 );
+
+    CMetricsAggregator oAggregator;
+    oAggregator.SetAggregates( QStringList() << "avg" );
+    oAggregator.SetWindow( 2 );
+
+    QList<int> lstCpuSent;
+    QList<int> lstMemSent;
+    for( int i = 0; i < 6; ++i )
+    {
+        oAggregator.AddSamples( MetricDataList() << MakeSample( 10, pCpuDeadband )
+                                                 << MakeSample( 40, nullptr, "mem_used" ) );
+        if( !oAggregator.IsWindowComplete() )
+            continue;
+
+        MetricDataList lstSent = SelectSent( oAggregator.Flush() );
+        lstCpuSent << int(FindPoint( lstSent, "cpu_load" ) != nullptr);
+        lstMemSent << int(FindPoint( lstSent, "mem_used" ) != nullptr);
+    }
+
+    QCOMPARE( lstCpuSent, QList<int>() << 1 << 0 << 0 );
+    QCOMPARE( lstMemSent, QList<int>() << 1 << 1 << 1 );
+}
+
+QTEST_APPLESS_MAIN(CAggregationTest)
+
+#include "tst_aggregation.moc"
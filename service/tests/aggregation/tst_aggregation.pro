@@ -0,0 +1,18 @@
+QT += core testlib
+QT -= gui
+
+CONFIG += c++11
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_aggregation
+TEMPLATE = app
+
+INCLUDEPATH += ../../ \
+    ../../../common/
+
+SOURCES += tst_aggregation.cpp \
+    ../../metricsaggregator.cpp \
+    ../../deadbandfilter.cpp \
+    ../../ddsketch.cpp \
+    ../../metricdata.cpp
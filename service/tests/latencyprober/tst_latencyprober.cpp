@@ -0,0 +1,159 @@
+#include "checkers/latencyprober.h"
+#include "configurationmanager.h"
+// Qt
+#include <QtTest>
+#include <QTcpServer>
+
+//
+//  One prober runs the probes of all targets, the first report of each target
+//  is kept and checked by the test functions. Probe settings come from
+//  conf/conf.ini next to the test binary, written by initTestCase.
+//
+namespace
+{
+// the first round of a target starts within the period, a refused connect
+// to localhost takes about a second on Windows
+const char c_szProbeConfig[] = "[SelfConfig]\n"
+                               "probe_period_seconds = 4\n"
+                               "probe_timeout_ms = 2000\n";
+const int  c_nWaitMsecs = 20000;
+const char c_szUnresolvableTarget[] = "no-such-host.invalid:80";
+
+bool FindValue( MetricDataList const& lstMetrics, QString const& sName, double& dValue )
+{
+    for( MetricDataSPtr const& pMetric : lstMetrics )
+    {
+        if( pMetric->GetName() == sName )
+        {
+            dValue = pMetric->GetValue().toDouble();
+            return true;
+        }
+    }
+    return false;
+}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CLatencyProberTest
+///
+class CLatencyProberTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void ListeningPortReportsRtt();
+    void RefusedConnectIsReachable();
+    void UnresolvableHostIsLost();
+
+private:
+    QString                                m_sConfigDirPath;
+    bool                                   m_bConfigCreated = false;
+    QTcpServer                             m_oServer;
+    QString                                m_sListeningTarget;
+    QString                                m_sClosedTarget;
+    std::unique_ptr<CLatencyProberChecker> m_pChecker;
+    QHash<QString, MetricDataList>         m_mapReports;  // target -> its first report
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+void CLatencyProberTest::initTestCase()
+{
+    m_sConfigDirPath = ConfMgr.GetConfigsDirPath();
+    QString sConfigPath = m_sConfigDirPath + "conf.ini";
+    QVERIFY2( !QFile::exists( sConfigPath ), qPrintable( "Configuration left by another run: " + sConfigPath ) );
+    QVERIFY( QDir().mkpath( m_sConfigDirPath ) );
+    QFile oConfig( sConfigPath );
+    QVERIFY( oConfig.open( QIODevice::WriteOnly | QIODevice::Text ) );
+    oConfig.write( c_szProbeConfig );
+    oConfig.close();
+    m_bConfigCreated = true;
+    ConfMgr.LoadConfigurations();
+
+    QVERIFY( m_oServer.listen( QHostAddress::LocalHost ) );
+    m_sListeningTarget = QString( "127.0.0.1:%1" ).arg( m_oServer.serverPort() );
+
+    // a port which was free a moment ago
+    QTcpServer oClosedServer;
+    QVERIFY( oClosedServer.listen( QHostAddress::LocalHost ) );
+    m_sClosedTarget = QString( "127.0.0.1:%1" ).arg( oClosedServer.serverPort() );
+    oClosedServer.close();
+
+    QStringList lstTargets = QStringList() << m_sListeningTarget << m_sClosedTarget << c_szUnresolvableTarget;
+    m_pChecker.reset( new CLatencyProberChecker( lstTargets ) );
+    m_pChecker->Initialize();
+
+    QElapsedTimer oTimer;
+    oTimer.start();
+    while( m_mapReports.size() < lstTargets.size() && !oTimer.hasExpired( c_nWaitMsecs ) )
+    {
+        QTest::qWait( 100 );
+
+        QHash<QString, MetricDataList> mapCurrent;
+        for( MetricDataSPtr const& pMetric : m_pChecker->CheckMetrics() )
+            mapCurrent[pMetric->GetInstanceName()].append( pMetric );
+        for( auto it = mapCurrent.begin(); it != mapCurrent.end(); ++it )
+            if( !m_mapReports.contains( it.key() ) )
+                m_mapReports.insert( it.key(), it.value() );
+    }
+}
+
+void CLatencyProberTest::cleanupTestCase()
+{
+    m_pChecker.reset();
+    if( !m_bConfigCreated )
+        return;
+
+    ConfMgr.UnloadConfigs();
+    QFile::remove( m_sConfigDirPath + "conf.ini" );
+    QDir().rmdir( m_sConfigDirPath );
+}
+
+void CLatencyProberTest::ListeningPortReportsRtt()
+{
+    QVERIFY( m_mapReports.contains( m_sListeningTarget ) );
+    MetricDataList const& lstMetrics = m_mapReports[m_sListeningTarget];
+
+    double dRtt = -1;
+    QVERIFY( FindValue( lstMetrics, "probe_rtt", dRtt ) );
+    QVERIFY( dRtt >= 0 && dRtt < 2000 );
+
+    double dLoss = -1;
+    QVERIFY( FindValue( lstMetrics, "probe_loss", dLoss ) );
+    QCOMPARE( dLoss, 0.0 );
+    QVERIFY( lstMetrics[0]->GetInstanceType() == "target" );
+}
+
+void CLatencyProberTest::RefusedConnectIsReachable()
+{
+    QVERIFY( m_mapReports.contains( m_sClosedTarget ) );
+    MetricDataList const& lstMetrics = m_mapReports[m_sClosedTarget];
+
+    // the refusing host answered, so the probe has a round trip time
+    double dRtt = -1;
+    QVERIFY( FindValue( lstMetrics, "probe_rtt", dRtt ) );
+    QVERIFY( dRtt >= 0 );
+
+    double dLoss = -1;
+    QVERIFY( FindValue( lstMetrics, "probe_loss", dLoss ) );
+    QCOMPARE( dLoss, 0.0 );
+}
+
+void CLatencyProberTest::UnresolvableHostIsLost()
+{
+    QVERIFY( m_mapReports.contains( c_szUnresolvableTarget ) );
+    MetricDataList const& lstMetrics = m_mapReports[c_szUnresolvableTarget];
+
+    double dValue = -1;
+    QVERIFY( !FindValue( lstMetrics, "probe_rtt", dValue ) );
+    QVERIFY( FindValue( lstMetrics, "probe_loss", dValue ) );
+    QCOMPARE( dValue, 100.0 );
+}
+
+QTEST_GUILESS_MAIN(CLatencyProberTest)
+
+#include "tst_latencyprober.moc"
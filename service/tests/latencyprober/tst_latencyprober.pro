@@ -0,0 +1,30 @@
+QT += core network testlib
+QT -= gui
+
+CONFIG += c++11
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+LIBS     += -lws2_32
+LIBS     += -liphlpapi
+
+TARGET = tst_latencyprober
+TEMPLATE = app
+
+INCLUDEPATH += ../../ \
+    ../../../common/
+
+SOURCES += tst_latencyprober.cpp \
+    ../../checkers/latencyprober.cpp \
+    ../../imetricscategorychecker.cpp \
+    ../../metricdata.cpp \
+    ../../tickclock.cpp \
+    ../../logger.cpp \
+    ../../configuration.cpp \
+    ../../configurationmanager.cpp \
+    ../../commonexceptions.cpp \
+    ../../exception.cpp
+
+HEADERS += ../../checkers/latencyprober.h \
+    ../../imetricscategorychecker.h \
+    ../../configurationmanager.h
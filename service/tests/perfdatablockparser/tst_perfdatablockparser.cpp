@@ -0,0 +1,292 @@
+#include "perfdatablockparser.h"
+#include "commonexceptions.h"
+// Qt
+#include <QtTest>
+// STL
+#include <cstring>
+#include <string>
+#include <vector>
+
+//
+//  Builds PERF_DATA_BLOCK images with the winperf.h layout, the same bytes
+//  RegQueryValueEx(HKEY_PERFORMANCE_DATA) returns on a little endian machine.
+//
+namespace
+{
+const uint32_t c_nPerf100nsTimer  = 0x20510500;  // PERF_100NSEC_TIMER
+const uint32_t c_nPerfRawcount    = 0x00010000;  // PERF_COUNTER_RAWCOUNT
+const uint32_t c_nPerfLargeRaw    = 0x00010100;  // PERF_COUNTER_LARGE_RAWCOUNT
+
+class CBlockWriter
+{
+public:
+    template <typename T>
+    void Put( size_t nOffset, T tValue )
+    {
+        if( m_aData.size() < nOffset + sizeof(T) )
+            m_aData.resize( nOffset + sizeof(T) );
+        std::memcpy( m_aData.data() + nOffset, &tValue, sizeof(T) );
+    }
+
+    void PutName( size_t nOffset, char16_t const* szName )
+    {
+        for( ; *szName; ++szName, nOffset += 2 )
+            Put<char16_t>( nOffset, *szName );
+        Put<char16_t>( nOffset, 0 );
+    }
+
+    size_t Reserve( size_t nSize )
+    {
+        size_t nOffset = m_aData.size();
+        m_aData.resize( nOffset + nSize );
+        return nOffset;
+    }
+
+    size_t Size() const { return m_aData.size(); }
+    std::vector<uint8_t>& Data() { return m_aData; }
+
+private:
+    std::vector<uint8_t> m_aData;
+};
+
+void WriteCounter( CBlockWriter& oWriter, size_t nOffset, uint32_t nNameIndex, uint32_t nType, uint32_t nSize, uint32_t nDataOffset )
+{
+    oWriter.Put<uint32_t>( nOffset,      40 );             // ByteLength
+    oWriter.Put<uint32_t>( nOffset + 4,  nNameIndex );
+    oWriter.Put<uint32_t>( nOffset + 12, nNameIndex + 1 ); // help index
+    oWriter.Put<int32_t>(  nOffset + 20, 0 );              // DefaultScale
+    oWriter.Put<uint32_t>( nOffset + 24, 100 );            // PERF_DETAIL_NOVICE
+    oWriter.Put<uint32_t>( nOffset + 28, nType );
+    oWriter.Put<uint32_t>( nOffset + 32, nSize );
+    oWriter.Put<uint32_t>( nOffset + 36, nDataOffset );
+}
+
+// Two objects:
+//  238 "Processor"  instances "0" and "_Total", counters 6 (64 bit) and 1848 (32 bit)
+//  2   "System"     single instance, counter 250 (64 bit)
+std::vector<uint8_t> MakeSampleBlock()
+{
+    CBlockWriter oWriter;
+
+    //  PERF_DATA_BLOCK
+    oWriter.Reserve( 88 );
+    oWriter.PutName( 0, u"PERF" );
+    oWriter.Put<uint32_t>( 8, 1 );              // LittleEndian
+    oWriter.Put<uint32_t>( 12, 1 );             // Version
+    oWriter.Put<uint32_t>( 16, 1 );             // Revision
+    oWriter.Put<uint32_t>( 24, 88 );            // HeaderLength
+    oWriter.Put<uint32_t>( 28, 2 );             // NumObjectTypes
+    oWriter.Put<int64_t>( 56, 123456789 );      // PerfTime
+    oWriter.Put<int64_t>( 64, 10000000 );       // PerfFreq
+    oWriter.Put<int64_t>( 72, 132000000000000000LL );
+
+    //  Processor
+    size_t nObject = oWriter.Reserve( 64 + 2 * 40 );
+    oWriter.Put<uint32_t>( nObject + 4,  64 + 2 * 40 );    // DefinitionLength
+    oWriter.Put<uint32_t>( nObject + 8,  64 );             // HeaderLength
+    oWriter.Put<uint32_t>( nObject + 12, 238 );
+    oWriter.Put<uint32_t>( nObject + 20, 239 );
+    oWriter.Put<uint32_t>( nObject + 28, 100 );
+    oWriter.Put<uint32_t>( nObject + 32, 2 );              // NumCounters
+    oWriter.Put<int32_t>(  nObject + 36, 0 );
+    oWriter.Put<int32_t>(  nObject + 40, 2 );              // NumInstances
+    oWriter.Put<uint32_t>( nObject + 44, 0 );              // CodePage
+    oWriter.Put<int64_t>(  nObject + 48, 123456789 );
+    oWriter.Put<int64_t>(  nObject + 56, 10000000 );
+    WriteCounter( oWriter, nObject + 64,      6,    c_nPerf100nsTimer, 8, 8 );
+    WriteCounter( oWriter, nObject + 64 + 40, 1848, c_nPerfRawcount,   4, 16 );
+
+    char16_t const* aInstances[] = { u"0", u"_Total" };
+    for( int i = 0; i < 2; ++i )
+    {
+        size_t nNameBytes = (std::char_traits<char16_t>::length( aInstances[i] ) + 1) * 2;
+        size_t nInstanceLength = 24 + ((nNameBytes + 7) & ~size_t(7));
+        size_t nInstance = oWriter.Reserve( nInstanceLength );
+        oWriter.Put<uint32_t>( nInstance,      uint32_t(nInstanceLength) );
+        oWriter.Put<uint32_t>( nInstance + 12, uint32_t(i == 0? 0 : -1) ); // UniqueID
+        oWriter.Put<uint32_t>( nInstance + 16, 24 );                        // NameOffset
+        oWriter.Put<uint32_t>( nInstance + 20, uint32_t(nNameBytes) );
+        oWriter.PutName( nInstance + 24, aInstances[i] );
+
+        size_t nBlock = oWriter.Reserve( 24 );
+        oWriter.Put<uint32_t>( nBlock, 24 );
+        oWriter.Put<uint64_t>( nBlock + 8,  1000000ULL * uint64_t(i + 1) );
+        oWriter.Put<uint32_t>( nBlock + 16, uint32_t(42 + i) );
+    }
+    oWriter.Put<uint32_t>( nObject, uint32_t(oWriter.Size() - nObject) );  // TotalByteLength
+
+    //  System
+    nObject = oWriter.Reserve( 64 + 40 );
+    oWriter.Put<uint32_t>( nObject + 4,  64 + 40 );
+    oWriter.Put<uint32_t>( nObject + 8,  64 );
+    oWriter.Put<uint32_t>( nObject + 12, 2 );
+    oWriter.Put<uint32_t>( nObject + 20, 3 );
+    oWriter.Put<uint32_t>( nObject + 32, 1 );
+    oWriter.Put<int32_t>(  nObject + 36, -1 );
+    oWriter.Put<int32_t>(  nObject + 40, -1 );             // PERF_NO_INSTANCES
+    WriteCounter( oWriter, nObject + 64, 250, c_nPerfLargeRaw, 8, 8 );
+
+    size_t nBlock = oWriter.Reserve( 16 );
+    oWriter.Put<uint32_t>( nBlock, 16 );
+    oWriter.Put<uint64_t>( nBlock + 8, 777ULL );
+    oWriter.Put<uint32_t>( nObject, uint32_t(oWriter.Size() - nObject) );
+
+    oWriter.Put<uint32_t>( 20, uint32_t(oWriter.Size()) ); // TotalByteLength
+    return std::move( oWriter.Data() );
+}
+
+// MULTI_SZ of "index\0text\0" pairs
+std::vector<uint8_t> MakeNameTable( std::vector<std::u16string> const& lstStrings )
+{
+    CBlockWriter oWriter;
+    for( std::u16string const& sString : lstStrings )
+        oWriter.PutName( oWriter.Size(), sString.c_str() );
+    oWriter.Put<char16_t>( oWriter.Size(), 0 );
+    return std::move( oWriter.Data() );
+}
+
+bool NameEquals( SPerfNameView const& oName, char16_t const* szExpected )
+{
+    size_t nLength = std::char_traits<char16_t>::length( szExpected );
+    return oName.IsUnicode() && oName.GetLength() == nLength
+        && std::memcmp( oName.pData, szExpected, nLength * 2 ) == 0;
+}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CPerfDataBlockParserTest
+///
+class CPerfDataBlockParserTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void ParseRoundTrip();
+    void ParseRejectsTruncatedBlock();
+    void ParseRejectsBadCounts();
+    void NameTableRoundTrip();
+    void NameTableSkipsHugeIndexes();
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+void CPerfDataBlockParserTest::ParseRoundTrip()
+{
+    std::vector<uint8_t> aBlock = MakeSampleBlock();
+    CPerfDataArena oArena;
+    SPerfDataSnapshot oSnapshot = CPerfDataBlockParser( oArena ).Parse( aBlock.data(), aBlock.size() );
+
+    QCOMPARE( oSnapshot.nPerfTime, int64_t(123456789) );
+    QCOMPARE( oSnapshot.nPerfFreq, int64_t(10000000) );
+    QCOMPARE( oSnapshot.nObjectCount, 2u );
+
+    SPerfObject const* pProcessor = oSnapshot.FindObject( 238 );
+    QVERIFY( pProcessor );
+    QVERIFY( pProcessor->bHasInstances );
+    QCOMPARE( pProcessor->nHelpIndex, 239u );
+    QCOMPARE( pProcessor->nCounterCount, 2u );
+    QCOMPARE( pProcessor->nInstanceCount, 2u );
+    QVERIFY( NameEquals( pProcessor->pInstances[0].oName, u"0" ) );
+    QVERIFY( NameEquals( pProcessor->pInstances[1].oName, u"_Total" ) );
+    QCOMPARE( pProcessor->pInstances[1].nUniqueId, -1 );
+    QVERIFY( !oSnapshot.FindParentInstance( pProcessor->pInstances[0] ) );
+
+    SPerfCounterDefinition const* pTime = pProcessor->FindCounter( 6 );
+    SPerfCounterDefinition const* pRaw  = pProcessor->FindCounter( 1848 );
+    QVERIFY( pTime && pRaw );
+    QCOMPARE( pTime->nCounterType, c_nPerf100nsTimer );
+    QVERIFY( !CPerfDataBlockParser::IsBaseCounter( pTime->nCounterType ) );
+
+    for( uint32_t i = 0; i < 2; ++i )
+    {
+        SPerfInstance const& oInstance = pProcessor->pInstances[i];
+        uint64_t nValue = 0;
+        QVERIFY( CPerfDataBlockParser::ReadCounterValue( *pTime, oInstance.pCounterData, oInstance.nCounterDataLength, nValue ) );
+        QCOMPARE( nValue, uint64_t(1000000 * (i + 1)) );
+        QVERIFY( CPerfDataBlockParser::ReadCounterValue( *pRaw, oInstance.pCounterData, oInstance.nCounterDataLength, nValue ) );
+        QCOMPARE( nValue, uint64_t(42 + i) );
+    }
+
+    SPerfObject const* pSystem = oSnapshot.FindObject( 2 );
+    QVERIFY( pSystem );
+    QVERIFY( !pSystem->bHasInstances );
+    QCOMPARE( pSystem->nInstanceCount, 0u );
+    uint64_t nValue = 0;
+    QVERIFY( CPerfDataBlockParser::ReadCounterValue( pSystem->pCounters[0], pSystem->pCounterData, pSystem->nCounterDataLength, nValue ) );
+    QCOMPARE( nValue, uint64_t(777) );
+
+    // the counter block is 24 bytes, a counter past it has no value
+    SPerfCounterDefinition oOutside = *pTime;
+    oOutside.nOffset = 20;
+    QVERIFY( !CPerfDataBlockParser::ReadCounterValue( oOutside, pProcessor->pInstances[0].pCounterData,
+                                                      pProcessor->pInstances[0].nCounterDataLength, nValue ) );
+}
+
+void CPerfDataBlockParserTest::ParseRejectsTruncatedBlock()
+{
+    std::vector<uint8_t> aBlock = MakeSampleBlock();
+    CPerfDataArena oArena;
+    CPerfDataBlockParser oParser( oArena );
+
+    QVERIFY_EXCEPTION_THROWN( oParser.Parse( aBlock.data(), aBlock.size() - 1 ), CPerfDataParseException );
+    QVERIFY_EXCEPTION_THROWN( oParser.Parse( aBlock.data(), 40 ), CPerfDataParseException );
+
+    aBlock[0] = 'X';
+    QVERIFY_EXCEPTION_THROWN( oParser.Parse( aBlock.data(), aBlock.size() ), CPerfDataParseException );
+}
+
+void CPerfDataBlockParserTest::ParseRejectsBadCounts()
+{
+    CPerfDataArena oArena;
+    CPerfDataBlockParser oParser( oArena );
+
+    std::vector<uint8_t> aBlock = MakeSampleBlock();
+    int32_t nInstances = 0x10000000;
+    std::memcpy( aBlock.data() + 88 + 40, &nInstances, sizeof(nInstances) );
+    QVERIFY_EXCEPTION_THROWN( oParser.Parse( aBlock.data(), aBlock.size() ), CPerfDataParseException );
+
+    aBlock = MakeSampleBlock();
+    uint32_t nCounters = 1000;
+    std::memcpy( aBlock.data() + 88 + 32, &nCounters, sizeof(nCounters) );
+    QVERIFY_EXCEPTION_THROWN( oParser.Parse( aBlock.data(), aBlock.size() ), CPerfDataParseException );
+
+    aBlock = MakeSampleBlock();
+    uint32_t nObjects = 1000;
+    std::memcpy( aBlock.data() + 28, &nObjects, sizeof(nObjects) );
+    QVERIFY_EXCEPTION_THROWN( oParser.Parse( aBlock.data(), aBlock.size() ), CPerfDataParseException );
+}
+
+void CPerfDataBlockParserTest::NameTableRoundTrip()
+{
+    std::vector<uint8_t> aText = MakeNameTable( { u"1", u"1847", u"2", u"System", u"6", u"% Processor Time",
+                                                  u"238", u"Processor", u"x1", u"Not a number" } );
+    CPerfNameTable oTable;
+    oTable.Load( aText.data(), aText.size() );
+
+    QCOMPARE( oTable.GetMaxIndex(), 238u );
+    QVERIFY( NameEquals( oTable.Get( 238 ), u"Processor" ) );
+    QVERIFY( NameEquals( oTable.Get( 6 ), u"% Processor Time" ) );
+    QVERIFY( oTable.Get( 3 ).IsEmpty() );
+    QVERIFY( oTable.Get( 100000 ).IsEmpty() );
+
+    std::u16string sName = u"% processor TIME";
+    QCOMPARE( oTable.FindIndex( sName.c_str(), uint32_t(sName.size()) ), 6u );
+    sName = u"Not a number";
+    QCOMPARE( oTable.FindIndex( sName.c_str(), uint32_t(sName.size()) ), 0u );
+}
+
+void CPerfDataBlockParserTest::NameTableSkipsHugeIndexes()
+{
+    std::vector<uint8_t> aText = MakeNameTable( { u"2", u"System", u"999999999", u"Huge", u"4", u"Memory" } );
+    CPerfNameTable oTable;
+    oTable.Load( aText.data(), aText.size() );
+
+    QCOMPARE( oTable.GetMaxIndex(), 4u );
+    QVERIFY( NameEquals( oTable.Get( 4 ), u"Memory" ) );
+    QVERIFY( oTable.Get( 999999999 ).IsEmpty() );
+}
+
+QTEST_APPLESS_MAIN(CPerfDataBlockParserTest)
+
+#include "tst_perfdatablockparser.moc"
@@ -0,0 +1,16 @@
+QT += core testlib
+QT -= gui
+
+CONFIG += c++11
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_perfdatablockparser
+TEMPLATE = app
+
+INCLUDEPATH += ../../ \
+    ../../../common/
+
+SOURCES += tst_perfdatablockparser.cpp \
+    ../../perfdatablockparser.cpp \
+    ../../exception.cpp
@@ -0,0 +1,191 @@
+#include "checkers/scriptoutputparser.h"
+// Qt
+#include <QtTest>
+
+namespace
+{
+MetricDataSPtr ParseOne( CScriptOutputParser& oParser, QByteArray const& aLine )
+{
+    return oParser.ParseLine( aLine.constData(), aLine.constData() + aLine.size() );
+}
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CScriptOutputParserTest
+///
+class CScriptOutputParserTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void ParseDouble_data();
+    void ParseDouble();
+    void NonNumericValueIsKeptAsText();
+    void SeparatorsAndLineEnds();
+    void TagsAndTimestamps_data();
+    void TagsAndTimestamps();
+    void InvalidLinesAreReportedWithLineNumbers();
+    void LoggedErrorsAreCapped();
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+void CScriptOutputParserTest::ParseDouble_data()
+{
+    QTest::addColumn<QByteArray>( "aText" );
+    QTest::addColumn<bool>( "bValid" );
+    QTest::addColumn<double>( "dExpected" );
+
+    QTest::newRow( "integer" )            << QByteArray( "42" )          << true  << 42.0;
+    QTest::newRow( "negative" )           << QByteArray( "-17" )         << true  << -17.0;
+    QTest::newRow( "plus sign" )          << QByteArray( "+3" )          << true  << 3.0;
+    QTest::newRow( "fraction" )           << QByteArray( "0.25" )        << true  << 0.25;
+    QTest::newRow( "negative fraction" )  << QByteArray( "-1.5" )        << true  << -1.5;
+    QTest::newRow( "exponent" )           << QByteArray( "1e3" )         << true  << 1000.0;
+    QTest::newRow( "negative exponent" )  << QByteArray( "2.5E-2" )      << true  << 0.025;
+    QTest::newRow( "plus exponent" )      << QByteArray( "7e+2" )        << true  << 700.0;
+    QTest::newRow( "large exponent" )     << QByteArray( "1e300" )       << true  << 1e300;
+    QTest::newRow( "long mantissa" )      << QByteArray( "123456789012345678901234" )   << true << 1.2345678901234568e23;
+    QTest::newRow( "long fraction" )      << QByteArray( "0.123456789012345678901234" ) << true << 0.12345678901234568;
+    QTest::newRow( "leading point" )      << QByteArray( ".5" )          << true  << 0.5;
+    QTest::newRow( "trailing point" )     << QByteArray( "1." )          << true  << 1.0;
+    QTest::newRow( "sign only" )          << QByteArray( "-" )           << false << 0.0;
+    QTest::newRow( "point only" )         << QByteArray( "." )           << false << 0.0;
+    QTest::newRow( "exponent no digits" ) << QByteArray( "1e" )          << false << 0.0;
+    QTest::newRow( "exponent sign only" ) << QByteArray( "1e-" )         << false << 0.0;
+    QTest::newRow( "trailing text" )      << QByteArray( "12abc" )       << false << 0.0;
+    QTest::newRow( "text" )               << QByteArray( "abc" )         << false << 0.0;
+    QTest::newRow( "empty" )              << QByteArray()                << false << 0.0;
+}
+
+void CScriptOutputParserTest::ParseDouble()
+{
+    QFETCH( QByteArray, aText );
+    QFETCH( bool, bValid );
+    QFETCH( double, dExpected );
+
+    double dValue = 0;
+    QCOMPARE( CScriptOutputParser::ParseDouble( aText.constData(), aText.constData() + aText.size(), dValue ), bValid );
+    if( bValid )
+        QVERIFY( qFuzzyCompare( dValue, dExpected ) );
+}
+
+void CScriptOutputParserTest::NonNumericValueIsKeptAsText()
+{
+    CScriptOutputParser oParser;
+    for( QByteArray const& aValue : { QByteArray( "-" ), QByteArray( "1e" ), QByteArray( "running" ) } )
+    {
+        MetricDataSPtr pMetric = ParseOne( oParser, "service_state " + aValue );
+        QVERIFY( pMetric );
+        QCOMPARE( pMetric->GetValue().type(), QVariant::String );
+        QCOMPARE( pMetric->GetValue().toString(), QString::fromLatin1( aValue ) );
+    }
+    QCOMPARE( oParser.GetErrorCount(), 0 );
+}
+
+void CScriptOutputParserTest::SeparatorsAndLineEnds()
+{
+    CScriptOutputParser oParser;
+    // CRLF line ends, tabs and runs of separators, no newline after the last line
+    MetricDataList lstMetrics = oParser.Parse( "cpu_load 0.5\r\n"
+                                               "\r\n"
+                                               "mem_used\t12\tsystem\tPercent\r\n"
+                                               "  disk_free  \t 7e1 \t"  );
+    QCOMPARE( lstMetrics.size(), 3 );
+
+    QCOMPARE( lstMetrics[0]->GetName(), QString( "cpu_load" ) );
+    QCOMPARE( lstMetrics[0]->GetValue().toDouble(), 0.5 );
+
+    QCOMPARE( lstMetrics[1]->GetName(), QString( "mem_used" ) );
+    QCOMPARE( lstMetrics[1]->GetValue().toDouble(), 12.0 );
+    QCOMPARE( lstMetrics[1]->GetMetricType(), QString( "system" ) );
+    QVERIFY( lstMetrics[1]->GetDataType() == EMetricDataType::Percent );
+
+    QCOMPARE( lstMetrics[2]->GetName(), QString( "disk_free" ) );
+    QCOMPARE( lstMetrics[2]->GetValue().toDouble(), 70.0 );
+    QCOMPARE( oParser.GetErrorCount(), 0 );
+}
+
+void CScriptOutputParserTest::TagsAndTimestamps_data()
+{
+    QTest::addColumn<QByteArray>( "aTimestamp" );
+    QTest::addColumn<qint64>( "nExpectedMSecs" );
+
+    QTest::newRow( "seconds" )               << QByteArray( "@1600000000" )    << qint64( 1600000000000LL );
+    QTest::newRow( "seconds with fraction" ) << QByteArray( "@1600000000.25" ) << qint64( 1600000000250LL );
+    QTest::newRow( "milliseconds" )          << QByteArray( "@1600000000123" ) << qint64( 1600000000123LL );
+    // 1e11 msecs is in 1973, 1e11 secs is far beyond any real timestamp
+    QTest::newRow( "below the limit" )       << QByteArray( "@99999999999" )   << qint64( 99999999999000LL );
+    QTest::newRow( "at the limit" )          << QByteArray( "@100000000000" )  << qint64( 100000000000LL );
+}
+
+void CScriptOutputParserTest::TagsAndTimestamps()
+{
+    QFETCH( QByteArray, aTimestamp );
+    QFETCH( qint64, nExpectedMSecs );
+
+    CScriptOutputParser oParser;
+    MetricDataSPtr pMetric = ParseOne( oParser, "requests 12 web host=web1 " + aTimestamp + " path=/api" );
+    QVERIFY( pMetric );
+    QCOMPARE( pMetric->GetMetricType(), QString( "web" ) );
+    QCOMPARE( pMetric->GetTime().toMSecsSinceEpoch(), nExpectedMSecs );
+
+    MetricTagList const& lstTags = pMetric->GetTags();
+    QCOMPARE( lstTags.size(), 2 );
+    QCOMPARE( lstTags[0].first,  QString( "host" ) );
+    QCOMPARE( lstTags[0].second, QString( "web1" ) );
+    QCOMPARE( lstTags[1].first,  QString( "path" ) );
+    QCOMPARE( lstTags[1].second, QString( "/api" ) );
+}
+
+void CScriptOutputParserTest::InvalidLinesAreReportedWithLineNumbers()
+{
+    CScriptOutputParser oParser( "check.bat" );
+    MetricDataList lstMetrics = oParser.Parse( "good 1\n"
+                                               "lonely_name\n"           // 2: no value
+                                               "\n"
+                                               "a 1 b Rate extra\n"      // 4: unexpected token
+                                               "a 1 =web1\n"             // 5: tag without name
+                                               "a 1 host=\n"             // 6: tag without value
+                                               "a 1 @soon\n"             // 7: invalid timestamp
+                                               "a 1 @0\n"                // 8: timestamp not positive
+                                               "also_good 2\n" );
+    QCOMPARE( lstMetrics.size(), 2 );
+    QCOMPARE( lstMetrics[0]->GetName(), QString( "good" ) );
+    QCOMPARE( lstMetrics[1]->GetName(), QString( "also_good" ) );
+
+    QStringList const& lstErrors = oParser.GetLoggedErrors();
+    QCOMPARE( oParser.GetErrorCount(), 6 );
+    QCOMPARE( lstErrors.size(), 6 );
+    QList<int> lstExpectedLines = { 2, 4, 5, 6, 7, 8 };
+    for( int i = 0; i < lstErrors.size(); ++i )
+    {
+        QVERIFY2( lstErrors[i].contains( QString( "at line %1:" ).arg( lstExpectedLines[i] ) ), qPrintable( lstErrors[i] ) );
+        QVERIFY( lstErrors[i].endsWith( "File: check.bat" ) );
+    }
+
+    // line numbers start again with each output
+    oParser.Parse( "bad\n" );
+    QCOMPARE( oParser.GetErrorCount(), 1 );
+    QVERIFY( oParser.GetLoggedErrors()[0].contains( "at line 1:" ) );
+}
+
+void CScriptOutputParserTest::LoggedErrorsAreCapped()
+{
+    CScriptOutputParser oParser;
+    QByteArray aOutput;
+    for( int i = 0; i < 15; ++i )
+        aOutput += "bad\n";
+    aOutput += "good 1\n";
+
+    MetricDataList lstMetrics = oParser.Parse( aOutput );
+    QCOMPARE( lstMetrics.size(), 1 );
+    QCOMPARE( oParser.GetErrorCount(), 15 );
+    QCOMPARE( oParser.GetLoggedErrors().size(), 10 );
+    QVERIFY( oParser.GetLoggedErrors().last().contains( "at line 10:" ) );
+}
+
+QTEST_APPLESS_MAIN(CScriptOutputParserTest)
+
+#include "tst_scriptoutputparser.moc"
@@ -0,0 +1,23 @@
+QT += core testlib
+QT -= gui
+
+CONFIG += c++11
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_scriptoutputparser
+TEMPLATE = app
+
+INCLUDEPATH += ../../ \
+    ../../../common/
+
+SOURCES += tst_scriptoutputparser.cpp \
+    ../../checkers/scriptoutputparser.cpp \
+    ../../metricdata.cpp \
+    ../../logger.cpp \
+    ../../configuration.cpp \
+    ../../configurationmanager.cpp \
+    ../../commonexceptions.cpp \
+    ../../exception.cpp
+
+HEADERS += ../../configurationmanager.h
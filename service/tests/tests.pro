@@ -0,0 +1,6 @@
+TEMPLATE = subdirs
+
+SUBDIRS += perfdatablockparser \
+    aggregation \
+    scriptoutputparser \
+    latencyprober
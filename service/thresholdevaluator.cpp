@@ -0,0 +1,158 @@
+#include "thresholdevaluator.h"
+
+#include <cmath>
+#include <limits>
+
+namespace
+{
+const double  c_dDisabled  = std::numeric_limits<double>::infinity();
+const uint8_t c_nNormal    = static_cast<uint8_t>( EMetricDataSeverity::Normal );
+const uint8_t c_nHigh      = static_cast<uint8_t>( EMetricDataSeverity::High );
+const uint8_t c_nSevere    = static_cast<uint8_t>( EMetricDataSeverity::Severe );
+}
+
+CThresholdEvaluator::CThresholdEvaluator()
+    : m_dHysteresisPercent( 0 ),
+      m_nMinDurationMsecs( 0 )
+{
+    m_oClock.start();
+}
+
+CThresholdEvaluator &CThresholdEvaluator::Instance()
+{
+    static CThresholdEvaluator oInst;
+    return oInst;
+}
+
+int CThresholdEvaluator::AddSeries( double dHighValue, double dSevereValue )
+{
+    int nSeries;
+    if( !m_aFreeSeries.empty() )
+    {
+        nSeries = m_aFreeSeries.back();
+        m_aFreeSeries.pop_back();
+    }
+    else
+    {
+        nSeries = static_cast<int>( m_aHigh.size() );
+        size_t nSize = m_aHigh.size() + 1;
+        m_aHigh.resize( nSize );
+        m_aSevere.resize( nSize );
+        m_aHighClear.resize( nSize );
+        m_aSevereClear.resize( nSize );
+        m_aValue.resize( nSize );
+        m_aState.resize( nSize );
+        m_aCandidate.resize( nSize );
+        m_aCandidateSince.resize( nSize );
+        m_aMetrics.resize( nSize );
+    }
+
+    m_aHigh[nSeries]           = dHighValue   == -1? c_dDisabled : dHighValue;
+    m_aSevere[nSeries]         = dSevereValue == -1? c_dDisabled : dSevereValue;
+    m_aValue[nSeries]          = 0;
+    m_aState[nSeries]          = c_nNormal;
+    m_aCandidate[nSeries]      = c_nNormal;
+    m_aCandidateSince[nSeries] = 0;
+    m_aMetrics[nSeries]        = nullptr;
+    UpdateClearLevels( nSeries );
+
+    return nSeries;
+}
+
+void CThresholdEvaluator::RemoveSeries( int nSeries )
+{
+    Q_ASSERT( nSeries >= 0 && size_t(nSeries) < m_aHigh.size() );
+    if( nSeries < 0 || size_t(nSeries) >= m_aHigh.size() )
+        return;
+
+    // never matches until reused
+    m_aHigh[nSeries]   = c_dDisabled;
+    m_aSevere[nSeries] = c_dDisabled;
+    m_aState[nSeries]  = c_nNormal;
+    UpdateClearLevels( nSeries );
+    m_aFreeSeries.push_back( nSeries );
+}
+
+void CThresholdEvaluator::SetHysteresisPercent( double dPercent )
+{
+    m_dHysteresisPercent = dPercent > 0? dPercent : 0;
+    for( size_t i = 0; i < m_aHigh.size(); ++i )
+        UpdateClearLevels( int(i) );
+}
+
+void CThresholdEvaluator::SetMinDuration( qint64 nMsecs )
+{
+    m_nMinDurationMsecs = nMsecs > 0? nMsecs : 0;
+}
+
+void CThresholdEvaluator::UpdateClearLevels( int nSeries )
+{
+    // inf - x stays inf, so disabled thresholds need no special case
+    m_aHighClear[nSeries]   = m_aHigh[nSeries]   - std::fabs( m_aHigh[nSeries] )   * m_dHysteresisPercent / 100;
+    m_aSevereClear[nSeries] = m_aSevere[nSeries] - std::fabs( m_aSevere[nSeries] ) * m_dHysteresisPercent / 100;
+}
+
+void CThresholdEvaluator::Evaluate( MetricDataList const& lstMetrics )
+{
+    size_t const nCount = m_aHigh.size();
+    if( nCount == 0 )
+        return;
+
+    // gather values of this tick
+    std::fill( m_aMetrics.begin(), m_aMetrics.end(), nullptr );
+    for( MetricDataSPtr const& pMetric : lstMetrics )
+    {
+        int nSeries = pMetric->GetThresholdSeries();
+        if( nSeries < 0 || size_t(nSeries) >= nCount )
+            continue;
+        m_aValue[nSeries]   = pMetric->GetValue().toDouble();
+        m_aMetrics[nSeries] = pMetric.get();
+    }
+
+    qint64 const nNow = m_oClock.elapsed();
+    double const*  pHigh        = m_aHigh.data();
+    double const*  pSevere      = m_aSevere.data();
+    double const*  pHighClear   = m_aHighClear.data();
+    double const*  pSevereClear = m_aSevereClear.data();
+    double const*  pValue       = m_aValue.data();
+    uint8_t*       pState       = m_aState.data();
+    uint8_t*       pCandidate   = m_aCandidate.data();
+    qint64*        pSince       = m_aCandidateSince.data();
+
+    for( size_t i = 0; i < nCount; ++i )
+    {
+        // current state decides which level applies: enter at threshold, leave below clear level
+        double dSevereLevel = pState[i] == c_nSevere? pSevereClear[i] : pSevere[i];
+        double dHighLevel   = pState[i] >= c_nHigh?   pHighClear[i]   : pHigh[i];
+        uint8_t nRaw = pValue[i] >= dSevereLevel? c_nSevere
+                     : pValue[i] >  dHighLevel?   c_nHigh
+                     : c_nNormal;
+
+        // restart the duration when the candidate changes
+        bool bNewCandidate = nRaw != pCandidate[i];
+        pSince[i]     = bNewCandidate? nNow : pSince[i];
+        pCandidate[i] = nRaw;
+    }
+
+    for( size_t i = 0; i < nCount; ++i )
+    {
+        CMetricData* pMetric = m_aMetrics[i];
+        if( !pMetric || pCandidate[i] == pState[i] || nNow - pSince[i] < m_nMinDurationMsecs )
+            continue;
+
+        pState[i] = pCandidate[i];
+        EMetricDataSeverity eSeverity = static_cast<EMetricDataSeverity>( pState[i] );
+        if( eSeverity == EMetricDataSeverity::Normal )
+        {
+            pMetric->SetSeverityDescriptor( pMetric->GetName(), eSeverity, 0 );
+        }
+        else
+        {
+            QString sErrorMsg = QString("%4: %1 value is %2: %3").arg( pMetric->GetName(),
+                                                                       ToString( eSeverity ).toLower(),
+                                                                       QString::number( pValue[i] ),
+                                                                       eSeverity == EMetricDataSeverity::High? "WARNING" : "ERROR" );
+            pMetric->SetSeverityDescriptor( pMetric->GetName(), eSeverity, -2, sErrorMsg );
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef THRESHOLDEVALUATOR_H
+#define THRESHOLDEVALUATOR_H
+
+//
+//  Includes
+//
+#include "metricdata.h"
+
+#include <QElapsedTimer>
+#include <cstdint>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CThresholdEvaluator
+///
+/// Evaluates high/severe thresholds of all series in one pass per tick. Series are
+/// registered by metric checkers, the collected metric data refers to its series by
+/// index. State of every series is kept in parallel arrays, so the pass is a loop
+/// over plain doubles; disabled thresholds are stored as +inf to avoid branching.
+///
+/// A series which is high or severe stays in that state until the value drops
+/// below the threshold minus hysteresis. A state change is applied only after the
+/// new state lasted for the minimum duration. Severity descriptors are created on
+/// state changes only.
+///
+class CThresholdEvaluator
+{
+    CThresholdEvaluator();
+public:
+    static CThresholdEvaluator& Instance();
+
+public:
+    //
+    //	Main Interface
+    //
+    // -1 disables threshold. Returns series index
+    int  AddSeries( double dHighValue, double dSevereValue );
+    void RemoveSeries( int nSeries );
+
+    // Hysteresis is in percents of the threshold value
+    void SetHysteresisPercent( double dPercent );
+    void SetMinDuration( qint64 nMsecs );
+
+    // Sets severity descriptors of metrics whose series changed state
+    void Evaluate( MetricDataList const& lstMetrics );
+
+private:
+    void UpdateClearLevels( int nSeries );
+
+private:
+    //
+    //	Content
+    //
+    std::vector<double>       m_aHigh;
+    std::vector<double>       m_aSevere;
+    std::vector<double>       m_aHighClear;     // level to leave high state
+    std::vector<double>       m_aSevereClear;   // level to leave severe state
+    std::vector<double>       m_aValue;
+    std::vector<uint8_t>      m_aState;         // EMetricDataSeverity
+    std::vector<uint8_t>      m_aCandidate;     // state waiting for the minimum duration
+    std::vector<qint64>       m_aCandidateSince;
+    std::vector<CMetricData*> m_aMetrics;       // of the current tick, NULL if not collected
+    std::vector<int>          m_aFreeSeries;
+
+    double        m_dHysteresisPercent;
+    qint64        m_nMinDurationMsecs;
+    QElapsedTimer m_oClock;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // THRESHOLDEVALUATOR_H
@@ -0,0 +1,43 @@
+#include "tickclock.h"
+
+namespace
+{
+// wall clock is read again after this period
+const qint64 c_nAnchorPeriodMsecs = 10 * 60 * 1000;
+}
+
+CTickClock::CTickClock()
+    : m_nAnchorMSecs( QDateTime::currentMSecsSinceEpoch() )
+{
+    m_oMonotonic.start();
+}
+
+CTickClock &CTickClock::Instance()
+{
+    static CTickClock oInst;
+    return oInst;
+}
+
+void CTickClock::BeginTick()
+{
+    m_oTickTime = QDateTime::fromMSecsSinceEpoch( CurrentMSecsSinceEpoch(), Qt::UTC );
+}
+
+QDateTime CTickClock::GetTickTime() const
+{
+    if( !m_oTickTime.isValid() )
+        return QDateTime::currentDateTimeUtc();
+    return m_oTickTime;
+}
+
+qint64 CTickClock::CurrentMSecsSinceEpoch()
+{
+    qint64 nElapsed = m_oMonotonic.elapsed();
+    if( nElapsed >= c_nAnchorPeriodMsecs )
+    {
+        m_nAnchorMSecs = QDateTime::currentMSecsSinceEpoch();
+        m_oMonotonic.restart();
+        nElapsed = 0;
+    }
+    return m_nAnchorMSecs + nElapsed;
+}
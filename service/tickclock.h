@@ -0,0 +1,50 @@
+#ifndef TICKCLOCK_H
+#define TICKCLOCK_H
+
+//
+//  Includes
+//
+#include <QDateTime>
+#include <QElapsedTimer>
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CTickClock
+///
+/// Timestamp of the current collection tick. CEngine starts a tick right after the
+/// counters are sampled and all points of the tick get the same UTC time, so the
+/// points are aligned and no clock call or timezone conversion is made per point.
+///
+/// Time is counted by a monotonic timer from a wall clock anchor. The anchor is
+/// renewed periodically, so the clock follows wall clock corrections without going
+/// back within the anchor period.
+///
+class CTickClock
+{
+private:
+    CTickClock();
+
+public:
+    static CTickClock& Instance();
+
+public:
+    //
+    //	Main Interface
+    //
+    void      BeginTick();
+    // UTC time of the current tick, the current time if no tick started yet
+    QDateTime GetTickTime() const;
+    // UTC time now, monotonic within the anchor period
+    qint64    CurrentMSecsSinceEpoch();
+
+private:
+    //
+    //	Content
+    //
+    QElapsedTimer m_oMonotonic;
+    qint64        m_nAnchorMSecs;       // wall clock msecs at m_oMonotonic start
+    QDateTime     m_oTickTime;
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // TICKCLOCK_H
@@ -6,10 +6,13 @@
 #include <QJsonArray>
 #include <QAbstractNetworkCache>
 #include <QNetworkCookieJar>
+#include <QElapsedTimer>
 
 CBasicOddEyeClient::CBasicOddEyeClient(QObject *parent)
     : Base(parent),
-      m_nMaxCacheCount( 50000 )
+      m_nMaxCacheCount( 50000 ),
+      m_bMillisecondTimestamps( false ),
+      m_eUploadLane( CUploadStatistics::ELane::Metrics )
 {}
 
 CBasicOddEyeClient::~CBasicOddEyeClient()
@@ -22,6 +25,11 @@ void CBasicOddEyeClient::SetNetworkAccessManager(NetworkAccessManagerSPtr pNetAc
     m_pNetworkAccessManager = pNetAccessManager;
 }
 
+void CBasicOddEyeClient::SetAlertNetworkAccessManager(NetworkAccessManagerSPtr pNetAccessManager)
+{
+    m_pAlertNetworkAccessManager = pNetAccessManager;
+}
+
 void CBasicOddEyeClient::SetTSDBUrl(const QUrl &oUrl)
 {
     Q_ASSERT( !oUrl.isEmpty() );
@@ -41,7 +49,7 @@ void CBasicOddEyeClient::SendSpecialMessage(const QString &sMetricName, const QS
 
     QJsonArray oRootArray;
     oRootArray.append( CreateSpecialMessageJson( sMetricName, sMessage, eType ) );
-    SendJsonData( QJsonDocument( oRootArray ));
+    SendJsonData( QJsonDocument( oRootArray ), true );
 }
 
 void CBasicOddEyeClient::SendSpecialMessage(MetricSeverityDescriptorSPtr pDescriptor)
@@ -49,9 +57,18 @@ void CBasicOddEyeClient::SendSpecialMessage(MetricSeverityDescriptorSPtr pDescri
     if( !pDescriptor )
         return;
 
+    SendSpecialMessages( MetricSeverityDescriptorList() << pDescriptor );
+}
+
+void CBasicOddEyeClient::SendSpecialMessages(MetricSeverityDescriptorList const& lstDescriptors)
+{
     QJsonArray oRootArray;
-    oRootArray.append( CreateSpecialMessageJson( pDescriptor ) );
-    SendJsonData( QJsonDocument( oRootArray ));
+    for( MetricSeverityDescriptorSPtr const& pDescriptor : lstDescriptors )
+        if( pDescriptor )
+            oRootArray.append( CreateSpecialMessageJson( pDescriptor ) );
+
+    if( !oRootArray.isEmpty() )
+        SendJsonData( QJsonDocument( oRootArray ), true );
 }
 
 void CBasicOddEyeClient::SetClusterName(const QString &sClusterName)
@@ -83,7 +100,12 @@ void CBasicOddEyeClient::SetMaxCacheCount(int nMaxCacheCount)
     m_nMaxCacheCount = nMaxCacheCount;
 }
 
-void CBasicOddEyeClient::SendJsonData(const QJsonDocument &oJsonData)
+void CBasicOddEyeClient::SetMillisecondTimestamps(bool bMilliseconds)
+{
+    m_bMillisecondTimestamps = bMilliseconds;
+}
+
+void CBasicOddEyeClient::SendJsonData(const QJsonDocument &oJsonData, bool bAlertLane)
 {
     // make final POST request data
     QByteArray aMetricJsonData = oJsonData.toJson();
@@ -93,14 +115,28 @@ void CBasicOddEyeClient::SendJsonData(const QJsonDocument &oJsonData)
     QNetworkRequest oPOSTRequest( m_oTsdbUrl );
     oPOSTRequest.setHeader(QNetworkRequest::ContentTypeHeader, "application/x-www-form-urlencoded");
 
+    // alerts do not wait behind metric and cache uploads
+    NetworkAccessManagerSPtr pNetworkAccessManager = m_pNetworkAccessManager;
+    if( bAlertLane && m_pAlertNetworkAccessManager )
+    {
+        pNetworkAccessManager = m_pAlertNetworkAccessManager;
+        oPOSTRequest.setPriority( QNetworkRequest::HighPriority );
+    }
+
+    CUploadStatistics::ELane eLane = bAlertLane? CUploadStatistics::ELane::Alerts : m_eUploadLane;
+    CUploadStatistics::Instance().RequestStarted( eLane, aPOSTRequestData.size(), oJsonData.array().size() );
+    QElapsedTimer oLatencyTimer;
+    oLatencyTimer.start();
 
-    QNetworkReply* pReplay = m_pNetworkAccessManager->Post( oPOSTRequest, aPOSTRequestData );
+    QNetworkReply* pReplay = pNetworkAccessManager->Post( oPOSTRequest, aPOSTRequestData );
     pReplay->setProperty( "json_doc", oJsonData );
 
     connect( pReplay, &QNetworkReply::finished, this,
-    [this]
+    [this, pNetworkAccessManager, eLane, oLatencyTimer]
     {
         QNetworkReply* pReplay = static_cast<QNetworkReply*>( sender() );
+        CUploadStatistics::Instance().RequestFinished( eLane, pReplay->error() == QNetworkReply::NoError,
+                                                       oLatencyTimer.nsecsElapsed() / 1e6 );
         if( pReplay->error() == QNetworkReply::NoError )
         {
             qDebug() << pReplay->readAll();
@@ -118,7 +154,7 @@ void CBasicOddEyeClient::SendJsonData(const QJsonDocument &oJsonData)
         pReplay->deleteLater();
 
         // reset
-        m_pNetworkAccessManager->Reset();
+        pNetworkAccessManager->Reset();
     });
 
     void (QNetworkReply:: *pError)(QNetworkReply::NetworkError) = &QNetworkReply::error;
@@ -170,6 +206,13 @@ QString CBasicOddEyeClient::NormailzeAsOEName(QString sName)
 }
 
 
+QString CBasicOddEyeClient::MakeTimestamp(const QDateTime &oTime) const
+{
+    // msecs since epoch do not depend on the time zone, no conversion needed
+    qint64 nMSecs = oTime.toMSecsSinceEpoch();
+    return QString::number( m_bMillisecondTimestamps? nMSecs : nMSecs / 1000 );
+}
+
 QJsonObject CBasicOddEyeClient::CreateMetricJson(MetricDataSPtr pSingleMetric)
 {
     Q_ASSERT( pSingleMetric );
@@ -180,7 +223,7 @@ QJsonObject CBasicOddEyeClient::CreateMetricJson(MetricDataSPtr pSingleMetric)
     QJsonObject oMetricJson;
     oMetricJson["metric"] = pSingleMetric->GetName();
     oMetricJson["reaction"] = pSingleMetric->GetReaction();
-    oMetricJson["timestamp"] = QString::number( pSingleMetric->GetTime().toUTC().toTime_t() );
+    oMetricJson["timestamp"] = MakeTimestamp( pSingleMetric->GetTime() );
 
     bool bOk = false;
     double dValue = pSingleMetric->GetValue().toDouble(&bOk);
@@ -200,6 +243,13 @@ QJsonObject CBasicOddEyeClient::CreateMetricJson(MetricDataSPtr pSingleMetric)
         QString sTagVal  = NormailzeAsOEName( pSingleMetric->GetInstanceName() );
         oTagsJson[sTagName] = sTagVal;
     }
+    // script tags do not override the agent ones
+    for( auto const& oTag : pSingleMetric->GetTags() )
+    {
+        QString sTagName = NormailzeAsOEName( oTag.first );
+        if( !sTagName.isEmpty() && !oTagsJson.contains( sTagName ) )
+            oTagsJson[sTagName] = NormailzeAsOEName( oTag.second );
+    }
     // add tags
     oMetricJson["tags"] = oTagsJson;
 
@@ -219,7 +269,7 @@ QJsonObject CBasicOddEyeClient::CreateSpecialMessageJson(MetricSeverityDescripto
     QJsonObject oMetricJson;
     oMetricJson["metric"] = pDescriptor->GetMetricName();
     oMetricJson["reaction"] = (int) pDescriptor->GetAlertDurationHint();
-    oMetricJson["timestamp"] = QString::number( pDescriptor->GetTime().toUTC().toTime_t() );
+    oMetricJson["timestamp"] = MakeTimestamp( pDescriptor->GetTime() );
 
     QVariant vtValue;
     QString sStatus;
@@ -273,7 +323,7 @@ QJsonObject CBasicOddEyeClient::CreateSpecialMessageJson(const QString &sMessage
     QJsonObject oMetricJson;
     oMetricJson["metric"] = sMetricName;
     oMetricJson["reaction"] = -2;
-    oMetricJson["timestamp"] = QString::number( QDateTime::currentDateTime().toUTC().toTime_t() );
+    oMetricJson["timestamp"] = MakeTimestamp( QDateTime::currentDateTimeUtc() );
 
     QJsonObject oTagsJson;
     oTagsJson["cluster"] = m_sClusterName;
@@ -3,6 +3,7 @@
 
 #include "../metricdata.h"
 #include "message.h"
+#include "uploadstatistics.h"
 #include <QJsonDocument>
 #include <QNetworkReply>
 #include <QObject>
@@ -28,12 +29,16 @@ public:
 
 public:
     void SetNetworkAccessManager( NetworkAccessManagerSPtr pNetAccessManager );
+    // Separate connections for alerts, not shared with metrics and cache uploading
+    void SetAlertNetworkAccessManager( NetworkAccessManagerSPtr pNetAccessManager );
     void SetTSDBUrl( QUrl const& oUrl );
     void SetUuid( QByteArray const& aOddEyeUuid );
     void SendSpecialMessage(const QString &sMetricName,
                             const QString &sMessage,
                             EMessageType eType);
     void SendSpecialMessage(MetricSeverityDescriptorSPtr pDescriptor );
+    // One request for all descriptors, sent via the alert lane
+    void SendSpecialMessages( MetricSeverityDescriptorList const& lstDescriptors );
 
 
     void SetClusterName( QString const& sClusterName );
@@ -41,8 +46,10 @@ public:
     void SetHostName( QString const& sHostName );
     void SetCacheDir( QString const& sCacheDir );
     void SetMaxCacheCount( int nMaxCacheCount );
+    // Timestamps in milliseconds instead of seconds
+    void SetMillisecondTimestamps( bool bMilliseconds );
 
-    void SendJsonData( QJsonDocument const& oJsonData );
+    void SendJsonData( QJsonDocument const& oJsonData, bool bAlertLane = false );
     virtual bool IsReady() const;
     static QString NormailzeAsOEName( QString sName );
 
@@ -50,6 +57,7 @@ protected:
     virtual void HandleSendSuccedded( QNetworkReply* pReply, QJsonDocument const& oJsonData );
     virtual void HandleSendError(     QNetworkReply* pReply, QJsonDocument const& oJsonData) ;
 
+    QString     MakeTimestamp( QDateTime const& oTime ) const;
     QJsonObject CreateMetricJson( MetricDataSPtr pSingleMetric );
     QJsonObject CreateSpecialMessageJson( MetricSeverityDescriptorSPtr pDescriptor );
     QJsonObject CreateSpecialMessageJson( QString const& sMessage, QString sMetricName, EMessageType eMessageType, QVariant vtMetricValue = QVariant(0) );
@@ -61,6 +69,7 @@ public slots:
 protected:
     // Content
     NetworkAccessManagerSPtr m_pNetworkAccessManager;
+    NetworkAccessManagerSPtr m_pAlertNetworkAccessManager;
     QUrl m_oTsdbUrl;
     QByteArray m_aOddEyeUuid;
 
@@ -69,6 +78,9 @@ protected:
     QString m_sHostName;
     QString m_sCacheDir;
     int     m_nMaxCacheCount;
+    bool    m_bMillisecondTimestamps;
+    // lane of non alert requests in the upload statistics
+    CUploadStatistics::ELane m_eUploadLane;
 };
 ////////////////////////////////////////////////////////////////////////////////////
 
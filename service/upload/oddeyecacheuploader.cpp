@@ -2,11 +2,14 @@
 #include "oddeyecacheuploader.h"
 #include "../logger.h"
 #include <QDir>
+#include <QFileInfo>
 
 COddEyeCacheUploader::COddEyeCacheUploader(QObject *parent)
     : Base( parent ),
       m_pTimer(nullptr)
 {
+    m_eUploadLane = CUploadStatistics::ELane::Cache;
+
     m_pTimer = new QTimer( this );
     m_pTimer->setInterval(5000);
     //connect(m_pTimer, &QTimer::timeout, this, &COddEyeCacheUploader::onCheckAndUpload);
@@ -45,20 +48,23 @@ void COddEyeCacheUploader::onCheckAndUpload()
         //TODO: emit appropriate error signal
     }
 
-    // check max cache
-    QStringList lstJsonFileList = oCacheDir.entryList(QStringList() << "*.json");
+    // check max cache, oldest files first
+    QFileInfoList lstJsonFileList = oCacheDir.entryInfoList(QStringList() << "*.json", QDir::Files, QDir::Time | QDir::Reversed);
     int nCurrentJsonFileCount = lstJsonFileList.size();
 
-    if( nCurrentJsonFileCount <= 0 )
-        return;
-
     // reset upload queue
     m_qUploadingFiles.clear();
-    for( QString const& sCurrentFile : lstJsonFileList )
+    qint64 nBacklogBytes = 0;
+    for( QFileInfo const& oCurrentFile : lstJsonFileList )
     {
-        QString sCurrentFilePath = oCacheDir.absoluteFilePath( sCurrentFile );
-        m_qUploadingFiles.enqueue(sCurrentFilePath);
+        m_qUploadingFiles.enqueue( SCachedFile{ oCurrentFile.absoluteFilePath(), oCurrentFile.lastModified().toMSecsSinceEpoch() } );
+        nBacklogBytes += oCurrentFile.size();
     }
+    qint64 nOldestMSecs = m_qUploadingFiles.isEmpty()? 0 : m_qUploadingFiles.head().nModifiedMSecs;
+    CUploadStatistics::Instance().SetCacheBacklog( nCurrentJsonFileCount, nBacklogBytes, nOldestMSecs );
+
+    if( nCurrentJsonFileCount <= 0 )
+        return;
 
     // stop checking
     Q_ASSERT(m_pTimer);
@@ -85,12 +91,13 @@ void COddEyeCacheUploader::UploadHead()
 {
     if( m_qUploadingFiles.isEmpty() )
         return;
-    QString sFilePath = m_qUploadingFiles.head();
+    QString sFilePath = m_qUploadingFiles.head().sFilePath;
     QFile oFile( sFilePath );
     if( !oFile.open( QIODevice::ReadOnly ) )
     {
         LOG_DEBUG( "Failed to open file: " + sFilePath );
-        DequeueHead();
+        DequeueHead( false );
+        return;
     }
 
     QByteArray aJsonData = oFile.readAll();
@@ -99,7 +106,7 @@ void COddEyeCacheUploader::UploadHead()
     Q_ASSERT( !oJsonDoc.isEmpty() );
     if( oJsonDoc.isEmpty() )
     {
-        DequeueHead();
+        DequeueHead( false );
     }
     else
     {
@@ -108,18 +115,24 @@ void COddEyeCacheUploader::UploadHead()
     }
 }
 
-void COddEyeCacheUploader::DequeueHead()
+void COddEyeCacheUploader::DequeueHead( bool bUploaded )
 {
     if( m_qUploadingFiles.isEmpty() )
         return;
-    QString sFilePath = m_qUploadingFiles.dequeue();
+    QString sFilePath = m_qUploadingFiles.dequeue().sFilePath;
     QFile oFile( sFilePath );
+    qint64 nFileSize = oFile.size();
 
     // remove file
     if( !oFile.remove() )
     {
         LOG_DEBUG("Failed to remove file: " + sFilePath);
     }
+    else
+    {
+        qint64 nOldestMSecs = m_qUploadingFiles.isEmpty()? 0 : m_qUploadingFiles.head().nModifiedMSecs;
+        CUploadStatistics::Instance().CacheFileRemoved( nFileSize, bUploaded, nOldestMSecs );
+    }
 
     if( m_qUploadingFiles.isEmpty() )
     {
@@ -136,7 +149,7 @@ void COddEyeCacheUploader::HandleSendSuccedded(QNetworkReply *pReply, const QJso
 {
     Q_UNUSED(oJsonData);
     LOG_INFO( "Cached file uploaded: " + pReply->readAll() );
-    DequeueHead();
+    DequeueHead( true );
     if( m_qUploadingFiles.isEmpty() )
         LOG_INFO( "-All cached files uploaded!-" );
 }
@@ -33,11 +33,18 @@ private slots:
 private:
     void StartUploading();
     void UploadHead();
-    void DequeueHead();
+    void DequeueHead( bool bUploaded );
+
+private:
+    struct SCachedFile
+    {
+        QString sFilePath;
+        qint64  nModifiedMSecs;
+    };
 
 private:
     QTimer*  m_pTimer;
-    QQueue<QString> m_qUploadingFiles;
+    QQueue<SCachedFile> m_qUploadingFiles;  // oldest first
 };
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 #endif // ODDEYECACHEUPLOADER_H
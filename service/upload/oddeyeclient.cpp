@@ -35,17 +35,15 @@ void COddEyeClient::SendMetrics(const MetricDataList &lstMetrics)
 
     ConvertMetricsToJSON( lstMetrics, oNormalMetricsJson, oSpecialMetricsJson );
 
+    // send special metrics first, via the alert lane
+    if( IsValid( oSpecialMetricsJson ) )
+        Base::SendJsonData( oSpecialMetricsJson, true );
+
     // setnd normal metrics
     if( IsValid( oNormalMetricsJson ) )
         Base::SendJsonData( oNormalMetricsJson );
     else
         LOG_WARNING("Invalid json data of collected metrics");
-
-    // send special metrics
-    if( IsValid( oSpecialMetricsJson ) )
-        Base::SendJsonData( oSpecialMetricsJson );
-    else
-        LOG_WARNING("Invalid json data of collected special metrics");
 }
 
 void COddEyeClient::HandleSendSuccedded(QNetworkReply *pReply, const QJsonDocument &oJsonData)
@@ -141,6 +139,7 @@ bool COddEyeClient::CacheJsonData(const QJsonDocument &oJsonDoc)
         oJsonFile.waitForBytesWritten(100);
     oJsonFile.close();
 
+    CUploadStatistics::Instance().CacheFileAdded( aJsonData.size(), QDateTime::currentMSecsSinceEpoch() );
     LOG_INFO( "Metric data was cached." );
     return true;
 }
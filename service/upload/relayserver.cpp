@@ -0,0 +1,246 @@
+#include "relayserver.h"
+#include "../logger.h"
+
+// Qt
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QTcpSocket>
+#include <QTimer>
+
+namespace
+{
+QByteArray StatusReason( int nStatus )
+{
+    switch( nStatus )
+    {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 403: return "Forbidden";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    default:  return "Error";
+    }
+}
+}
+
+CRelayServer::CRelayServer( QObject* pParent )
+    : Base( pParent ),
+      m_nBatchSize( 5000 ),
+      m_nMaxRequestSize( 8 * 1024 * 1024 ),
+      m_pFlushTimer( nullptr )
+{
+    m_pFlushTimer = new QTimer( this );
+    m_pFlushTimer->setInterval( 1000 );
+    connect( m_pFlushTimer, &QTimer::timeout, this, &CRelayServer::Flush );
+
+    connect( this, &CRelayServer::newConnection, this, &CRelayServer::onNewConnection );
+}
+
+void CRelayServer::SetUuid( QByteArray const& aUuid )
+{
+    m_aUuid = aUuid;
+}
+
+void CRelayServer::SetBatchSize( int nPoints )
+{
+    m_nBatchSize = qMax( nPoints, 1 );
+}
+
+void CRelayServer::SetFlushInterval( int nMsecs )
+{
+    m_pFlushTimer->setInterval( qMax( nMsecs, 10 ) );
+}
+
+void CRelayServer::SetMaxRequestSize( int nBytes )
+{
+    m_nMaxRequestSize = qMax( nBytes, 1024 );
+}
+
+bool CRelayServer::StartListening( quint16 nPort )
+{
+    if( !Base::listen( QHostAddress::Any, nPort ) )
+    {
+        LOG_ERROR( QString( "Relay server start failed on port %1: %2" ).arg( nPort ).arg( errorString() ).toStdString() );
+        return false;
+    }
+
+    m_pFlushTimer->start();
+    LOG_INFO( QString( "Relay server listening on port %1" ).arg( nPort ) );
+    return true;
+}
+
+void CRelayServer::StopListening()
+{
+    Base::close();
+    m_pFlushTimer->stop();
+    Flush();
+
+    for( QTcpSocket* pSocket : m_mapBuffers.keys() )
+        pSocket->disconnectFromHost();
+}
+
+void CRelayServer::Flush()
+{
+    if( m_oPendingPoints.isEmpty() )
+        return;
+
+    QJsonArray oBatch;
+    std::swap( oBatch, m_oPendingPoints );
+    emit sigForward( QJsonDocument( oBatch ), false );
+}
+
+void CRelayServer::onNewConnection()
+{
+    while( QTcpSocket* pSocket = Base::nextPendingConnection() )
+    {
+        m_mapBuffers.insert( pSocket, QByteArray() );
+        connect( pSocket, &QTcpSocket::readyRead,    this, &CRelayServer::onReadyRead );
+        connect( pSocket, &QTcpSocket::disconnected, this, &CRelayServer::onDisconnected );
+    }
+}
+
+void CRelayServer::onReadyRead()
+{
+    QTcpSocket* pSocket = qobject_cast<QTcpSocket*>( sender() );
+    if( !pSocket || !m_mapBuffers.contains( pSocket ) )
+        return;
+
+    QByteArray& aBuffer = m_mapBuffers[pSocket];
+    aBuffer.append( pSocket->readAll() );
+
+    // requests of a keep-alive connection are handled one after another
+    while( true )
+    {
+        int nHeadEnd = aBuffer.indexOf( "\r\n\r\n" );
+        if( nHeadEnd < 0 )
+        {
+            if( aBuffer.size() > 64 * 1024 )
+            {
+                WriteResponse( pSocket, 400, true );
+                return;
+            }
+            break;
+        }
+
+        QList<QByteArray> lstHeadLines = aBuffer.left( nHeadEnd ).split( '\n' );
+        QByteArray aRequestLine = lstHeadLines.value( 0 ).trimmed();
+        qint64 nContentLength = 0;
+        bool bClose = false;
+        for( int i = 1; i < lstHeadLines.size(); ++i )
+        {
+            QByteArray aLine = lstHeadLines[i].trimmed();
+            int nColon = aLine.indexOf( ':' );
+            if( nColon < 0 )
+                continue;
+            QByteArray aName  = aLine.left( nColon ).trimmed().toLower();
+            QByteArray aValue = aLine.mid( nColon + 1 ).trimmed();
+            if( aName == "content-length" )
+                nContentLength = aValue.toLongLong();
+            else if( aName == "connection" )
+                bClose = aValue.toLower() == "close";
+        }
+
+        if( nContentLength < 0 || nContentLength > m_nMaxRequestSize )
+        {
+            WriteResponse( pSocket, 413, true );
+            return;
+        }
+
+        int nRequestSize = nHeadEnd + 4 + int(nContentLength);
+        if( aBuffer.size() < nRequestSize )
+            break;
+
+        int nStatus = HandleRequest( aRequestLine, aBuffer.mid( nHeadEnd + 4, int(nContentLength) ) );
+        aBuffer.remove( 0, nRequestSize );
+        WriteResponse( pSocket, nStatus, bClose );
+        if( bClose )
+            return;
+    }
+}
+
+void CRelayServer::onDisconnected()
+{
+    QTcpSocket* pSocket = qobject_cast<QTcpSocket*>( sender() );
+    if( !pSocket )
+        return;
+
+    m_mapBuffers.remove( pSocket );
+    pSocket->deleteLater();
+}
+
+int CRelayServer::HandleRequest( QByteArray const& aRequestLine, QByteArray const& aBody )
+{
+    if( !aRequestLine.startsWith( "POST " ) )
+        return 405;
+
+    if( !m_aUuid.isEmpty() && FormValue( aBody, "UUID" ) != m_aUuid )
+    {
+        LOG_WARNING( "Relay request rejected: unknown UUID" );
+        return 403;
+    }
+
+    QJsonParseError oError;
+    QJsonDocument oData = QJsonDocument::fromJson( FormValue( aBody, "data" ), &oError );
+    if( oError.error != QJsonParseError::NoError || !oData.isArray() )
+    {
+        LOG_WARNING( "Relay request rejected: invalid data: " + oError.errorString().toStdString() );
+        return 400;
+    }
+
+    // alerts are forwarded at once, points wait for the batch
+    QJsonArray oSpecials;
+    for( QJsonValue const& oPoint : oData.array() )
+    {
+        if( oPoint.toObject().value( "type" ).toString() == "Special" )
+            oSpecials.append( oPoint );
+        else
+            m_oPendingPoints.append( oPoint );
+    }
+
+    if( !oSpecials.isEmpty() )
+        emit sigForward( QJsonDocument( oSpecials ), true );
+    if( m_oPendingPoints.size() >= m_nBatchSize )
+        Flush();
+
+    return 200;
+}
+
+void CRelayServer::WriteResponse( QTcpSocket* pSocket, int nStatus, bool bClose )
+{
+    QByteArray aBody = StatusReason( nStatus );
+    QByteArray aResponse = "HTTP/1.1 " + QByteArray::number( nStatus ) + " " + aBody + "\r\n"
+                           "Content-Type: text/plain\r\n"
+                           "Content-Length: " + QByteArray::number( aBody.size() ) + "\r\n";
+    if( bClose )
+        aResponse += "Connection: close\r\n";
+    aResponse += "\r\n" + aBody;
+
+    pSocket->write( aResponse );
+    if( bClose )
+    {
+        m_mapBuffers[pSocket].clear();
+        pSocket->disconnectFromHost();
+    }
+}
+
+QByteArray CRelayServer::FormValue( QByteArray const& aBody, QByteArray const& aName )
+{
+    // agents send data as raw JSON, which may contain '&', so data is the last field
+    QByteArray aPrefix = aName + "=";
+    int nStart = aBody.startsWith( aPrefix )? 0 : aBody.indexOf( "&" + aPrefix );
+    if( nStart < 0 )
+        return QByteArray();
+    if( nStart > 0 )
+        ++nStart;
+    nStart += aPrefix.size();
+
+    int nEnd = aName == "data"? aBody.size() : aBody.indexOf( '&', nStart );
+    if( nEnd < 0 )
+        nEnd = aBody.size();
+    QByteArray aValue = aBody.mid( nStart, nEnd - nStart );
+
+    // form encoded data of other clients
+    if( !aValue.startsWith( '[' ) && !aValue.startsWith( '{' ) )
+        aValue = QByteArray::fromPercentEncoding( aValue.replace( '+', ' ' ) );
+    return aValue;
+}
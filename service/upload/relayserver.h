@@ -0,0 +1,74 @@
+#ifndef RELAYSERVER_H
+#define RELAYSERVER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTcpServer>
+
+class QTcpSocket;
+class QTimer;
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CRelayServer
+///
+/// Relay mode: accepts the OddEye upload requests of other agents over HTTP
+/// (POST of "UUID=...&data=[...]") and merges their points into large batches,
+/// which are forwarded through the upstream connection of this agent. Failed
+/// batches go to the cache of this agent like its own metrics. Alert messages
+/// are not batched and are forwarded via the alert lane at once.
+///
+class CRelayServer : public QTcpServer
+{
+    Q_OBJECT
+    using Base = QTcpServer;
+
+public:
+    CRelayServer( QObject* pParent = nullptr );
+
+public:
+    //
+    //	Main Interface
+    //
+    // only requests with this UUID are accepted
+    void SetUuid( QByteArray const& aUuid );
+    void SetBatchSize( int nPoints );
+    void SetFlushInterval( int nMsecs );
+    void SetMaxRequestSize( int nBytes );
+
+    bool StartListening( quint16 nPort );
+    void StopListening();
+    // forwards the points waiting for the batch
+    void Flush();
+
+signals:
+    void sigForward( QJsonDocument const& oJsonData, bool bAlertLane );
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+
+private:
+    // returns HTTP status of the request
+    int  HandleRequest( QByteArray const& aRequestLine, QByteArray const& aBody );
+    void WriteResponse( QTcpSocket* pSocket, int nStatus, bool bClose );
+
+    static QByteArray FormValue( QByteArray const& aBody, QByteArray const& aName );
+
+private:
+    //
+    //	Content
+    //
+    QByteArray  m_aUuid;
+    int         m_nBatchSize;
+    int         m_nMaxRequestSize;
+    QTimer*     m_pFlushTimer;
+    QJsonArray  m_oPendingPoints;
+    QHash<QTcpSocket*, QByteArray> m_mapBuffers;    // received, not yet handled bytes
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // RELAYSERVER_H
@@ -1,10 +1,10 @@
 #include "sendcontroller.h"
 #include "oddeyeclient.h"
 #include "oddeyecacheuploader.h"
+#include "relayserver.h"
 #include "../configurationmanager.h"
 #include "../logger.h"
 
-#include "../pinger.h"
 // Qt
 #include <QCoreApplication>
 #include <QDir>
@@ -12,9 +12,19 @@
 
 
 CSendController::CSendController()
-    : m_bIsReady(false)
+    : m_bIsReady(false),
+      m_pRelayServer(nullptr),
+      m_pSeverityFlushTimer(nullptr)
 {
     m_pNetworkManager = std::make_shared<CNetworkAccessManager>();
+    // alert lane: own connections, never busy with metrics or cache replay
+    m_pAlertNetworkManager = std::make_shared<CNetworkAccessManager>();
+
+    // flush once control returns to the event loop
+    m_pSeverityFlushTimer = new QTimer(this);
+    m_pSeverityFlushTimer->setInterval(0);
+    m_pSeverityFlushTimer->setSingleShot(true);
+    connect( m_pSeverityFlushTimer, &QTimer::timeout, this, &CSendController::FlushSeverityMessages );
 
     // create oddeye client
     m_pOEClient = std::make_unique<COddEyeClient>();
@@ -32,6 +42,7 @@ CSendController::CSendController()
 
     // set network access manager
     m_pOEClient->SetNetworkAccessManager(m_pNetworkManager);
+    m_pOEClient->SetAlertNetworkAccessManager(m_pAlertNetworkManager);
     m_pOECacheUploader->SetNetworkAccessManager( m_pNetworkManager );
 
     // Start thread
@@ -59,9 +70,24 @@ void CSendController::SendMetricsData(const MetricDataList &lstMetrics)
 }
 
 void CSendController::SendSeverityMessage(MetricSeverityDescriptorSPtr pSeverityDescriptor)
+{
+    if( !pSeverityDescriptor )
+        return;
+
+    m_lstPendingSeverityMessages.append( pSeverityDescriptor );
+    if( !m_pSeverityFlushTimer->isActive() )
+        m_pSeverityFlushTimer->start();
+}
+
+void CSendController::FlushSeverityMessages()
 {
     Q_ASSERT( m_pOEClient );
-    m_pOEClient->SendSpecialMessage( pSeverityDescriptor );
+    if( m_lstPendingSeverityMessages.isEmpty() )
+        return;
+
+    MetricSeverityDescriptorList lstMessages;
+    lstMessages.swap( m_lstPendingSeverityMessages );
+    m_pOEClient->SendSpecialMessages( lstMessages );
 }
 
 void CSendController::SendSeverityMessage(const QString &sMetricName,
@@ -143,6 +169,33 @@ void CSendController::SetupOEClients()
 
     m_pOEClient->SetMaxCacheCount( nMaxCacheCount );
     m_pOECacheUploader->SetMaxCacheCount( nMaxCacheCount );
+
+    // OpenTSDB accepts both, 13 digits are taken as milliseconds
+    m_pOEClient->SetMillisecondTimestamps( ConfMgr.GetMainConfiguration().Value<bool>( "SelfConfig/timestamp_milliseconds", false ) );
+}
+
+void CSendController::SetupRelayServer()
+{
+    int nRelayPort = ConfMgr.GetMainConfiguration().Value<int>( "SelfConfig/relay_port", 0 );
+    if( nRelayPort <= 0 || nRelayPort > 65535 )
+        return;
+
+    if( !m_pRelayServer )
+    {
+        m_pRelayServer = new CRelayServer(this);
+        // batches of other agents go the same way as own metrics, cached on failure
+        connect( m_pRelayServer, &CRelayServer::sigForward, this,
+        [this]( QJsonDocument const& oJsonData, bool bAlertLane )
+        {
+            m_pOEClient->SendJsonData( oJsonData, bAlertLane );
+        });
+    }
+
+    m_pRelayServer->SetUuid( ConfMgr.GetMainConfiguration().Value<QByteArray>("TSDB/uuid") );
+    m_pRelayServer->SetBatchSize( ConfMgr.GetMainConfiguration().Value<int>( "SelfConfig/relay_batch_size", 5000 ) );
+    m_pRelayServer->SetFlushInterval( static_cast<int>( ConfMgr.GetMainConfiguration().Value<double>( "SelfConfig/relay_flush_seconds", 1 ) * 1000 ) );
+    m_pRelayServer->SetMaxRequestSize( ConfMgr.GetMainConfiguration().Value<int>( "SelfConfig/relay_max_request_bytes", 8 * 1024 * 1024 ) );
+    m_pRelayServer->StartListening( static_cast<quint16>( nRelayPort ) );
 }
 
 
@@ -154,8 +207,10 @@ NetworkAccessManagerWPtr CSendController::GetNetworkAccessManager()
 void CSendController::TurnOn()
 {
     m_pNetworkManager->SetNetworkAccessible( QNetworkAccessManager::Accessible );
+    m_pAlertNetworkManager->SetNetworkAccessible( QNetworkAccessManager::Accessible );
     //  setup OddEye client and OddEye cache uploader
     SetupOEClients();
+    SetupRelayServer();
 
 
     // Start Cache Uploading in worker thread
@@ -170,8 +225,15 @@ void CSendController::TurnOff()
 
     emit sigStopCacheUploading();
 
+    // points waiting in the relay batch are sent or cached
+    if( m_pRelayServer && m_pRelayServer->isListening() )
+        m_pRelayServer->StopListening();
+
     // delete Network Manager
+    // messages queued before stop are still sent
+    FlushSeverityMessages();
     m_pNetworkManager->SetNetworkAccessible( QNetworkAccessManager::NotAccessible );
+    m_pAlertNetworkManager->SetNetworkAccessible( QNetworkAccessManager::NotAccessible );
 
     m_bIsReady = false;
 }
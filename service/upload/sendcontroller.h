@@ -6,6 +6,7 @@
 
 #include "networkaccessmanager.h"
 #include <QThread>
+#include <QTimer>
 #include <atomic>
 #include <memory>
 
@@ -14,6 +15,7 @@ using NetworkAccessManagerWPtr = std::weak_ptr<CNetworkAccessManager>;
 
 // Forward declarations
 class COddEyeCacheUploader;
+class CRelayServer;
 
 //////////////////////////////////////////////////////////////////////////////////////////
 ///
@@ -45,6 +47,9 @@ public slots:
 
     NetworkAccessManagerWPtr GetNetworkAccessManager();
 
+    // Sends severity messages queued during this event loop iteration in one request
+    void FlushSeverityMessages();
+
     void TurnOn();
     void TurnOff();
     bool IsReady() const;
@@ -56,14 +61,22 @@ signals:
 private:
     // Helpers
     void SetupOEClients();
+    void SetupRelayServer();
 
 private:
     // Contents
     NetworkAccessManagerSPtr m_pNetworkManager;
+    NetworkAccessManagerSPtr m_pAlertNetworkManager;
     OddEyeClientUPtr         m_pOEClient;
     QThread*                 m_pCacheUploaderThread;
     OddEyeCacheUploaderUPtr  m_pOECacheUploader;
     std::atomic<bool>        m_bIsReady;
+    // accepts uploads of other agents in relay mode
+    CRelayServer*            m_pRelayServer;
+
+    // severity messages are coalesced, e.g. hundreds of failed counters at start
+    MetricSeverityDescriptorList m_lstPendingSeverityMessages;
+    QTimer*                      m_pSeverityFlushTimer;
 };
 
 #define SendController CSendController::Instance()
@@ -0,0 +1,170 @@
+#include "uploadstatistics.h"
+
+// Qt
+#include <QDateTime>
+#include <QMutexLocker>
+
+namespace
+{
+const double c_aLatencyQuantiles[] = { 0.5, 0.9, 0.99 };
+const int    c_nLaneCount = 3;
+}
+
+CUploadStatistics::CUploadStatistics()
+    : m_nInFlight( 0 ),
+      m_nIntervalRequests( 0 ),
+      m_nIntervalPoints( 0 ),
+      m_nIntervalDrainedBytes( 0 ),
+      m_nCacheFiles( 0 ),
+      m_nCacheBytes( 0 ),
+      m_nCacheOldestMSecs( 0 ),
+      m_nCacheAddedMSecs( 0 )
+{
+    m_oIntervalTimer.start();
+}
+
+CUploadStatistics& CUploadStatistics::Instance()
+{
+    static CUploadStatistics oInst;
+    return oInst;
+}
+
+void CUploadStatistics::RequestStarted( ELane eLane, qint64 nBytes, int nPoints )
+{
+    QMutexLocker oLock( &m_oMutex );
+    SLaneCounters& oLane = m_aLanes[int(eLane)];
+    ++oLane.nRequests;
+    oLane.nBytes  += nBytes;
+    oLane.nPoints += nPoints;
+    ++m_nInFlight;
+
+    ++m_nIntervalRequests;
+    m_nIntervalPoints += nPoints;
+}
+
+void CUploadStatistics::RequestFinished( ELane eLane, bool bSucceeded, double dLatencyMsecs )
+{
+    QMutexLocker oLock( &m_oMutex );
+    if( !bSucceeded )
+        ++m_aLanes[int(eLane)].nFailed;
+    m_nInFlight = qMax( m_nInFlight - 1, 0 );
+    m_oLatency.Add( dLatencyMsecs );
+}
+
+void CUploadStatistics::CacheFileAdded( qint64 nBytes, qint64 nTimeMSecs )
+{
+    QMutexLocker oLock( &m_oMutex );
+    ++m_nCacheFiles;
+    m_nCacheBytes += nBytes;
+    if( m_nCacheOldestMSecs == 0 || nTimeMSecs < m_nCacheOldestMSecs )
+        m_nCacheOldestMSecs = nTimeMSecs;
+    if( m_nCacheAddedMSecs == 0 || nTimeMSecs < m_nCacheAddedMSecs )
+        m_nCacheAddedMSecs = nTimeMSecs;
+}
+
+void CUploadStatistics::CacheFileRemoved( qint64 nBytes, bool bUploaded, qint64 nOldestQueuedMSecs )
+{
+    QMutexLocker oLock( &m_oMutex );
+    m_nCacheFiles = qMax( m_nCacheFiles - 1, 0 );
+    m_nCacheBytes = qMax( m_nCacheBytes - nBytes, qint64(0) );
+
+    // the oldest file left is the next queued one, or one cached after the scan
+    qint64 nOldestMSecs = nOldestQueuedMSecs;
+    if( m_nCacheAddedMSecs > 0 && ( nOldestMSecs == 0 || m_nCacheAddedMSecs < nOldestMSecs ) )
+        nOldestMSecs = m_nCacheAddedMSecs;
+    m_nCacheOldestMSecs = m_nCacheFiles > 0? nOldestMSecs : 0;
+    if( bUploaded )
+        m_nIntervalDrainedBytes += nBytes;
+}
+
+void CUploadStatistics::SetCacheBacklog( int nFiles, qint64 nBytes, qint64 nOldestMSecs )
+{
+    QMutexLocker oLock( &m_oMutex );
+    m_nCacheFiles       = nFiles;
+    m_nCacheBytes       = nBytes;
+    m_nCacheOldestMSecs = nFiles > 0? nOldestMSecs : 0;
+    // files cached from now on are not in the upload queue
+    m_nCacheAddedMSecs  = 0;
+}
+
+MetricDataList CUploadStatistics::MakeMetrics( QDateTime const& oTime )
+{
+    QMutexLocker oLock( &m_oMutex );
+    MetricDataList lstMetrics;
+
+    auto AddMetric = [&]( QString const& sName, QVariant const& vtValue, EMetricDataType eType,
+                          QString const& sInstanceType = QString(), QString const& sInstanceName = QString() )
+    {
+        lstMetrics.append( std::make_shared<CMetricData>( sName, vtValue, eType, oTime, "health", 0,
+                                                          sInstanceType, sInstanceName ) );
+    };
+
+    qint64 nBytes = 0;
+    qint64 nPoints = 0;
+    for( int i = 0; i < c_nLaneCount; ++i )
+    {
+        AddMetric( "upload_requests", m_aLanes[i].nRequests, EMetricDataType::Counter, "lane", LaneName( i ) );
+        AddMetric( "upload_failed_requests", m_aLanes[i].nFailed, EMetricDataType::Counter, "lane", LaneName( i ) );
+        nBytes  += m_aLanes[i].nBytes;
+        nPoints += m_aLanes[i].nPoints;
+    }
+    AddMetric( "upload_retries", m_aLanes[int(ELane::Cache)].nRequests, EMetricDataType::Counter );
+    AddMetric( "upload_bytes", nBytes, EMetricDataType::Counter );
+    AddMetric( "upload_points", nPoints, EMetricDataType::Counter );
+    AddMetric( "upload_in_flight", m_nInFlight, EMetricDataType::None );
+
+    if( m_nIntervalRequests > 0 )
+        AddMetric( "upload_points_per_request", double(m_nIntervalPoints) / m_nIntervalRequests, EMetricDataType::None );
+    if( !m_oLatency.IsEmpty() )
+    {
+        for( double dQuantile : c_aLatencyQuantiles )
+            AddMetric( "upload_latency_p" + QString::number( dQuantile * 100 ), m_oLatency.GetQuantile( dQuantile ),
+                       EMetricDataType::None );
+        AddMetric( "upload_latency_max", m_oLatency.GetMax(), EMetricDataType::None );
+    }
+
+    AddMetric( "upload_cache_files", m_nCacheFiles, EMetricDataType::None );
+    AddMetric( "upload_cache_bytes", m_nCacheBytes, EMetricDataType::None );
+    qint64 nAgeMSecs = m_nCacheOldestMSecs > 0? QDateTime::currentMSecsSinceEpoch() - m_nCacheOldestMSecs : 0;
+    AddMetric( "upload_cache_age", qMax( nAgeMSecs, qint64(0) ) / 1000., EMetricDataType::None );
+    double dSeconds = qMax( m_oIntervalTimer.restart(), qint64(1) ) / 1000.;
+    AddMetric( "upload_cache_drain_rate", m_nIntervalDrainedBytes / dSeconds, EMetricDataType::Rate );
+
+    m_oLatency.Clear();
+    m_nIntervalRequests     = 0;
+    m_nIntervalPoints       = 0;
+    m_nIntervalDrainedBytes = 0;
+    return lstMetrics;
+}
+
+CConfigInfo CUploadStatistics::GetSummary() const
+{
+    QMutexLocker oLock( &m_oMutex );
+    CConfigInfo oSummary;
+    for( int i = 0; i < c_nLaneCount; ++i )
+    {
+        CConfigInfo oLane;
+        oLane["requests"] = m_aLanes[i].nRequests;
+        oLane["failed"]   = m_aLanes[i].nFailed;
+        oLane["bytes"]    = m_aLanes[i].nBytes;
+        oLane["points"]   = m_aLanes[i].nPoints;
+        oSummary[LaneName( i )] = oLane;
+    }
+    oSummary["in_flight"]   = m_nInFlight;
+    oSummary["cache_files"] = m_nCacheFiles;
+    oSummary["cache_bytes"] = m_nCacheBytes;
+    oSummary["cache_oldest"] = m_nCacheOldestMSecs > 0
+            ? QDateTime::fromMSecsSinceEpoch( m_nCacheOldestMSecs ).toString( Qt::ISODate ) : QString();
+    return oSummary;
+}
+
+QString CUploadStatistics::LaneName( int nLane )
+{
+    switch( ELane(nLane) )
+    {
+    case ELane::Metrics: return "metrics";
+    case ELane::Alerts:  return "alerts";
+    case ELane::Cache:   return "cache";
+    }
+    return QString();
+}
@@ -0,0 +1,90 @@
+#ifndef UPLOADSTATISTICS_H
+#define UPLOADSTATISTICS_H
+
+//
+//  Includes
+//
+#include "../metricdata.h"
+#include "../ddsketch.h"
+#include "message.h"
+// Qt
+#include <QElapsedTimer>
+#include <QMutex>
+
+////////////////////////////////////////////////////////////////////////////////////////
+///
+/// class CUploadStatistics
+///
+/// Counters of the upload pipeline: requests, failures, bytes and points per lane,
+/// request latency, requests in flight and the cache backlog. The send controller
+/// and the cache uploader thread report here, the health checker reads the values
+/// as agent self metrics and the control server reports the totals with the status.
+/// Latency quantiles and the drain rate cover the time since the previous read.
+///
+class CUploadStatistics
+{
+public:
+    enum class ELane
+    {
+        Metrics,
+        Alerts,
+        Cache           // re-uploads of failed requests
+    };
+
+private:
+    CUploadStatistics();
+
+public:
+    static CUploadStatistics& Instance();
+
+public:
+    //
+    //	Main Interface
+    //
+    void RequestStarted( ELane eLane, qint64 nBytes, int nPoints );
+    void RequestFinished( ELane eLane, bool bSucceeded, double dLatencyMsecs );
+
+    void CacheFileAdded( qint64 nBytes, qint64 nTimeMSecs );
+    // nOldestQueuedMSecs: time of the next file to upload, 0 if none is queued
+    void CacheFileRemoved( qint64 nBytes, bool bUploaded, qint64 nOldestQueuedMSecs );
+    // result of a cache dir scan
+    void SetCacheBacklog( int nFiles, qint64 nBytes, qint64 nOldestMSecs );
+
+    // agent self metrics, starts the next latency and drain rate interval
+    MetricDataList MakeMetrics( QDateTime const& oTime );
+    // totals for the control server
+    CConfigInfo    GetSummary() const;
+
+private:
+    struct SLaneCounters
+    {
+        qint64 nRequests = 0;
+        qint64 nFailed   = 0;
+        qint64 nBytes    = 0;
+        qint64 nPoints   = 0;
+    };
+
+    static QString LaneName( int nLane );
+
+private:
+    //
+    //	Content
+    //
+    mutable QMutex  m_oMutex;
+    SLaneCounters   m_aLanes[3];
+    int             m_nInFlight;
+
+    CDDSketch       m_oLatency;             // since the previous read
+    qint64          m_nIntervalRequests;
+    qint64          m_nIntervalPoints;
+    qint64          m_nIntervalDrainedBytes;
+    QElapsedTimer   m_oIntervalTimer;
+
+    int             m_nCacheFiles;
+    qint64          m_nCacheBytes;
+    qint64          m_nCacheOldestMSecs;    // 0 when the cache is empty
+    qint64          m_nCacheAddedMSecs;     // oldest file cached since the last scan, 0 if none
+};
+////////////////////////////////////////////////////////////////////////////////////////
+
+#endif // UPLOADSTATISTICS_H